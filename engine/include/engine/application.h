@@ -3,7 +3,10 @@
 #include <chrono>
 
 #include "networking/network.h"
+#include "stats.h"
+#ifndef EUCLID_HEADLESS
 #include "ui/eui.h"
+#endif
 
 using namespace std;
 
@@ -22,12 +25,18 @@ class Application {
     string application_name;
     ApplicationState application_state;
     shared_ptr<Network> network;
-    bool in_update;
+    float step_progress = 0;
+    Stat_Histogram frame_times;
+    Stat_Histogram step_times;
+    Stat_Histogram network_update_times;
+    Stat_Histogram render_times;
 
     void Application_Loop();
 
   protected:
-    void Start_Headless();
+    bool in_update;
+
+    virtual void Start_Headless();
     virtual void Start_Client();
 
   public:
@@ -36,8 +45,16 @@ class Application {
 
     float screen_width;
     float screen_height;
+    /* Updates per second, each Update simulates a fixed 1 / step_rate seconds. */
+    int step_rate = 60;
+    /* Most Updates a frame runs to catch up after falling behind. */
+    int max_steps_per_frame = 5;
 
+#ifndef EUCLID_HEADLESS
     EUI_Context* eui_ctx = new EUI_Context();
+#endif
+    /* Reports the frame, step, network and render times once started, parts can add sections. */
+    Stats_Reporter stats;
 
     /* Game update behavior like physics a game logic. Does not include any UI */
     virtual void Update(chrono::milliseconds) = 0;
@@ -45,13 +62,16 @@ class Application {
     virtual void Update_UI(chrono::milliseconds) = 0;
 
     void Start_Application();
-    void Start_Server();
-    void Connect_To_Server();
+    /* Both use GameNetworkingSockets unless another transport is given. */
+    void Start_Server(unique_ptr<Transport> transport = nullptr);
+    void Connect_To_Server(unique_ptr<Transport> transport = nullptr);
 
     string Get_Name();
     shared_ptr<Network> Get_Network();
     /* Used to tell worker threads if we are still doing work */
     bool In_Update();
+    /* How far the time is between the last step and the next one, from 0 to 1. */
+    float Get_Step_Progress() const;
 
     virtual void Close_Application();
     void Close_Network();
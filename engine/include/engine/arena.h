@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Bump allocator for data that only lives for a step or a frame.
+ * Allocating only moves a pointer forward and deallocating does nothing, the memory is given
+ * back all at once with Reset or Rewind.
+ * The blocks are kept between resets so a warmed up arena doesn't touch the heap.
+ * Not thread safe, every thread should use its own arena.
+ */
+class Frame_Arena : public std::pmr::memory_resource {
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    Block* first;
+    Block* current;
+    // The bytes used in the current block
+    size_t used;
+    size_t block_size;
+    size_t peak_used;
+
+    static unsigned char* Block_Data(Block* block) {
+        return reinterpret_cast<unsigned char*>(block) + sizeof(Block);
+    }
+    Block* New_Block(size_t min_size);
+    void Free_Blocks();
+
+  protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+  public:
+    struct Marker {
+        Block* block;
+        size_t used;
+    };
+
+    /**
+     * Rewinds the arena to where it was when the scope was created.
+     * Nested scopes are fine as long as they are destroyed in reverse order.
+     */
+    class Scope {
+        Frame_Arena& arena;
+        Marker marker;
+
+      public:
+        explicit Scope(Frame_Arena& arena) : arena(arena), marker(arena.Get_Marker()) {}
+        ~Scope() { arena.Rewind(marker); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    explicit Frame_Arena(size_t block_size = 64 * 1024);
+    ~Frame_Arena() override;
+    Frame_Arena(const Frame_Arena&) = delete;
+    Frame_Arena& operator=(const Frame_Arena&) = delete;
+
+    /**
+     * Frees everything allocated from the arena.
+     * If the allocations didn't fit in the first block the blocks are merged into one so that the
+     * next step fits without allocating.
+     */
+    void Reset();
+
+    Marker Get_Marker() const { return {current, used}; }
+    /* Frees everything allocated after the marker was taken. */
+    void Rewind(Marker marker);
+
+    /**
+     * Constructs a T in the arena.
+     * Destructors are never called so T must be trivially destructible.
+     */
+    template <typename T, typename... Args>
+    T* Create(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "Objects in a Frame_Arena are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+    }
+
+    /* The number of bytes in use, including the unused end of filled blocks. */
+    size_t Get_Used() const;
+    size_t Get_Capacity() const;
+    /* The most bytes that were in use before a reset. */
+    size_t Get_Peak_Used() const { return peak_used; }
+};
+
+/**
+ * Growable byte buffer backed by a Frame_Arena.
+ * It has the write method the rpc codec writes through, so calls can be packed straight into it.
+ */
+class Arena_Buffer {
+    std::pmr::vector<char> buffer;
+
+  public:
+    explicit Arena_Buffer(Frame_Arena& arena, size_t capacity = 256) : buffer(&arena) {
+        buffer.reserve(capacity);
+    }
+
+    void write(const char* data, size_t size) { buffer.insert(buffer.end(), data, data + size); }
+    char* data() { return buffer.data(); }
+    const char* data() const { return buffer.data(); }
+    size_t size() const { return buffer.size(); }
+    void clear() { buffer.clear(); }
+};
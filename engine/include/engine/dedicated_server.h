@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include "application.h"
+#include "ecs.h"
+#include "networking/match_server.h"
+
+/**
+ * A match hosted by a Dedicated_Server, owns everything of the match like its ECS and Game_Manager.
+ * The Network of the match only has the clients of the match, so rpcs and steps stay in the match.
+ */
+class Match {
+  public:
+    const Match_ID match_id;
+    shared_ptr<Network> network;
+    /* Set to have the server remove the match after this frame. */
+    bool finished = false;
+
+    Match(Match_ID match_id, shared_ptr<Network> network)
+        : match_id(match_id), network(std::move(network)) {}
+    virtual ~Match() = default;
+
+    /* Called every frame between receiving and sending the messages of the match. */
+    virtual void Update(chrono::milliseconds delta_time) = 0;
+    /* Writes the stats of the match as a JSON value for the stats reports of the server. */
+    virtual void Write_Stats(std::ostream& out) const { network->Write_Stats(out); }
+};
+
+/* Creates the game of a match, the network is already created but not started. */
+typedef std::function<unique_ptr<Match>(Match_ID match_id, shared_ptr<Network> network)>
+    Match_Factory;
+
+/**
+ * A headless application that hosts many matches in one process.
+ * The matches share one listen socket through the Match_Server and the threads of one
+ * ECS_Worker_Pool. A match is created once the first client asks to join it.
+ */
+class Dedicated_Server : public Application {
+    Match_Server match_server;
+    ECS_Worker_Pool worker_pool;
+    Match_Factory match_factory;
+    // Declared last so that the matches are destroyed before the pool and the server they use
+    std::unordered_map<Match_ID, unique_ptr<Match>> matches;
+
+  protected:
+    void Start_Headless() override;
+
+  public:
+    /* The server uses GameNetworkingSockets unless another transport is given. */
+    Dedicated_Server(std::string name, Match_Factory match_factory, int worker_threads,
+                     unique_ptr<Transport> transport = nullptr);
+
+    /* Returns null if the match already exists or the factory didn't create it. */
+    Match* Create_Match(Match_ID match_id);
+    Match* Get_Match(Match_ID match_id);
+    size_t Get_Match_Count() const { return matches.size(); }
+    /* The ECSs of the matches should be created with the pool. */
+    ECS_Worker_Pool& Get_Worker_Pool() { return worker_pool; }
+
+    void Update(chrono::milliseconds delta_time) override;
+    void Update_UI(chrono::milliseconds) override {}
+};
@@ -1,9 +1,14 @@
 #pragma once
 #include "application.h"
+#include "arena.h"
+#include "entity_list.h"
+#include "profiler.h"
+#include "snapshot.h"
 
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <random>
 #include <raylib.h>
 #include <stdexcept>
@@ -31,6 +36,14 @@ class Component_Type {
   public:
     std::string name;
     int size;
+    // Called on the new component after an entity is copied, to copy data the component owns
+    void (*copy_function)(ECS& ecs, void* component) = nullptr;
+    // Called before a component is deleted, to free data the component owns
+    void (*delete_function)(ECS& ecs, void* component) = nullptr;
+    // Writes the component into a snapshot, components without pointers are written as their bytes
+    void (*save_function)(ECS& ecs, const void* component, Snapshot_Writer& writer) = nullptr;
+    // Reads the component written by save_function into zeroed memory
+    void (*load_function)(ECS& ecs, void* component, Snapshot_Reader& reader) = nullptr;
 };
 
 class Entity_Type {
@@ -72,11 +85,16 @@ class Entity_Array {
     // This is the count of the entities in the array at the start of the block
     int entity_count;
 
+    /* Calls the copy_function or delete_function of every component of the entity that has one. */
+    void Call_Component_Functions(unsigned char* entity, bool copy);
+
   public:
     Entity_Type entity_type;
     ECS& ecs;
 
     Entity_Array(ECS& ecs, Entity_Type entity_type);
+    /* Frees the data the components of the remaining entities own, like Clear. */
+    ~Entity_Array();
 
     static Entity_Component& Get_Entity_Data(Entity entity) {
         return *reinterpret_cast<Entity_Component*>(std::get<0>(entity));
@@ -115,12 +133,25 @@ class Entity_Array {
     void Clean_Up();
 
     inline int Count() const { return entity_count; }
+
+    /**
+     * Deletes every entity without calling the delete function of the entity type.
+     * The components still free the data they own.
+     */
+    void Clear();
+
+    /* Writes the components of the entity, not including its id. */
+    void Save_Entity(const unsigned char* entity, Snapshot_Writer& writer);
+    /* Reads the components written by Save_Entity into a new entity. */
+    void Load_Entity(unsigned char* entity, Snapshot_Reader& reader);
 };
 
 class System {
   public:
     Entity_Type* entity_type;
     std::function<void(ECS* ecs, Entity entity)> function;
+    // Only used to identify the system when measuring or debugging
+    std::string name;
 };
 
 class Entity_Iterator {
@@ -139,7 +170,9 @@ class Entity_Iterator {
 
 class Entity_Type_Iterator {
     Entity_Type* entity_type;
-    std::vector<Entity_Array*> arrays;
+    // Allocated from the arena of the worker that created the iterator during a block, otherwise
+    // from the heap since nothing resets the arena between the updates
+    std::pmr::vector<Entity_Array*> arrays;
 
   public:
     Entity_Type_Iterator(ECS& ecs, Entity_Type* entity_type);
@@ -150,14 +183,58 @@ class Entity_Type_Iterator {
     Entity_Iterator end();
 };
 
+// Allocated from the step arena, only valid until the end of the step
 struct Work_Data {
     const std::function<void(ECS* ecs, Entity entity)>& op;
     Entity_Array* entity_array;
     int starting_index;
     int ending_index;
+    // The index of the system in the order the blocks are run, -1 if it isn't a system
+    int system_index;
     Work_Data* next;
 };
 
+/**
+ * Threads shared by the ECSs of a process, so that a server hosting many matches doesn't give every
+ * match its own worker threads. The threads go round the ECSs and run the work each one has queued.
+ * A thread that went round every ECS without finding work sleeps until an ECS queues more.
+ */
+class ECS_Worker_Pool {
+    struct Member {
+        ECS* ecs;
+        // Pool threads currently running the work of the ECS
+        std::atomic<int> threads_inside = 0;
+    };
+    struct Pool_Thread {
+        ECS_Worker_Pool* pool;
+        int index;
+        pthread_t thread;
+    };
+
+    std::vector<Pool_Thread*> threads;
+    pthread_mutex_t members_mutex;
+    std::vector<Member*> members;
+    // Signalled with members_mutex when work is queued, the generation counts the signals
+    pthread_cond_t work_queued;
+    unsigned long work_generation = 0;
+    int sleeping_threads = 0;
+    std::atomic<bool> canceled = false;
+
+    static void* Thread_Function(void* pool_thread);
+    void Do_Thread_Loop(int index);
+
+  public:
+    explicit ECS_Worker_Pool(int thread_count);
+    ~ECS_Worker_Pool();
+
+    int Get_Thread_Count() const { return static_cast<int>(threads.size()); }
+    void Add_ECS(ECS* ecs);
+    /* Returns once no pool thread is running work of the ECS anymore. */
+    void Remove_ECS(ECS* ecs);
+    /* Wakes the sleeping threads, called by a member ECS after queueing work. */
+    void Notify_Work();
+};
+
 class ECS {
     // Stores a list of the creator id, the entity array and the index of the newly created entity.
     std::vector<tuple<Entity_ID, Entity_Array*, int>> to_create;
@@ -165,12 +242,15 @@ class ECS {
     std::vector<Entity_ID> to_delete;
     std::vector<ECS_Worker*> workers;
     ECS_Worker* main_thread;
+    // Runs the workers on its threads instead of each worker having its own thread
+    ECS_Worker_Pool* worker_pool;
     pthread_mutex_t work_mutex;
     Work_Data* work_start;
     Work_Data* work_end;
-    bool in_block;
+    bool in_block = false;
 
     void Complete_Work();
+    ECS(Application& application, long seed, int worker_count, ECS_Worker_Pool* worker_pool);
 
   public:
     Application& application;
@@ -181,8 +261,18 @@ class ECS {
     std::function<void(Entity_ID)> on_add_entity;
     std::function<void(Entity_ID)> on_delete_entity;
     std::minstd_rand random;
+    ECS_Profiler profiler;
+    // Holds the overflow pages of the Entity_Lists in components
+    Side_Storage side_storage;
+    // The objects outside of the ECS that components can point at in a snapshot
+    Snapshot_Pointers snapshot_pointers;
 
-    ECS(Application& application, long seed);
+    /**
+     * Creates the ECS with worker_count worker threads in addition to the thread calling Update.
+     */
+    ECS(Application& application, long seed, int worker_count = 30);
+    /* Creates the ECS with the threads of the pool as its workers, the pool must outlive it. */
+    ECS(Application& application, long seed, ECS_Worker_Pool& worker_pool);
     ~ECS();
 
     void Update();
@@ -212,29 +302,62 @@ class ECS {
     void Delete_Entity(Entity entity);
 
     void Apply_Function_To_Entities(Entity_Type* entity_type,
-                                    const std::function<void(ECS* ecs, Entity)>& op);
+                                    const std::function<void(ECS* ecs, Entity)>& op,
+                                    int system_index = -1);
 
     Entity_Type_Iterator Get_Entities_Of_Type(Entity_Type* entity_type);
 
     Entity_Array* Get_Entities_Of_Exact_Type(Entity_Type* entity_type);
 
     void Register_System(System* system, int block_index);
-    Work_Data* Get_Work(atomic_bool& atomic_bool);
+    Work_Data* Get_Work(atomic_bool& atomic_bool, int thread);
+    /* Runs the queued work on a thread of the worker pool, returns false if there was none. */
+    bool Do_Pool_Work(int thread);
+
+    /**
+     * Returns the arena of the calling worker thread, any other thread gets the arena of the
+     * thread calling Update.
+     * The arenas are reset at the end of every Update, so only use them during a block. Updates
+     * can be skipped for many frames while the lockstep waits.
+     */
+    Frame_Arena& Get_Arena();
     bool In_Block() const { return in_block; }
+
+    /**
+     * Writes every entity, the next entity id and the random state.
+     * Must be called between updates.
+     */
+    void Save_Snapshot(Snapshot_Writer& writer);
+    /**
+     * Replaces every entity with the ones in the snapshot.
+     * The entity arrays of the snapshot must already exist, entities are matched to them by the
+     * names of their components. Must be called between updates.
+     * @return false if the snapshot is broken or doesn't fit this ECS
+     */
+    bool Load_Snapshot(Snapshot_Reader& reader);
 };
 
 class ECS_Worker {
     pthread_t thread;
+    bool separate_thread;
     ECS& ecs;
     atomic_bool doing_work;
     atomic_bool canceled;
 
   public:
-    ECS_Worker(ECS& ecs, bool separate_thread = true);
+    // The thread index used by the profiler, the main thread is 0
+    const int index;
+    // Per step memory for this thread, see ECS::Get_Arena
+    Frame_Arena arena;
+
+    ECS_Worker(ECS& ecs, int index, bool separate_thread = true);
     void Do_Worker_Loop();
     inline void Do_Work();
+    /* Runs a single chunk of the queued work, returns false if there was none. */
+    bool Do_Chunk();
     ~ECS_Worker();
-    constexpr bool Doing_Work();
+    bool Doing_Work() const { return doing_work; }
+    const ECS& Get_ECS() const { return ecs; }
 };
 
 struct Transform_Component {
@@ -245,3 +368,11 @@ struct Transform_Component {
   public:
     static Component_Type component_type;
 };
+
+/* How the Game_UI_Manager draws the entity. */
+struct UI_Component {
+    static Component_Type component_type;
+    Texture2D* texture;
+    float scale;
+    Color color;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <pthread.h>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Pool of the overflow pages used by Entity_Lists, every ECS has one.
+ * Pages come in power of two sizes and are cut out of larger chunks. Freed pages are kept for
+ * reuse so lists that grow and shrink don't fragment the heap. Pages bigger than the largest size
+ * are allocated directly.
+ */
+class Side_Storage {
+    static constexpr size_t min_page_size = 64;
+    static constexpr int size_classes = 12;
+    static constexpr size_t chunk_size = 256 * 1024;
+
+    pthread_mutex_t mutex;
+    std::vector<void*> free_pages[size_classes];
+    std::vector<void*> chunks;
+    unsigned char* chunk_pos;
+    size_t chunk_left;
+    long pages_in_use;
+
+    static int Size_Class(size_t bytes);
+
+  public:
+    Side_Storage();
+    ~Side_Storage();
+    Side_Storage(const Side_Storage&) = delete;
+    Side_Storage& operator=(const Side_Storage&) = delete;
+
+    /* Returns a page of at least bytes bytes, page_size is set to the real size of the page. */
+    void* Allocate(size_t bytes, size_t& page_size);
+    void Free(void* page, size_t page_size);
+
+    long Get_Pages_In_Use() const { return pages_in_use; }
+};
+
+/**
+ * Variable length list that is stored inside of a component.
+ * The first N items are stored inline, longer lists move to a page from the Side_Storage.
+ * Zeroed bytes are an empty list so the list works in components created by the ECS without being
+ * constructed.
+ * The ECS moves and copies components with memcpy, moving is fine but a component holding a list
+ * needs a copy_function that calls Copy_Storage and a delete_function that calls Release.
+ */
+template <typename T, int N>
+class Entity_List {
+    static_assert(std::is_trivially_copyable_v<T>, "Entity_List items are moved with memcpy");
+
+    int count;
+    // The capacity of the overflow page, 0 while the items are stored inline
+    int capacity;
+    T* overflow;
+    T items[N];
+
+    int Capacity() const { return overflow != nullptr ? capacity : N; }
+
+    void Move_To_Page(Side_Storage& storage, int min_capacity) {
+        size_t page_size;
+        T* page = static_cast<T*>(storage.Allocate(sizeof(T) * min_capacity, page_size));
+        std::memcpy(page, data(), sizeof(T) * count);
+        if (overflow != nullptr)
+            storage.Free(overflow, sizeof(T) * capacity);
+        overflow = page;
+        capacity = static_cast<int>(page_size / sizeof(T));
+    }
+
+  public:
+    T* data() { return overflow != nullptr ? overflow : items; }
+    const T* data() const { return overflow != nullptr ? overflow : items; }
+    T* begin() { return data(); }
+    T* end() { return data() + count; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + count; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](int index) { return data()[index]; }
+    const T& operator[](int index) const { return data()[index]; }
+
+    void Push_Back(Side_Storage& storage, const T& item) {
+        if (count == Capacity())
+            Move_To_Page(storage, count * 2);
+        data()[count++] = item;
+    }
+
+    T Pop_Front() {
+        T item = data()[0];
+        count--;
+        std::memmove(data(), data() + 1, sizeof(T) * count);
+        return item;
+    }
+
+    /* Removes the item at position keeping the order of the other items. */
+    void Erase(T* position) {
+        std::memmove(position, position + 1, sizeof(T) * (end() - position - 1));
+        count--;
+    }
+
+    /* Removes the first item equal to item, returns false if there was none. */
+    bool Remove(const T& item) {
+        auto found = std::find(begin(), end(), item);
+        if (found == end())
+            return false;
+        Erase(found);
+        return true;
+    }
+
+    /* Removes all items but keeps the overflow page. */
+    void Clear() { count = 0; }
+
+    /* Removes all items and gives the overflow page back to the storage. */
+    void Release(Side_Storage& storage) {
+        if (overflow != nullptr)
+            storage.Free(overflow, sizeof(T) * capacity);
+        count = 0;
+        capacity = 0;
+        overflow = nullptr;
+    }
+
+    /**
+     * Gives the list its own overflow page after it was copied with memcpy.
+     * Does nothing for items stored inline.
+     */
+    void Copy_Storage(Side_Storage& storage) {
+        if (overflow == nullptr)
+            return;
+        T* shared = overflow;
+        size_t page_size;
+        overflow = static_cast<T*>(storage.Allocate(sizeof(T) * capacity, page_size));
+        capacity = static_cast<int>(page_size / sizeof(T));
+        std::memcpy(overflow, shared, sizeof(T) * count);
+    }
+};
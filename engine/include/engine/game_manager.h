@@ -2,9 +2,13 @@
 #include "application.h"
 #include "game_object.h"
 
+#include <map>
 #include <random>
+#include <unordered_set>
 
 class Player;
+class Snapshot_Writer;
+class Snapshot_Reader;
 typedef long Player_ID;
 
 class Game_Manager {
@@ -22,21 +26,77 @@ class Game_Manager {
     long min_step = 0;
     /* Used on the server to store what steps */
     std::unordered_map<Player_ID, long> player_steps;
+    /* Set on a client that joined a running match until it has loaded the snapshot */
+    bool waiting_for_snapshot = false;
     /* Called on clients from the server to set the max step */
     void On_Receive_Step_Update(long max_step);
     /* Called on the server from the client to inform the server on its current step */
     void On_Receive_Player_Step_Update(Player_ID player_id, long min_step);
     long next_id = 0;
-    static long max_step_diff;
+    Rpc<long> step_update_rpc;
+    Rpc<long, long> min_step_update_rpc;
 
     unordered_map<Obj_ID, Game_Object*> objects;
     vector<Game_Object*> objects_to_delete;
 
+    /* Measured by the server from the step reports of a player */
+    struct Player_Timing {
+        // Smoothed time from allowing a step until the player reports it, and how much it varies
+        double delay_ms = 0;
+        double jitter_ms = 0;
+        bool measured = false;
+    };
+    /* How many steps the server can be ahead of the slowest player, adapts once all are measured */
+    long step_window = 10;
+    std::unordered_map<Player_ID, Player_Timing> player_timings;
+    /* When the server allowed the steps that not every player has reported yet */
+    std::map<long, chrono::steady_clock::time_point> step_release_times;
+    /* Smoothed time between the updates of the server, the time a step in the window takes */
+    double frame_interval_ms = 0;
+    chrono::steady_clock::time_point last_update_time;
+    void Measure_Player_Step(Player_ID player_id, long player_step);
+    void Update_Step_Window();
+
+    /* Players that only watch, the server doesn't wait for them and they don't report steps */
+    std::unordered_set<Player_ID> spectators;
+    bool spectating = false;
+    /* The step the spectators are allowed to simulate to */
+    long spectator_step = 0;
+    /* Sends the spectators the steps that are spectator_delay behind, once a batch is complete. */
+    void Update_Spectators();
+
+  public:
+    /* Counts the updates that simulated a step and the ones where the lockstep had to wait. */
+    struct Lockstep_Stats {
+        long steps = 0;
+        long stalled_updates = 0;
+        // The time between the previous update and each stalled one
+        double stalled_ms = 0;
+    };
+
+  private:
+    Lockstep_Stats lockstep_stats;
+
   public:
     Player* local_player;
     vector<Player*> players;
     std::function<void(Game_Object*)> on_add_object;
     std::function<void(Game_Object*)> on_delete_object;
+    /* Save and load the state of the match kept outside of the Game_Manager, like the ECS */
+    std::function<void(Snapshot_Writer&)> on_save_snapshot;
+    std::function<bool(Snapshot_Reader&)> on_load_snapshot;
+
+    /* Bounds of the step window */
+    static long min_step_window;
+    static long max_step_window;
+    /* A client further behind the server than catch_up_lead simulates up to max_catch_up_steps
+     * steps per frame until it is back within the lead */
+    static long catch_up_lead;
+    static int max_catch_up_steps;
+    /* Spectators are sent the steps spectator_delay steps after the players, spectator_batch_steps
+     * at a time, so a large audience costs the server a few messages per batch */
+    static long spectator_delay;
+    static long spectator_batch_steps;
 
     Game_Manager(Application&, Network&, vector<Player*>, Player*, long seed);
     ~Game_Manager();
@@ -45,6 +105,34 @@ class Game_Manager {
     void Delete_Object(Game_Object* object);
     long Get_New_Id();
     long Get_Current_Step() const;
+    long Get_Step_Window() const { return step_window; }
+    const Lockstep_Stats& Get_Lockstep_Stats() const { return lockstep_stats; }
+    /* Writes the step, the window, the stalls and the timing of each player as a JSON object. */
+    void Write_Stats(std::ostream& out) const;
+    /**
+     * Returns how many steps to simulate this frame, each step being an Update.
+     * More than one when a client is catching up, 0 when waiting for the server or the players.
+     */
+    int Get_Steps_To_Simulate() const;
+    /* Writes the state of the match at the current step, must be called between updates. */
+    void Save_Snapshot(Snapshot_Writer& writer);
+    /**
+     * Replaces the state of the match with a snapshot and continues from its step.
+     * @return false if the snapshot is broken
+     */
+    bool Load_Snapshot(Snapshot_Reader& reader);
+    /* Stops simulating until a snapshot is loaded, used when joining a running match. */
+    void Wait_For_Snapshot();
+    bool Is_Waiting_For_Snapshot() const { return waiting_for_snapshot; }
+    /* Stops waiting for a player that left, so that the others can keep playing. */
+    void Remove_Player_Steps(Player_ID player_id);
+    /**
+     * Makes the player a spectator on every machine. The server stops waiting for it and a
+     * spectating client stops reporting its steps. The Network of the server has to be told which
+     * client spectates as well, see Network::Set_Spectator.
+     */
+    void Set_Spectator(Player_ID player_id);
+    bool Is_Spectating() const { return spectating; }
     Game_Object* Get_Object(Obj_ID);
     Player* Get_Player(Player_ID);
     vector<Game_Object*> Get_All_Objects();
@@ -1,26 +1,21 @@
 #pragma once
 #include "ecs.h"
 #include "game_manager.h"
+#include "render_buffer.h"
 
 #include <chrono>
 
+class EUI_Context;
 class Object_UI;
 
-struct UI_Component {
-    static Component_Type component_type;
-    Texture2D* texture;
-    float scale;
-    Color color;
-};
-
 class Game_UI_Manager {
   private:
     std::unordered_set<Entity_ID> to_create;
     std::unordered_set<Entity_ID> to_delete;
+    Render_Buffer render_buffer;
 
     void On_Create_Object(Entity_ID);
     void On_Delete_Object(Entity_ID);
-    static Game_UI_Manager* game_ui_manager_instance;
 
   public:
     Application& application;
@@ -34,6 +29,14 @@ class Game_UI_Manager {
 
     void Resize_UI(Vector2 screen_seize_change);
     void Update_UI(std::chrono::milliseconds delta_time, EUI_Context* eui_ctx);
+    /* Saves the transforms of the entities with a UI_Component, call after each step. */
+    void Publish_Render_State();
+    /**
+     * Returns the transform of the entity interpolated between the last two published steps.
+     * Entities that weren't in both steps are drawn where they are.
+     */
+    Transform_Component Get_Render_Transform(Entity_ID entity_id,
+                                             const Transform_Component& transform) const;
 
     void DrawImage(Texture2D& texture, Vector2 pos, float rot, float scale, Color color);
 
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * LZ4 style block compression for network messages.
+ * A block is a list of sequences, each one a run of literal bytes followed by a copy of earlier
+ * output:
+ * - a token byte, the high nibble is the literal count and the low nibble the match length - 4
+ * - more literal count bytes if the nibble is 15, each adding up to 255
+ * - the literals
+ * - the offset of the match back from the current position as 2 little endian bytes
+ * - more match length bytes if the nibble is 15
+ * The last sequence only has literals. The size of the original data is not part of the block.
+ */
+
+/**
+ * Appends the compressed data to output.
+ * @return The size of the compressed block
+ */
+size_t Compress_Block(const char* data, size_t size, std::vector<char>& output);
+
+/**
+ * Decompresses a block into exactly output_size bytes.
+ * @return false if the block is broken or doesn't decompress to output_size bytes
+ */
+bool Decompress_Block(const char* data, size_t size, char* output, size_t output_size);
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "transport.h"
+
+/* How the messages sent by a Loopback_Transport travel to the other end. */
+struct Loopback_Conditions {
+    // Time for a message to reach the other end
+    double latency_ms = 0;
+    // Every message is delayed by an additional random time up to jitter_ms
+    double jitter_ms = 0;
+    // Chance below 1 that a message is lost, lost reliable messages are resent after a round trip
+    double loss = 0;
+    // Bytes per second shared by all connections of the transport, 0 is unlimited
+    double bandwidth = 0;
+    // Bytes that can wait for the bandwidth, unreliable messages that don't fit are dropped
+    double send_buffer = 512 * 1024;
+    unsigned int seed = 1;
+};
+
+class Loopback_Transport;
+
+/**
+ * The network between the Loopback_Transports of a process.
+ * A transport can only connect to transports that share its hub.
+ */
+class Loopback_Hub {
+    friend class Loopback_Transport;
+
+    struct Connection {
+        Loopback_Transport* owner;
+        HSteamNetConnection peer = k_HSteamNetConnection_Invalid;
+        ESteamNetworkingConnectionState state = k_ESteamNetworkingConnectionState_None;
+        HSteamNetPollGroup poll_group = k_HSteamNetPollGroup_Invalid;
+        std::string name;
+        // Messages from the peer by the time they arrive, equal times keep the order they were sent
+        std::multimap<SteamNetworkingMicroseconds, ISteamNetworkingMessage*> inbox;
+        // Reliable messages from this end can't overtake each other
+        SteamNetworkingMicroseconds last_reliable_arrival = 0;
+    };
+
+    pthread_mutex_t mutex;
+    uint32 next_handle = 1;
+    std::unordered_map<uint16, Loopback_Transport*> listeners;
+    std::unordered_map<HSteamListenSocket, uint16> listen_ports;
+    std::unordered_map<HSteamNetConnection, Connection> connections;
+    std::unordered_map<Loopback_Transport*, std::vector<SteamNetConnectionStatusChangedCallback_t>>
+        status_changes;
+
+    /* Queues the change for the owner of the connection, the mutex has to be locked. */
+    void Set_State(HSteamNetConnection handle, ESteamNetworkingConnectionState state);
+    /* Closes the connection and tells the peer, the mutex has to be locked. */
+    void Remove_Connection(HSteamNetConnection handle);
+
+  public:
+    Loopback_Hub();
+    ~Loopback_Hub();
+
+    static SteamNetworkingMicroseconds Now();
+};
+
+/**
+ * Delivers the messages in process through a Loopback_Hub instead of over sockets.
+ * Used to run a server and its clients in one process for tests and benchmarks.
+ * Lanes are accepted but their priorities aren't simulated.
+ */
+class Loopback_Transport : public Transport {
+    std::shared_ptr<Loopback_Hub> hub;
+    Status_Callback status_callback;
+    // Guarded by the mutex of the hub since Send_Messages runs on the I/O thread
+    Loopback_Conditions conditions;
+    std::minstd_rand random;
+    // When the messages sent so far are through the bandwidth
+    SteamNetworkingMicroseconds link_free = 0;
+
+    double Random_Fraction();
+    /* Returns when the message arrives at the peer, or -1 if it is lost. */
+    SteamNetworkingMicroseconds Arrival_Time(Loopback_Hub::Connection& from, int size,
+                                             bool reliable);
+
+  public:
+    explicit Loopback_Transport(std::shared_ptr<Loopback_Hub> hub,
+                                Loopback_Conditions conditions = {});
+    ~Loopback_Transport() override;
+
+    /* Applies to the messages sent from now on. */
+    void Set_Conditions(const Loopback_Conditions& conditions);
+
+    bool Start(Status_Callback status_callback) override;
+    HSteamListenSocket Listen(uint16 port) override;
+    void Close_Listen_Socket(HSteamListenSocket listen_socket) override;
+    HSteamNetConnection Connect(uint16 port) override;
+    HSteamNetPollGroup Create_Poll_Group() override;
+    void Destroy_Poll_Group(HSteamNetPollGroup poll_group) override;
+    bool Accept_Connection(HSteamNetConnection connection) override;
+    bool Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                   HSteamNetPollGroup poll_group) override;
+    void Set_Connection_Name(HSteamNetConnection connection, const char* name) override;
+    bool Configure_Lanes(HSteamNetConnection connection, int lane_count, const int* priorities,
+                         const uint16* weights) override;
+    void Close_Connection(HSteamNetConnection connection, int reason,
+                          const char* debug_message) override;
+    ISteamNetworkingMessage* Allocate_Message(int size) override;
+    void Send_Messages(int count, ISteamNetworkingMessage* const* messages) override;
+    int Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    int Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    void Run_Callbacks() override;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <pthread.h>
+#include <unordered_map>
+#include <vector>
+
+#include "transport.h"
+
+typedef uint32 Match_ID;
+
+class Match_Transport;
+
+/**
+ * Shares one listen socket between the matches of a dedicated server.
+ * Every match runs its own Network over a Match_Transport, so each match has its own clients, rpcs
+ * and steps. A client says which match it joins with the first message on its connection, see
+ * Match_Join_Transport. Until then the connection belongs to no match.
+ * Update receives the messages of every match from the shared poll group at once, so the Networks
+ * of the matches don't run I/O threads that each poll the same sockets.
+ */
+class Match_Server {
+    friend class Match_Transport;
+
+    struct Route {
+        // Set by the first message of the connection
+        bool joined = false;
+        Match_ID match_id = 0;
+        // Null until the client joined a match that exists
+        Match_Transport* match = nullptr;
+        // Set once the Network of the match accepted the connection
+        bool accepted = false;
+        // Messages the match hasn't received yet
+        std::deque<ISteamNetworkingMessage*> inbox;
+    };
+
+    std::unique_ptr<Transport> transport;
+    pthread_mutex_t mutex;
+    HSteamListenSocket listen_socket = k_HSteamListenSocket_Invalid;
+    HSteamNetPollGroup poll_group = k_HSteamNetPollGroup_Invalid;
+    std::unordered_map<HSteamNetConnection, Route> routes;
+    std::unordered_map<Match_ID, Match_Transport*> matches;
+
+    void On_Status_Changed(SteamNetConnectionStatusChangedCallback_t* status_change);
+    /* Moves the messages from the sockets to their matches, the mutex has to be locked. */
+    void Receive_Messages();
+    /* Hands the connection to the match, the mutex has to be locked. */
+    void Route_Connection(HSteamNetConnection connection, Route& route, Match_Transport* match);
+    /* Closes the connection and drops what it sent, the mutex has to be locked. */
+    void Remove_Route(HSteamNetConnection connection, const char* debug_message);
+
+  public:
+    /* Called for a match that a client asked for but doesn't exist, can create it. */
+    std::function<void(Match_ID match_id)> on_unknown_match;
+
+    /* Uses GameNetworkingSockets unless another transport is given. */
+    explicit Match_Server(std::unique_ptr<Transport> transport = nullptr);
+    ~Match_Server();
+
+    bool Start(uint16 port);
+    /**
+     * Returns the transport to give the Network of the match.
+     * The Network has to be a server, the match is removed once the transport is destroyed.
+     */
+    std::unique_ptr<Transport> Create_Match_Transport(Match_ID match_id);
+    bool Has_Match(Match_ID match_id);
+    /**
+     * Handles new connections and the clients that join a match and moves the received messages to
+     * their matches, call once per frame before updating the Networks of the matches.
+     */
+    void Update();
+};
+
+/* The part of a Match_Server that belongs to one match. */
+class Match_Transport : public Transport {
+    friend class Match_Server;
+
+    Match_Server& server;
+    const Match_ID match_id;
+    Status_Callback status_callback;
+    // Guarded by the mutex of the server
+    std::vector<HSteamNetConnection> connections;
+    std::vector<SteamNetConnectionStatusChangedCallback_t> status_changes;
+
+    /* Queues a status change for the Network of the match, the server mutex has to be locked. */
+    void Queue_Status_Change(HSteamNetConnection connection,
+                             ESteamNetworkingConnectionState old_state,
+                             ESteamNetworkingConnectionState state);
+
+  public:
+    Match_Transport(Match_Server& server, Match_ID match_id);
+    ~Match_Transport() override;
+
+    bool Start(Status_Callback status_callback) override;
+    HSteamListenSocket Listen(uint16 port) override;
+    void Close_Listen_Socket(HSteamListenSocket /*listen_socket*/) override {}
+    HSteamNetConnection Connect(uint16 port) override;
+    HSteamNetPollGroup Create_Poll_Group() override;
+    void Destroy_Poll_Group(HSteamNetPollGroup /*poll_group*/) override {}
+    bool Accept_Connection(HSteamNetConnection connection) override;
+    bool Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                   HSteamNetPollGroup poll_group) override;
+    void Set_Connection_Name(HSteamNetConnection connection, const char* name) override;
+    bool Configure_Lanes(HSteamNetConnection connection, int lane_count, const int* priorities,
+                         const uint16* weights) override;
+    void Close_Connection(HSteamNetConnection connection, int reason,
+                          const char* debug_message) override;
+    ISteamNetworkingMessage* Allocate_Message(int size) override;
+    void Send_Messages(int count, ISteamNetworkingMessage* const* messages) override;
+    int Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    int Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    void Run_Callbacks() override;
+    /* The Match_Server receives the messages and the shared sockets can send from any thread. */
+    bool Needs_IO_Thread() const override { return false; }
+};
+
+/* Used by a client to join a match on a Match_Server, wraps the transport it connects over. */
+class Match_Join_Transport : public Transport {
+    std::unique_ptr<Transport> transport;
+    const Match_ID match_id;
+
+  public:
+    /* Uses GameNetworkingSockets unless another transport is given. */
+    explicit Match_Join_Transport(Match_ID match_id,
+                                  std::unique_ptr<Transport> transport = nullptr);
+
+    bool Start(Status_Callback status_callback) override;
+    HSteamListenSocket Listen(uint16 port) override;
+    void Close_Listen_Socket(HSteamListenSocket listen_socket) override;
+    /* Connects and sends the match to join before anything else. */
+    HSteamNetConnection Connect(uint16 port) override;
+    HSteamNetPollGroup Create_Poll_Group() override;
+    void Destroy_Poll_Group(HSteamNetPollGroup poll_group) override;
+    bool Accept_Connection(HSteamNetConnection connection) override;
+    bool Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                   HSteamNetPollGroup poll_group) override;
+    void Set_Connection_Name(HSteamNetConnection connection, const char* name) override;
+    bool Configure_Lanes(HSteamNetConnection connection, int lane_count, const int* priorities,
+                         const uint16* weights) override;
+    void Close_Connection(HSteamNetConnection connection, int reason,
+                          const char* debug_message) override;
+    ISteamNetworkingMessage* Allocate_Message(int size) override;
+    void Send_Messages(int count, ISteamNetworkingMessage* const* messages) override;
+    int Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    int Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    void Run_Callbacks() override;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <steam/isteamnetworkingsockets.h>
+#include <vector>
+
+/**
+ * Lock free queue of network messages between exactly one producer thread and one consumer thread.
+ * The messages are handed over in order. The queue has a fixed capacity, Push fails when it is full
+ * so the producer decides whether to wait or to leave the message where it is.
+ */
+class Message_Queue {
+    std::vector<ISteamNetworkingMessage*> slots;
+    // Only written by the consumer
+    std::atomic<size_t> head = 0;
+    // Only written by the producer
+    std::atomic<size_t> tail = 0;
+
+  public:
+    /* The capacity must be a power of two. */
+    explicit Message_Queue(size_t capacity) : slots(capacity, nullptr) {}
+
+    /* Called by the producer, returns false if the queue is full. */
+    bool Push(ISteamNetworkingMessage* message) {
+        size_t current_tail = tail.load(std::memory_order_relaxed);
+        if (current_tail - head.load(std::memory_order_acquire) == slots.size())
+            return false;
+        slots[current_tail & (slots.size() - 1)] = message;
+        tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Called by the consumer, returns null if the queue is empty. */
+    ISteamNetworkingMessage* Pop() {
+        size_t current_head = head.load(std::memory_order_relaxed);
+        if (current_head == tail.load(std::memory_order_acquire))
+            return nullptr;
+        ISteamNetworkingMessage* message = slots[current_head & (slots.size() - 1)];
+        head.store(current_head + 1, std::memory_order_release);
+        return message;
+    }
+
+    /* The free slots as seen by the producer, there can be more by the time it pushes. */
+    size_t Free_Slots() const {
+        return slots.size() - (tail.load(std::memory_order_relaxed) -
+                               head.load(std::memory_order_acquire));
+    }
+};
@@ -1,45 +1,93 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <steam/isteamnetworkingsockets.h>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+#include "arena.h"
+#include "message_queue.h"
 #include "rpc_manager.h"
-
-#include <queue>
-
+#include "transport.h"
+
+constexpr uint16 DEFAULT_SERVER_PORT = 27020;
+
+/**
+ * The records a network message is made of, a message holds any number of them back to back.
+ * The first byte of a record holds its type, for rpcs the bit after the type is order_sensitive.
+ * - Rpc: [type] [rpc_id if ordered] [associated_step] [call size] [call]
+ * - Step_Frame: [type] [first_rpc_id] [step] [call count] then [call size] [call] for each call
+ * - Announcement: [type] [rpc id] [name]
+ * - Unreliable_Rpc: [type] [sequence] [call size] [call]
+ * - Compressed: [type] [original size] [compressed block], it is the whole message and holds the
+ *   records of the original message
+ * - Snapshot_Chunk: [type] [step] [snapshot size] [offset] [chunk size] [chunk]
+ * Numbers are varints and the step is zigzag encoded since it can be negative.
+ * Unreliable rpcs are sent in their own messages, every other record is sent reliably.
+ */
+enum Record_Type : unsigned char {
+    Rpc_Record,
+    Step_Frame_Record,
+    Announcement_Record,
+    Unreliable_Rpc_Record,
+    Compressed_Record,
+    Snapshot_Chunk_Record,
+};
+constexpr unsigned char record_type_mask = 0x7;
+constexpr unsigned char record_order_sensitive_flag = 0x8;
+
+/**
+ * An rpc call together with the information needed to order it.
+ * The rpc doesn't own the packed call, it only points at it. A received rpc points into the network
+ * message it arrived in and keeps that message alive until the rpc is destroyed.
+ */
 struct Rpc_Message {
-    // Information about msgpack here: https://github.com/msgpack/msgpack-c/wiki/v2_0_cpp_packer
     long rpc_id;
     bool order_sensitive;
     // -1 means coming from the client, -2 means not associated with a step
     long associated_step;
-    std::vector<char> rpc_call;
+    const char* rpc_call;
+    size_t rpc_call_size;
+    std::shared_ptr<ISteamNetworkingMessage> message;
 
     Rpc_Message() = default;
 
-    Rpc_Message(bool order_sensitive, long associated_step, char* rpc_data, size_t length)
-        : rpc_id(-1), order_sensitive(order_sensitive), associated_step(associated_step) {
-        rpc_call = std::vector<char>(rpc_data, rpc_data + length);
-    }
-
-    explicit Rpc_Message(bool order_sensitive, long associated_step, std::vector<char> rpc_call)
+    Rpc_Message(bool order_sensitive, long associated_step, const char* rpc_call, size_t size)
         : rpc_id(-1), order_sensitive(order_sensitive), associated_step(associated_step),
-          rpc_call(std::move(rpc_call)) {}
-
-    Rpc_Message(const Rpc_Message& copy, long msg_id)
-        : rpc_id(msg_id), order_sensitive(copy.order_sensitive),
-          associated_step(copy.associated_step) {
-        rpc_call = std::vector<char>();
-        // We need to do a deep copy and copy the data as well so that the old one can be deleted
-        std::copy(copy.rpc_call.begin(), copy.rpc_call.end(), back_inserter(rpc_call));
+          rpc_call(rpc_call), rpc_call_size(size) {}
+
+    /**
+     * Reads an rpc record after its type byte without copying the call.
+     * @return false if the record is cut short
+     */
+    static bool Read(unsigned char record, Rpc_Reader& reader,
+                     std::shared_ptr<ISteamNetworkingMessage> message, Rpc_Message& rpc);
+
+    /* Writes everything in front of the call of an rpc record. */
+    template <typename Stream>
+    static void Write_Header(Stream& stream, long id, bool order_sensitive, long associated_step,
+                             size_t call_size) {
+        char record = Rpc_Record | (order_sensitive ? record_order_sensitive_flag : 0);
+        stream.write(&record, 1);
+        if (order_sensitive)
+            Write_Varint(stream, id);
+        Write_Signed_Varint(stream, associated_step);
+        Write_Varint(stream, call_size);
     }
 
-    // Tells msgpack how to serialize Rpc_Message
-    MSGPACK_DEFINE(rpc_id, order_sensitive, associated_step, rpc_call);
+    /* Writes the rpc record, the rpc_id replaces the id of this rpc. */
+    template <typename Stream>
+    void Write(Stream& stream, long id) const {
+        Write_Header(stream, id, order_sensitive, associated_step, rpc_call_size);
+        stream.write(rpc_call, rpc_call_size);
+    }
 };
 
 typedef unsigned int uint32;
@@ -72,36 +120,101 @@ class Network {
         Closed,
     };
 
-  private:
-    class Rpc_Order_Comparator {
-      public:
-        bool operator()(Rpc_Message* a, Rpc_Message* b) { return a->rpc_id <= b->rpc_id; }
-    };
-
-    class Rpc_Step_Comparator {
-      public:
-        bool operator()(Rpc_Message* a, Rpc_Message* b) {
-            if (a->associated_step == b->associated_step)
-                return a->rpc_id <= b->rpc_id;
-            return a->associated_step <= b->associated_step;
+    /* Counts the reliable messages that were big enough to be compressed. */
+    struct Compression_Stats {
+        long messages_compressed = 0;
+        // Messages that didn't get smaller and were sent as they were
+        long messages_not_compressed = 0;
+        long bytes_before = 0;
+        long bytes_after = 0;
+
+        /* The size of the sent messages compared to their original size. */
+        double Ratio() const {
+            return bytes_before == 0 ? 1 : static_cast<double>(bytes_after) / bytes_before;
         }
     };
+    // Turns compression off when passed to Set_Compression_Threshold
+    static constexpr size_t no_compression = SIZE_MAX;
+
+    /* What went over the network, for each client on the server or for the server on a client. */
+    struct Traffic_Stats {
+        struct Connection_Traffic {
+            long messages_in = 0;
+            long bytes_in = 0;
+            long messages_out = 0;
+            long bytes_out = 0;
+        };
+        std::unordered_map<Client_ID, Connection_Traffic> connections;
+        // The calls invoked on this machine, indexed by the local rpc id
+        std::vector<long> rpc_calls;
+    };
 
+  private:
     class Connection_State {
       public:
+        // The id of the next ordered rpc sent to the connection
         long next_rpc_id = 0;
+        // The id of the next ordered rpc expected from the connection
         long next_rpc_id_to_receive = 0;
-        std::priority_queue<Rpc_Message*, std::vector<Rpc_Message*>, Rpc_Order_Comparator>
-            rpc_order_heap;
+        /**
+         * Ordered rpcs that arrived before an earlier one, an rpc is stored at its rpc_id modulo
+         * the size of the window. The size is a power of two and grows when an rpc arrives too far
+         * ahead of next_rpc_id_to_receive.
+         */
+        std::vector<Rpc_Message*> reorder_window = std::vector<Rpc_Message*>(16, nullptr);
+        // The sequence of the next unreliable rpc sent to the connection
+        long next_unreliable_sequence = 0;
+        // The newest sequence received from the connection for each local rpc id
+        std::vector<long> latest_unreliable_sequence;
+        // A client that joins a running match only gets the step frames and the rpcs sent to every
+        // client after its snapshot
+        bool receives_step_frames = true;
+        // Spectators get the step frames late and in batches, see Send_Spectator_Frames
+        bool spectator = false;
+        // The first step frame the spectator needs, the earlier ones are part of its snapshot
+        long first_spectator_step = 0;
+
+        ~Connection_State();
+        /* Holds an rpc that arrived ahead of next_rpc_id_to_receive. */
+        void Hold_Rpc(Rpc_Message* rpc);
+        /* Returns the held rpc with next_rpc_id_to_receive or null if it hasn't arrived yet. */
+        Rpc_Message* Take_Next_Rpc();
     };
 
+    // The records waiting to be sent to a connection
+    struct Message_Batch {
+        std::vector<char> data;
+        void write(const char* bytes, size_t size) { data.insert(data.end(), bytes, bytes + size); }
+    };
+
+    // How many messages are received from the sockets at a time
+    static constexpr int receive_batch_size = 64;
+    // A batch bigger than this is turned into a message before more rpcs are added to it
+    static constexpr size_t max_batch_size = 64 * 1024;
+    // Unreliable messages are kept within a single packet, a lost fragment would lose them all
+    static constexpr size_t max_unreliable_batch_size = 1100;
+    // Reliable records go on the first lane, unreliable ones get their own so that they don't wait
+    // behind large reliable messages
+    static constexpr uint16 reliable_lane = 0;
+    static constexpr uint16 unreliable_lane = 1;
+    // A compressed message can't claim to be bigger than this, so a broken one can't use up memory
+    static constexpr size_t max_decompressed_size = 16 * 1024 * 1024;
+    // Snapshots are sent a few chunks per flush so that they don't hold up the other messages
+    static constexpr size_t snapshot_chunk_size = 16 * 1024;
+    static constexpr int snapshot_chunks_per_flush = 4;
+    static constexpr size_t max_snapshot_size = 256 * 1024 * 1024;
+    // Messages waiting between the I/O thread and the simulation in each direction
+    static constexpr size_t message_queue_size = 4096;
+    // How long the I/O thread sleeps when there was nothing to send or receive
+    static constexpr int io_idle_sleep_us = 250;
+
     std::function<void()> close_network_function;
     bool server;
     Network_State state;
     HSteamListenSocket listen_socket;
     HSteamNetPollGroup poll_group;
     Client_ID remote_host_connection;
-    ISteamNetworkingSockets* connection_api;
+    std::unique_ptr<Transport> transport;
     // Connected clients and the next rpc id to send to them
     std::unordered_map<Client_ID, Connection_State*> connected_clients;
     // The client may connect to the server after it receives an rpc call from the server
@@ -110,16 +223,174 @@ class Network {
     std::vector<std::tuple<Client_ID, Rpc_Message*>> pre_connected_messages;
     std::vector<Client_ID> newly_connected_clients;
     pthread_mutex_t newly_connected_client_mutex;
-    std::priority_queue<Rpc_Message*, std::vector<Rpc_Message*>, Rpc_Step_Comparator> rpc_step_heap;
+    /**
+     * The rpcs waiting for their step, the bucket at step modulo the number of buckets holds the
+     * rpcs of that step in the order they were received. Only steps after last_processed_step are
+     * stored so the buckets never mix steps. The number of buckets is a power of two and grows when
+     * an rpc arrives too far ahead.
+     */
+    std::vector<std::vector<Rpc_Message*>> step_buckets =
+        std::vector<std::vector<Rpc_Message*>>(16);
+    // Rpcs the clients sent to be called at the start of the next step on the server
+    std::vector<Rpc_Message*> next_step_rpcs;
+    std::vector<Rpc_Message*> step_rpcs_to_call;
     long last_step = 0;
+    long last_processed_step = -1;
+    // Holds the packed rpcs until they are sent, every pack rewinds it once it is done
+    Frame_Arena pack_arena;
+    // The rpcs sent to each connection since the last flush
+    std::unordered_map<Client_ID, Message_Batch> outgoing_batches;
+    std::unordered_map<Client_ID, Message_Batch> outgoing_unreliable_batches;
+    std::vector<ISteamNetworkingMessage*> outgoing_messages;
+    // Reliable messages of at least this many bytes are compressed
+    size_t compression_threshold = 512;
+    // Holds the compressed message before it is copied into the outgoing message
+    Message_Batch compression_buffer;
+    Compression_Stats compression_stats;
+    Traffic_Stats traffic_stats;
+    // The packed calls of the rpcs of a step, they are the same for every client
+    struct Step_Frame {
+        Message_Batch calls;
+        uint32_t count = 0;
+        std::vector<Rpc_ID> rpc_ids;
+    };
+
+    // How the rpc ids of this machine and of a connection relate to each other
+    struct Rpc_Id_Map {
+        // The local id of each id the connection told us about, unknown ids map to no_rpc
+        std::vector<Rpc_ID> remote_to_local;
+        // If the connection was told the name of each local id yet
+        std::vector<bool> announced;
+    };
+    // The step rpcs the server is holding until their step is sent to the clients
+    std::map<long, Step_Frame> step_frames;
+    // The step frames the players already got that are held until they are sent to the spectators
+    std::map<long, Step_Frame> spectator_frames;
+    std::unordered_map<Client_ID, Rpc_Id_Map> rpc_id_maps;
+    // Set once the server sent the first step frame, clients connecting later need a snapshot
+    bool sent_step_frames = false;
+
+    struct Snapshot_Transfer {
+        long step = 0;
+        std::vector<char> data;
+        // The bytes sent or received so far
+        size_t offset = 0;
+    };
+    // The snapshots the server is still sending to each client
+    std::unordered_map<Client_ID, Snapshot_Transfer> outgoing_snapshots;
+    // The snapshots of late spectators, held until the delayed steps reach them
+    std::unordered_map<Client_ID, Snapshot_Transfer> held_spectator_snapshots;
+    // The snapshot the client is receiving, or the received one until a receiver is set
+    std::unique_ptr<Snapshot_Transfer> incoming_snapshot;
+    std::function<void(long step, const char* data, size_t size)> snapshot_receiver;
+
+    /**
+     * The I/O thread talks to the sockets so that messages keep moving while the simulation is
+     * busy with a step. It only moves messages, decoding and calling the rpcs stays on the thread
+     * that calls Network_Update. Not started if the transport doesn't need it, then the messages
+     * are moved by Network_Update and Flush_Messages instead.
+     */
+    pthread_t io_thread;
+    std::atomic<bool> io_running = false;
+    // Filled by the I/O thread, drained by Poll_Incoming_Messages
+    Message_Queue incoming_queue = Message_Queue(message_queue_size);
+    // Filled by Flush_Messages, sent by the I/O thread
+    Message_Queue outgoing_queue = Message_Queue(message_queue_size);
+
+    static void* IO_Thread_Function(void* network);
+    void Do_IO_Loop();
+    /* Moves messages from the sockets into the incoming queue, returns false if there were none. */
+    bool Receive_From_Sockets();
+    /* Hands the queued outgoing messages to the sockets, returns false if there were none. */
+    bool Send_Queued_Messages();
+    /* Sends what is still queued, stops the I/O thread and releases what is left in the queues. */
+    void Stop_IO_Thread();
 
     void Poll_Incoming_Messages();
-    static void On_Connect_Changed_Adapter(SteamNetConnectionStatusChangedCallback_t* new_status);
-    static Network* network_instance;
     std::unique_ptr<RPC_Manager> rpc_manager;
 
-    void Receive_Message(Client_ID from, char* data, size_t size);
+    /* Decodes every rpc in the message, the rpcs keep the message alive while they need it. A
+     * decompressed message can't hold another compressed record. */
+    void Receive_Message(Client_ID from, std::shared_ptr<ISteamNetworkingMessage> message,
+                         bool decompressed = false);
+    /* Takes ownership of the rpc and deletes it once it has been invoked. */
     void Receive_Message(Client_ID from, Rpc_Message* rpc);
+    /* Calls an rpc that is next in order now or holds it for its step. */
+    void Deliver_Rpc(Rpc_Message* rpc);
+    /* Holds the rpc until Process_Step_Rpcs reaches its step. */
+    void Add_Step_Rpc(Rpc_Message* rpc);
+    /* Splits a step frame back into its rpcs, returns false if it is cut short or on the server. */
+    bool Receive_Step_Frame(Client_ID from, Rpc_Reader& reader,
+                            const std::shared_ptr<ISteamNetworkingMessage>& message);
+    /* Decompresses the rest of the message and receives the records in it. */
+    bool Receive_Compressed_Message(Client_ID from, Rpc_Reader& reader);
+    /* Adds the chunk to the incoming snapshot, returns false if it is broken or on the server. */
+    bool Receive_Snapshot_Chunk(Rpc_Reader& reader);
+    /* Hands a completely received snapshot to the receiver, if there is one yet. */
+    void Deliver_Snapshot();
+    /* Tells the receivers that a client left and drops everything kept for its connection. */
+    void Remove_Client(HSteamNetConnection connection);
+    /* Writes the step frame to the batch of the client, its calls take the next rpc ids. */
+    void Write_Step_Frame(Client_ID client, Connection_State& connection, long step,
+                          const Step_Frame& frame);
+    bool Has_Spectators() const;
+    /* Writes the next chunk of the snapshot to the batch of the client. */
+    void Write_Snapshot_Chunk(Client_ID client, Snapshot_Transfer& snapshot);
+    /* Drops the step rpcs before step, they are part of the snapshot that was received. */
+    void Skip_To_Step(long step);
+    /* Calls an unreliable rpc unless a newer call to it has already arrived. */
+    bool Receive_Unreliable_Rpc(Client_ID from, Rpc_Reader& reader);
+    /* Receives the rpc now or holds it until the connection is set up. */
+    void Queue_Received_Rpc(Client_ID from, Rpc_Message* rpc);
+    /* Reads the name of a remote rpc id, returns false if the announcement is cut short. */
+    bool Receive_Rpc_Announcement(Client_ID from, Rpc_Reader& reader);
+    /**
+     * Rewrites the id of a received call from the id of the connection to the local id.
+     * @param report If an unknown id should be reported, lost unreliable rpcs can leave gaps
+     * @return false if the connection never announced the id
+     */
+    bool Translate_Rpc_Call(Client_ID from, const char* call, size_t size, bool report = true);
+    /**
+     * Tells the connection the name of the rpc the first time it is sent to it.
+     * Afterwards calls to it only carry the id.
+     */
+    void Announce_Rpc(Client_ID connection, Rpc_ID id);
+    /* Turns the batch into a message for the next flush, compressing it if it is big enough. */
+    void Close_Batch(Client_ID connection, Message_Batch& batch, bool reliable);
+    /**
+     * Compresses the batch into compression_buffer as a compressed record.
+     * @return false if compressing didn't make the batch smaller
+     */
+    bool Compress_Batch(const Message_Batch& batch);
+    /* Returns the batch of the connection with room for at least size more bytes. */
+    Message_Batch& Get_Batch(Client_ID connection, size_t size);
+    Message_Batch& Get_Unreliable_Batch(Client_ID connection, size_t size);
+    /* Writes an unreliable rpc record in front of a call of call_size bytes. */
+    void Write_Unreliable_Header(Client_ID connection, Message_Batch& batch, size_t call_size);
+    /* Gives the connection a lane for reliable and one for unreliable messages. */
+    void Configure_Lanes(HSteamNetConnection connection);
+    /* Returns the id the next rpc sent to the connection gets, only ordered rpcs have one. */
+    long Next_Rpc_Id(Client_ID connection, bool order_sensitive);
+
+    /* Packs the record and the call straight into the batch of the connection. */
+    template <typename... Args>
+    void Send_Call_To_Connection(Client_ID connection, RPC_Manager::Rpc_Delivery delivery,
+                                 long associated_step, const Rpc<Args...>& rpc,
+                                 const Args&... args) {
+        Announce_Rpc(connection, rpc.id);
+        size_t call_size = RPC_Manager::Get_Call_Size(rpc, args...);
+        if (delivery == RPC_Manager::Unreliable_Latest) {
+            Message_Batch& batch = Get_Unreliable_Batch(connection, call_size + 16);
+            Write_Unreliable_Header(connection, batch, call_size);
+            RPC_Manager::Pack_Call(batch, rpc, args...);
+            return;
+        }
+        bool order_sensitive = delivery == RPC_Manager::Reliable_Ordered;
+        Message_Batch& batch = Get_Batch(connection, call_size + 24);
+        Rpc_Message::Write_Header(batch, Next_Rpc_Id(connection, order_sensitive), order_sensitive,
+                                  associated_step, call_size);
+        RPC_Manager::Pack_Call(batch, rpc, args...);
+    }
 
     /**
      * Actually calls the rpc on the server or client.
@@ -128,11 +399,13 @@ class Network {
      * @param data The name and parameters of the function cal
      * @param size The size of the data
      */
-    void invoke_rpc(bool order_sensitive, long associated_step, char* data, size_t size);
+    void invoke_rpc(bool order_sensitive, long associated_step, const char* data, size_t size);
 
   public:
     void On_Connection_Status_Changed(SteamNetConnectionStatusChangedCallback_t* new_status);
-    Network(bool server, std::function<void()> close_network_function);
+    /* Runs over GameNetworkingSockets unless another transport is given. */
+    Network(bool server, std::function<void()> close_network_function,
+            std::unique_ptr<Transport> transport = nullptr);
     ~Network();
     void Start_Network();
     void Network_Update();
@@ -140,9 +413,49 @@ class Network {
     int Get_Num_Connected_Clients() const;
     bool Is_Server() const;
     std::string Get_Network_State_Str() const;
+    /**
+     * Queues the rpc to be sent to the connection with the next Flush_Messages.
+     * The rpcs queued for a connection are sent together as a single message.
+     */
     void Send_Message_To_Client(HSteamNetConnection connection, const Rpc_Message& rpc_message);
     void Send_Message_To_Clients(const Rpc_Message& rpc_message);
     void Send_Message_To_Server(const Rpc_Message& rpc_message);
+    /* Hands every queued rpc to the I/O thread, the rpcs of each connection as one message. */
+    void Flush_Messages();
+    /**
+     * Sends the rpcs of every step up to step to the clients, each step as a single frame.
+     * Until then the server holds the rpcs of a step instead of sending them on their own.
+     * Should be called on the server before telling the clients they can simulate the step.
+     */
+    void Send_Step_Frames(long step);
+    /**
+     * Makes the client a spectator, it isn't sent the step frames with the players anymore.
+     * Instead Send_Spectator_Frames sends them later in batches, so spectators never slow down the
+     * players. Has to be called before the client gets its first step frame or its snapshot.
+     */
+    void Set_Spectator(Client_ID client);
+    /* Sends the spectators the step frames up to step that the players already got. */
+    void Send_Spectator_Frames(long step);
+    /**
+     * Sends the snapshot of the match at the start of step to a client that joined late.
+     * The snapshot is streamed in chunks over the next flushes. The client gets the step frames
+     * from step on, the earlier ones are part of the snapshot.
+     * A spectator would see the match ahead of its delayed steps, so its snapshot is held until
+     * Send_Spectator_Frames sends the frames of step.
+     */
+    void Send_Snapshot(Client_ID client, long step, std::vector<char> data);
+    /**
+     * Sets the function called on the client once a snapshot has been received.
+     * A snapshot that arrived before the receiver was set is passed to it right away.
+     */
+    void Set_Snapshot_Receiver(std::function<void(long step, const char* data, size_t size)>
+                                   receiver);
+    /* Sets the size from which reliable messages are compressed. */
+    void Set_Compression_Threshold(size_t size) { compression_threshold = size; }
+    const Compression_Stats& Get_Compression_Stats() const { return compression_stats; }
+    const Traffic_Stats& Get_Traffic_Stats() const { return traffic_stats; }
+    /* Writes the traffic, rpc and compression stats as a JSON object. */
+    void Write_Stats(std::ostream& out) const;
 
     // Holds aset of subscribers to the networking events that can occur
     std::unique_ptr<std::unordered_set<Network_Events_Receiver*>> connection_events;
@@ -151,29 +464,23 @@ class Network {
      * Calls the function on the server.
      * If the function returns a valid result it calls the function on every client.
      * This method can be called on the server or on any client.
-     * @param order_sensitive If true the rpc has to be called after all previous rpcs are called
-     * @param function_name The name of the function being called
+     * The rpc is delivered the way it was bound with.
+     * @param rpc The handle of the function being called
      * @param args The arguments for the function call
      */
     template <typename... Args>
-    void call_rpc(bool order_sensitive, std::string const& function_name, Args... args) {
-        // TODO: Figure out how to let Rpc_Manager handle packing
-        // clmdep_msgpack::v1::sbuffer* buffer = rpc_manager->pack_rpc(function_name,
-        // std::forward<Args>(args)...);
-        auto call_obj =
-            make_tuple(static_cast<uint8_t>(0), 1, function_name, std::make_tuple(args...));
-
-        auto buffer = new clmdep_msgpack::v1::sbuffer;
-        clmdep_msgpack::v1::pack(*buffer, call_obj);
-
+    void call_rpc(const Rpc<Args...>& rpc, std::type_identity_t<Args>... args) {
+        RPC_Manager::Rpc_Delivery delivery = rpc_manager->Get_Delivery(rpc.id);
         if (server) {
-            invoke_rpc(order_sensitive, -2, buffer->data(), buffer->size());
+            Frame_Arena::Scope scope(pack_arena);
+            Arena_Buffer buffer(pack_arena);
+            RPC_Manager::Pack_Call(buffer, rpc, args...);
+            invoke_rpc(delivery == RPC_Manager::Reliable_Ordered, -2, buffer.data(),
+                       buffer.size());
         } else {
             // Send the rpc call to the server
-            auto rpc_call_data = Rpc_Message(order_sensitive, -2, buffer->data(), buffer->size());
-            Send_Message_To_Server(rpc_call_data);
+            Send_Call_To_Connection(remote_host_connection, delivery, -2, rpc, args...);
         }
-        delete buffer;
     }
 
     /**
@@ -181,52 +488,57 @@ class Network {
      * If the function returns a valid result it calls the function on every client at the same
      * step. This method can be called on the server or on any client but will only be called before
      * the next step on the server after it is received.
-     * @param function_name The name of the function being called
+     * @param rpc The handle of the function being called
      * @param args The arguments for the function call
      */
     template <typename... Args>
-    void call_game_rpc(std::string const& function_name, Args... args) {
-        auto call_obj =
-            make_tuple(static_cast<uint8_t>(0), 1, function_name, std::make_tuple(args...));
-
-        auto buffer = new clmdep_msgpack::v1::sbuffer;
-        clmdep_msgpack::v1::pack(*buffer, call_obj);
-
+    void call_game_rpc(const Rpc<Args...>& rpc, std::type_identity_t<Args>... args) {
         if (server) {
-            invoke_rpc(true, last_step + 1, buffer->data(), buffer->size());
+            Frame_Arena::Scope scope(pack_arena);
+            Arena_Buffer buffer(pack_arena);
+            RPC_Manager::Pack_Call(buffer, rpc, args...);
+            invoke_rpc(true, last_step + 1, buffer.data(), buffer.size());
         } else {
             // Send the rpc call to the server
-            auto rpc_call_data = Rpc_Message(true, -1, buffer->data(), buffer->size());
-            Send_Message_To_Server(rpc_call_data);
+            Send_Call_To_Connection(remote_host_connection, RPC_Manager::Reliable_Ordered, -1, rpc,
+                                    args...);
         }
-        delete buffer;
     }
 
     /**
      * Sends the rpc from the server to be called on the client specified.
      * @param client_id The id of the client to send to
-     * @param function_name The name of the function being called
+     * @param rpc The handle of the function being called
      * @param args The arguments for the function call
      */
     template <typename... Args>
-    void call_rpc_on_client(Client_ID client_id, bool order_sensitive,
-                            std::string const& function_name, Args... args) {
+    void call_rpc_on_client(Client_ID client_id, const Rpc<Args...>& rpc,
+                            std::type_identity_t<Args>... args) {
         if (!Is_Server()) {
             std::cerr << "Trying to call an rpc on another client while not on the server!"
                       << std::endl;
             return;
         }
 
-        auto call_obj =
-            make_tuple(static_cast<uint8_t>(0), 1, function_name, std::make_tuple(args...));
-
-        auto buffer = new clmdep_msgpack::v1::sbuffer;
-        clmdep_msgpack::v1::pack(*buffer, call_obj);
+        Send_Call_To_Connection(client_id, rpc_manager->Get_Delivery(rpc.id), -2, rpc, args...);
+    }
 
-        auto rpc_call_data = Rpc_Message(order_sensitive, -2, buffer->data(), buffer->size());
-        Send_Message_To_Client(client_id, rpc_call_data);
+    /* Sends the rpc from the server to every client that isn't a spectator. */
+    template <typename... Args>
+    void call_rpc_on_players(const Rpc<Args...>& rpc, std::type_identity_t<Args>... args) {
+        for (const auto& [client_id, connection] : connected_clients) {
+            if (connection->receives_step_frames && !connection->spectator)
+                call_rpc_on_client(client_id, rpc, args...);
+        }
+    }
 
-        delete buffer;
+    /* Sends the rpc from the server to every spectator. */
+    template <typename... Args>
+    void call_rpc_on_spectators(const Rpc<Args...>& rpc, std::type_identity_t<Args>... args) {
+        for (const auto& [client_id, connection] : connected_clients) {
+            if (connection->receives_step_frames && connection->spectator)
+                call_rpc_on_client(client_id, rpc, args...);
+        }
     }
 
     /**
@@ -235,29 +547,50 @@ class Network {
      * Note that the RPC call must be bound on both the server and client to work properly.
      * @param function_name The name of the function being bound
      * @param function The logic to run when the function is called
+     * @param delivery How calls to the rpc are sent, must match on every machine
+     * @return The handle used to call the rpc
      */
     template <typename Function>
-    void bind_rpc(std::string const& function_name, Function function) {
-        // Directly calling the dispatcher for now
-        rpc_manager->dispatcher->bind(function_name, function);
+    typename Rpc_Function_Traits<Function>::Handle bind_rpc(
+        std::string const& function_name, Function function,
+        RPC_Manager::Rpc_Delivery delivery = RPC_Manager::Reliable_Ordered) {
+        return rpc_manager->bind_rpc(function_name, function, delivery);
     }
 
     /**
      * Sets up the RPC call only on the server.
      * The function will only be called on the server and will not call on any non-host clients.
-     * Does not do anything if not currently on the server.
+     * Does not bind anything if not currently on the server, but still returns the handle.
      * @param function_name The name of the function being bound
      * @param function The logic to run when the function is called
+     * @param delivery How calls to the rpc are sent
+     * @return The handle used to call the rpc
      */
     template <typename Function>
-    void bind_server_rpc(std::string const& function_name, Function function) {
-        if (Is_Server()) {
-            // Directly calling the dispatcher for now
-            rpc_manager->dispatcher->bind(function_name, function);
-        }
+    typename Rpc_Function_Traits<Function>::Handle bind_server_rpc(
+        std::string const& function_name, Function function,
+        RPC_Manager::Rpc_Delivery delivery = RPC_Manager::Reliable_Ordered) {
+        if (Is_Server())
+            return rpc_manager->bind_rpc(function_name, function, delivery);
+        return {rpc_manager->Register(function_name, delivery)};
+    }
+
+    /* Returns the handle of an rpc that might only be bound on another machine. */
+    template <typename... Args>
+    Rpc<Args...> Get_Rpc(std::string const& function_name,
+                         RPC_Manager::Rpc_Delivery delivery = RPC_Manager::Reliable_Ordered) {
+        return rpc_manager->Get_Rpc<Args...>(function_name, delivery);
     }
 
     void Process_Step_Rpcs(long step);
+    /* Called by Process_Step_Rpcs with every call right before it is run, see Replay_Writer. */
+    std::function<void(long step, const char* call, size_t size)> on_step_rpc;
+    /**
+     * Holds a recorded call until Process_Step_Rpcs reaches its step, used to play a replay.
+     * The call isn't copied, so it has to stay alive until the step is processed.
+     */
+    void Queue_Recorded_Rpc(long step, const char* call, size_t size);
+    /* The local id of the rpc, registering the name if it hasn't been seen yet. */
+    Rpc_ID Get_Rpc_Id(const std::string& name) { return rpc_manager->Get_Id(name); }
+    const std::string& Get_Rpc_Name(Rpc_ID id) const { return rpc_manager->Get_Name(id); }
 };
-
-void Debug_Output(ESteamNetworkingSocketsDebugOutputType error_type, const char* pszMsg);
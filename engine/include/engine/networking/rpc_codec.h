@@ -0,0 +1,196 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Binary encoding of rpc calls and the network messages that carry them.
+ * The layout of a call is fixed by the signature of the bound function, so nothing about the types
+ * is sent:
+ * - integers are varints, signed ones zigzag encoded so that small negatives stay small
+ * - floats and doubles are sent as their little endian bits
+ * - the bools of a call are packed into bit flags in front of the other arguments
+ * - strings are a varint size followed by the bytes
+ * Streams only need a write(const char*, size_t) method.
+ */
+
+/* Counts the bytes that would be written, used to size a call before it is encoded. */
+struct Rpc_Size_Counter {
+    size_t size = 0;
+    void write(const char*, size_t bytes) { size += bytes; }
+};
+
+/**
+ * Reads encoded values from a buffer.
+ * Reading past the end sets failed and returns zeros instead of reading out of bounds, so a
+ * message only has to be checked once after it is read.
+ */
+class Rpc_Reader {
+    const unsigned char* position;
+    const unsigned char* end;
+
+  public:
+    bool failed = false;
+
+    Rpc_Reader(const char* data, size_t size)
+        : position(reinterpret_cast<const unsigned char*>(data)),
+          end(reinterpret_cast<const unsigned char*>(data) + size) {}
+
+    bool Done() const { return position == end; }
+    const char* Position() const { return reinterpret_cast<const char*>(position); }
+    size_t Remaining() const { return static_cast<size_t>(end - position); }
+
+    unsigned char Read_Byte();
+    uint64_t Read_Varint();
+    int64_t Read_Signed_Varint();
+    /* Returns a pointer to the next size bytes and skips them. */
+    const char* Read_Bytes(size_t size);
+};
+
+template <typename Stream>
+void Write_Varint(Stream& stream, uint64_t value) {
+    char bytes[10];
+    int size = 0;
+    while (value >= 0x80) {
+        bytes[size++] = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = static_cast<char>(value);
+    stream.write(bytes, size);
+}
+
+template <typename Stream>
+void Write_Signed_Varint(Stream& stream, int64_t value) {
+    Write_Varint(stream, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+/* Encodes a single argument type, specialized for every type an rpc can take. */
+template <typename T, typename Enable = void>
+struct Rpc_Codec {
+    static_assert(sizeof(T) == 0, "This type can't be used as an rpc argument");
+};
+
+template <typename T>
+struct Rpc_Codec<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    template <typename Stream>
+    static void Write(Stream& stream, T value) {
+        if constexpr (std::is_signed_v<T>)
+            Write_Signed_Varint(stream, value);
+        else
+            Write_Varint(stream, value);
+    }
+    static T Read(Rpc_Reader& reader) {
+        if constexpr (std::is_signed_v<T>)
+            return static_cast<T>(reader.Read_Signed_Varint());
+        else
+            return static_cast<T>(reader.Read_Varint());
+    }
+};
+
+template <typename T>
+struct Rpc_Codec<T, std::enable_if_t<std::is_enum_v<T>>> {
+    using Underlying = std::underlying_type_t<T>;
+    template <typename Stream>
+    static void Write(Stream& stream, T value) {
+        Rpc_Codec<Underlying>::Write(stream, static_cast<Underlying>(value));
+    }
+    static T Read(Rpc_Reader& reader) {
+        return static_cast<T>(Rpc_Codec<Underlying>::Read(reader));
+    }
+};
+
+template <typename T>
+struct Rpc_Codec<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+    template <typename Stream>
+    static void Write(Stream& stream, T value) {
+        auto bits = std::bit_cast<Bits>(value);
+        char bytes[sizeof(Bits)];
+        for (size_t i = 0; i < sizeof(Bits); i++)
+            bytes[i] = static_cast<char>(bits >> (8 * i));
+        stream.write(bytes, sizeof(Bits));
+    }
+    static T Read(Rpc_Reader& reader) {
+        const char* data = reader.Read_Bytes(sizeof(Bits));
+        if (data == nullptr)
+            return 0;
+        Bits bits = 0;
+        for (size_t i = 0; i < sizeof(Bits); i++)
+            bits |= static_cast<Bits>(static_cast<unsigned char>(data[i])) << (8 * i);
+        return std::bit_cast<T>(bits);
+    }
+};
+
+template <>
+struct Rpc_Codec<std::string> {
+    template <typename Stream>
+    static void Write(Stream& stream, const std::string& value) {
+        Write_Varint(stream, value.size());
+        stream.write(value.data(), value.size());
+    }
+    static std::string Read(Rpc_Reader& reader) {
+        size_t size = reader.Read_Varint();
+        const char* bytes = reader.Read_Bytes(size);
+        return bytes == nullptr ? std::string() : std::string(bytes, size);
+    }
+};
+
+/* Encodes the arguments of a call, the bools go into the flag bytes in front. */
+template <typename Stream, typename... Args>
+void Write_Rpc_Args(Stream& stream, const Args&... args) {
+    constexpr int bool_count = (0 + ... + std::is_same_v<Args, bool>);
+    if constexpr (bool_count > 0) {
+        char flags[(bool_count + 7) / 8] = {};
+        int bit = 0;
+        (
+            [&] {
+                if constexpr (std::is_same_v<Args, bool>) {
+                    if (args)
+                        flags[bit / 8] |= static_cast<char>(1 << bit % 8);
+                    bit++;
+                }
+            }(),
+            ...);
+        stream.write(flags, sizeof(flags));
+    }
+    (
+        [&] {
+            if constexpr (!std::is_same_v<Args, bool>)
+                Rpc_Codec<Args>::Write(stream, args);
+        }(),
+        ...);
+}
+
+/**
+ * Decodes the arguments written by Write_Rpc_Args into a tuple.
+ * Check reader.failed afterwards, the values are zeroed if the call was too short.
+ */
+template <typename... Args>
+std::tuple<Args...> Read_Rpc_Args(Rpc_Reader& reader) {
+    constexpr int bool_count = (0 + ... + std::is_same_v<Args, bool>);
+    std::tuple<Args...> values;
+    const char* flags = nullptr;
+    if constexpr (bool_count > 0)
+        flags = reader.Read_Bytes((bool_count + 7) / 8);
+    int bit = 0;
+    // The comma fold reads the arguments in the order they were written
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (
+            [&] {
+                using T = std::tuple_element_t<I, std::tuple<Args...>>;
+                if constexpr (std::is_same_v<T, bool>) {
+                    std::get<I>(values) = flags != nullptr && flags[bit / 8] >> bit % 8 & 1;
+                    bit++;
+                } else {
+                    std::get<I>(values) = Rpc_Codec<T>::Read(reader);
+                }
+            }(),
+            ...);
+    }(std::index_sequence_for<Args...>());
+    return values;
+}
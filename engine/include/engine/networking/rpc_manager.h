@@ -1,6 +1,44 @@
 #pragma once
+#include "rpc_codec.h"
+#include <deque>
+#include <functional>
 #include <memory>
-#include <rpc/dispatcher.h>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t Rpc_ID;
+
+/**
+ * Typed handle to a registered rpc, the arguments of a call are checked against Args.
+ * Handles are returned by bind_rpc and Get_Rpc.
+ */
+template <typename... Args>
+struct Rpc {
+    Rpc_ID id = 0;
+};
+
+/* Finds the argument types of a function or lambda bound as an rpc. */
+template <typename Function>
+struct Rpc_Function_Traits : Rpc_Function_Traits<decltype(&Function::operator())> {};
+
+template <typename Result, typename... Args>
+struct Rpc_Function_Traits<Result (*)(Args...)> {
+    using Handle = Rpc<std::decay_t<Args>...>;
+    static std::tuple<std::decay_t<Args>...> Read_Args(Rpc_Reader& reader) {
+        return Read_Rpc_Args<std::decay_t<Args>...>(reader);
+    }
+};
+
+template <typename Class, typename Result, typename... Args>
+struct Rpc_Function_Traits<Result (Class::*)(Args...)>
+    : Rpc_Function_Traits<Result (*)(Args...)> {};
+
+template <typename Class, typename Result, typename... Args>
+struct Rpc_Function_Traits<Result (Class::*)(Args...) const>
+    : Rpc_Function_Traits<Result (*)(Args...)> {};
 
 class RPC_Manager {
 public:
@@ -10,21 +48,102 @@ public:
         VALID_CALL_ON_CLIENTS,
     };
 
+    /* How calls to an rpc are sent over the network. */
+    enum Rpc_Delivery {
+        // Called in the order they were sent, after every earlier ordered rpc
+        Reliable_Ordered,
+        // Always arrives but doesn't wait for earlier rpcs
+        Reliable_Unordered,
+        // Can be lost, a call that arrives after a newer call to the same rpc is dropped.
+        // For state that is resent often, like progress reports.
+        Unreliable_Latest,
+    };
+
+private:
+    struct Rpc_Binding {
+        std::string name;
+        Rpc_Delivery delivery = Reliable_Ordered;
+        // Decodes the arguments and calls the bound function, empty until the rpc is bound
+        std::function<Rpc_Validator_Result(Rpc_Reader&)> thunk;
+    };
+
+    // Indexed by Rpc_ID. A deque, because a running rpc can register new ones, like starting the
+    // game does, and that must not move the thunk that is being called
+    std::deque<Rpc_Binding> bindings;
+    std::unordered_map<std::string, Rpc_ID> ids;
+
 public:
-    RPC_Manager();
-    template<typename... Elements>
-    void call_rpc(std::string const& function_name, std::tuple<Elements...> args) const;
-    Rpc_Validator_Result call_data_rpc(char* data, size_t length) const;
+    RPC_Manager() = default;
+
+    /**
+     * Returns the local id of the rpc, registering the name if it hasn't been seen yet.
+     * Ids are only valid on this machine, the Network agrees on them with each connection.
+     */
+    Rpc_ID Get_Id(std::string const& function_name);
+    const std::string& Get_Name(Rpc_ID id) const { return bindings[id].name; }
+    Rpc_Delivery Get_Delivery(Rpc_ID id) const { return bindings[id].delivery; }
+    /* Returns the local id of the rpc and sets how it is delivered. */
+    Rpc_ID Register(std::string const& function_name, Rpc_Delivery delivery) {
+        Rpc_ID id = Get_Id(function_name);
+        bindings[id].delivery = delivery;
+        return id;
+    }
+    size_t Get_Rpc_Count() const { return bindings.size(); }
+
+    /* Returns a handle to the rpc without binding it, for rpcs bound on another machine. */
+    template <typename... Args>
+    Rpc<Args...> Get_Rpc(std::string const& function_name,
+                         Rpc_Delivery delivery = Reliable_Ordered) {
+        return Rpc<Args...>{Register(function_name, delivery)};
+    }
+
+    /**
+     * Binds the function to the rpc, the function must return an Rpc_Validator_Result.
+     * @return The handle used to call the rpc
+     */
     template <typename Function>
-    void bind_rpc(std::string const& function_name, Function function);
-    // Making this public for now until I figure out how to pass a function to bind_rpc
-    std::shared_ptr<rpc::detail::dispatcher> dispatcher;
+    typename Rpc_Function_Traits<Function>::Handle bind_rpc(
+        std::string const& function_name, Function function,
+        Rpc_Delivery delivery = Reliable_Ordered) {
+        Rpc_ID id = Register(function_name, delivery);
+        bindings[id].thunk = [function](Rpc_Reader& reader) {
+            auto values = Rpc_Function_Traits<Function>::Read_Args(reader);
+            // Calls with missing or extra bytes were packed for a different signature
+            if (reader.failed || !reader.Done())
+                return INVALID;
+            return static_cast<Rpc_Validator_Result>(std::apply(function, values));
+        };
+        return {id};
+    }
+
+    Rpc_Validator_Result call_data_rpc(const char* data, size_t length) const;
 
     /**
-     * Converts the given function name and arguments into the serialized representation of the data along with its length.
+     * Packs the call as its id followed by the arguments encoded by Write_Rpc_Args.
+     * The id is always 2 bytes so that it can be rewritten in place by Write_Id.
      */
+    template <typename Stream, typename... Args>
+    static void Pack_Call(Stream& stream, const Rpc<Args...>& rpc, const Args&... args) {
+        char id[id_size];
+        Write_Id(id, rpc.id);
+        stream.write(id, id_size);
+        Write_Rpc_Args(stream, args...);
+    }
+
+    /* The number of bytes Pack_Call writes. */
     template <typename... Args>
-    clmdep_msgpack::v1::sbuffer* pack_rpc(std::string const& function_name, Args... args);
-};
+    static size_t Get_Call_Size(const Rpc<Args...>&, const Args&... args) {
+        Rpc_Size_Counter counter;
+        Write_Rpc_Args(counter, args...);
+        return id_size + counter.size;
+    }
+
+    static constexpr size_t id_size = 2;
+    // The largest id that fits in id_size is never registered, it marks unknown calls
+    static constexpr Rpc_ID no_rpc = 0xffff;
 
-MSGPACK_ADD_ENUM(RPC_Manager::Rpc_Validator_Result);
+    /* Returns the id of a packed call. */
+    static Rpc_ID Read_Id(const char* data);
+    /* Replaces the id of a packed call. */
+    static void Write_Id(char* data, Rpc_ID id);
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <steam/isteamnetworkingsockets.h>
+
+/**
+ * The sockets the Network sends its messages over.
+ * Mirrors the part of ISteamNetworkingSockets that the Network uses, so the Network can run over
+ * GameNetworkingSockets or over the in process Loopback_Transport in tests and benchmarks.
+ * Send_Messages and the Receive functions are called from the I/O thread of the Network, the other
+ * functions from the thread that calls Network_Update. A transport without an I/O thread gets all
+ * calls from the thread that calls Network_Update.
+ */
+class Transport {
+  public:
+    using Status_Callback = std::function<void(SteamNetConnectionStatusChangedCallback_t*)>;
+
+    virtual ~Transport() = default;
+
+    /**
+     * Sets up the transport, the callback is called from Run_Callbacks for every change of the
+     * state of a connection.
+     * @return false if the transport can't be used
+     */
+    virtual bool Start(Status_Callback status_callback) = 0;
+
+    virtual HSteamListenSocket Listen(uint16 port) = 0;
+    virtual void Close_Listen_Socket(HSteamListenSocket listen_socket) = 0;
+    virtual HSteamNetConnection Connect(uint16 port) = 0;
+    virtual HSteamNetPollGroup Create_Poll_Group() = 0;
+    virtual void Destroy_Poll_Group(HSteamNetPollGroup poll_group) = 0;
+
+    virtual bool Accept_Connection(HSteamNetConnection connection) = 0;
+    virtual bool Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                           HSteamNetPollGroup poll_group) = 0;
+    virtual void Set_Connection_Name(HSteamNetConnection connection, const char* name) = 0;
+    virtual bool Configure_Lanes(HSteamNetConnection connection, int lane_count,
+                                 const int* priorities, const uint16* weights) = 0;
+    virtual void Close_Connection(HSteamNetConnection connection, int reason,
+                                  const char* debug_message) = 0;
+
+    /* Returns a message with room for size bytes, sending or releasing it frees it. */
+    virtual ISteamNetworkingMessage* Allocate_Message(int size) = 0;
+    /* Takes ownership of the messages, the messages of each connection arrive in order. */
+    virtual void Send_Messages(int count, ISteamNetworkingMessage* const* messages) = 0;
+    /* Both return the number of messages received or a negative number on an error. */
+    virtual int Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                               ISteamNetworkingMessage** messages, int max) = 0;
+    virtual int Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                               ISteamNetworkingMessage** messages, int max) = 0;
+
+    /* Calls the status callback for the changes since the last call. */
+    virtual void Run_Callbacks() = 0;
+
+    /* If the Network should poll the transport on its own I/O thread. */
+    virtual bool Needs_IO_Thread() const { return true; }
+};
+
+/* The GameNetworkingSockets library, only one can exist at a time. */
+class Steam_Transport : public Transport {
+    ISteamNetworkingSockets* sockets = nullptr;
+    Status_Callback status_callback;
+    bool started = false;
+
+    static Steam_Transport* transport_instance;
+    static void On_Status_Changed_Adapter(SteamNetConnectionStatusChangedCallback_t* new_status);
+
+  public:
+    ~Steam_Transport() override;
+
+    bool Start(Status_Callback status_callback) override;
+    HSteamListenSocket Listen(uint16 port) override;
+    void Close_Listen_Socket(HSteamListenSocket listen_socket) override;
+    HSteamNetConnection Connect(uint16 port) override;
+    HSteamNetPollGroup Create_Poll_Group() override;
+    void Destroy_Poll_Group(HSteamNetPollGroup poll_group) override;
+    bool Accept_Connection(HSteamNetConnection connection) override;
+    bool Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                   HSteamNetPollGroup poll_group) override;
+    void Set_Connection_Name(HSteamNetConnection connection, const char* name) override;
+    bool Configure_Lanes(HSteamNetConnection connection, int lane_count, const int* priorities,
+                         const uint16* weights) override;
+    void Close_Connection(HSteamNetConnection connection, int reason,
+                          const char* debug_message) override;
+    ISteamNetworkingMessage* Allocate_Message(int size) override;
+    void Send_Messages(int count, ISteamNetworkingMessage* const* messages) override;
+    int Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    int Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                       ISteamNetworkingMessage** messages, int max) override;
+    void Run_Callbacks() override;
+};
@@ -13,4 +13,6 @@ class Player {
         : client_id(client_id), player_id(player_id), ai(false) {}
 
     Player(Player_ID player_id) : client_id(0), player_id(player_id), ai(true) {}
+    // The games delete their players through this class
+    virtual ~Player() = default;
 };
\ No newline at end of file
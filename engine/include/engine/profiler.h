@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ECS;
+
+/**
+ * Records how long each part of ECS::Update takes: every step, block, system chunk,
+ * Complete_Work, Clean_Up and the create and delete phases.
+ * Each thread records into its own buffer so that recording never takes a lock,
+ * the buffers are merged into the stats at the end of every step.
+ * When disabled the only cost is a relaxed load per recording site.
+ */
+class ECS_Profiler {
+  public:
+    enum Event_Type {
+        Step,
+        Block,
+        System_Chunk,
+        Complete_Work,
+        Clean_Up,
+        Create_Entities,
+        Delete_Entities,
+    };
+
+    struct Event {
+        Event_Type type;
+        // The block index for blocks or the system index for system chunks
+        int index;
+        // 0 is the thread calling ECS::Update, workers start at 1
+        int thread;
+        // Nanoseconds since the profiler was created
+        long start;
+        long duration;
+    };
+
+    /* The times of a single step in nanoseconds */
+    struct Step_Stats {
+        long step_time;
+        long clean_up_time;
+        long create_time;
+        long delete_time;
+        std::vector<long> block_times;
+        // Summed over all threads that worked on the system
+        std::vector<long> system_times;
+        std::vector<int> system_chunks;
+    };
+
+    /* Totals for a single thread since the worker stats were last reset, times in nanoseconds */
+    struct Worker_Stats {
+        long chunks;
+        long entities;
+        // Time spent running systems
+        long busy_time;
+        // Time spent sleeping after finding no work
+        long idle_time;
+        // Time spent waiting to lock the work queue
+        long lock_wait_time;
+        // How often the thread checked the work queue and found it empty
+        long empty_polls;
+    };
+
+  private:
+    // Each thread only writes its own counters, aligned so that they don't share a cache line
+    struct alignas(64) Worker_Counters {
+        std::atomic_long chunks;
+        std::atomic_long entities;
+        std::atomic_long busy_time;
+        std::atomic_long idle_time;
+        std::atomic_long lock_wait_time;
+        std::atomic_long empty_polls;
+    };
+
+    ECS& ecs;
+    std::atomic_bool enabled;
+    std::chrono::steady_clock::time_point start_time;
+    std::vector<std::vector<Event>> thread_events;
+    int thread_count;
+    std::unique_ptr<Worker_Counters[]> worker_counters;
+    long worker_stats_start;
+    // When the profiler was last disabled, the worker stats don't cover the time after it
+    long worker_stats_end;
+    long steps;
+    // Prints and resets the worker stats every this many steps, 0 to never print
+    int worker_stats_interval;
+
+    // Rolling window of the most recent steps
+    std::vector<Step_Stats> history;
+    int history_start;
+    int history_count;
+
+    // Only collected while a trace is running
+    std::vector<Event> trace_events;
+    int trace_steps_left;
+    std::string trace_path;
+
+  public:
+    ECS_Profiler(ECS& ecs, int thread_count, int history_size = 300);
+
+    bool Is_Enabled() const { return enabled.load(std::memory_order_relaxed); }
+    /* Should only be called in between steps. */
+    void Set_Enabled(bool enabled);
+
+    /**
+     * Returns the current time in nanoseconds or 0 if the profiler is disabled.
+     * Events that started at 0 are ignored, they began before the profiler was enabled.
+     */
+    long Now() const {
+        if (!Is_Enabled())
+            return 0;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start_time)
+            .count();
+    }
+
+    /* Records an event that started at start and ended now, does nothing if disabled. */
+    void Record(int thread, Event_Type type, int index, long start) {
+        if (!Is_Enabled() || start == 0)
+            return;
+        thread_events[thread].emplace_back(type, index, thread, start, Now() - start);
+    }
+
+    /* Records a system chunk of entity_count entities that started at start. */
+    void Record_Chunk(int thread, int system_index, int entity_count, long start) {
+        if (!Is_Enabled() || start == 0)
+            return;
+        long duration = Now() - start;
+        thread_events[thread].emplace_back(System_Chunk, system_index, thread, start, duration);
+        Worker_Counters& counters = worker_counters[thread];
+        counters.chunks.fetch_add(1, std::memory_order_relaxed);
+        counters.entities.fetch_add(entity_count, std::memory_order_relaxed);
+        counters.busy_time.fetch_add(duration, std::memory_order_relaxed);
+    }
+
+    void Record_Lock_Wait(int thread, long start) {
+        if (!Is_Enabled() || start == 0)
+            return;
+        worker_counters[thread].lock_wait_time.fetch_add(Now() - start,
+                                                         std::memory_order_relaxed);
+    }
+
+    /* Records a poll that found no work and the time slept afterwards. */
+    void Record_Idle(int thread, long start) {
+        if (!Is_Enabled() || start == 0)
+            return;
+        worker_counters[thread].empty_polls.fetch_add(1, std::memory_order_relaxed);
+        worker_counters[thread].idle_time.fetch_add(Now() - start, std::memory_order_relaxed);
+    }
+
+    /* Merges the events recorded by every thread during the step, called by ECS::Update. */
+    void End_Step();
+
+    /**
+     * Enables the profiler and records every event of the next steps.
+     * Once the steps have been recorded the trace is written to the path in the Chrome trace
+     * format, which can be opened with chrome://tracing or https://ui.perfetto.dev.
+     */
+    void Start_Trace(int steps, std::string path);
+    bool Is_Tracing() const { return trace_steps_left > 0; }
+    void Write_Chrome_Trace(const std::string& path) const;
+
+    /* Returns the stats of the recorded steps, oldest first. */
+    std::vector<Step_Stats> Get_Step_History() const;
+    Step_Stats Get_Average_Stats() const;
+    void Print_Summary(std::ostream& out) const;
+    void Clear_History();
+    /* Sets how many steps are kept in the history, clears the history. */
+    void Set_History_Size(int size);
+
+    std::string Get_Event_Name(const Event& event) const;
+
+    /* Returns the stats of every thread, index 0 is the thread calling ECS::Update. */
+    std::vector<Worker_Stats> Get_Worker_Stats() const;
+    void Reset_Worker_Stats();
+    /* Prints the stats and the utilization of every thread since the last reset. */
+    void Print_Worker_Stats(std::ostream& out) const;
+    /* Prints and resets the worker stats every steps steps while enabled, 0 turns it off. */
+    void Set_Worker_Stats_Interval(int steps) { worker_stats_interval = steps; }
+};
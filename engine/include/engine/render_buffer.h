@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <unordered_map>
+
+#include "ecs.h"
+
+/* The transforms of the rendered entities at the end of a step. */
+struct Render_State {
+    long step = -1;
+    std::unordered_map<Entity_ID, Transform_Component> transforms;
+};
+
+/**
+ * Hands the render states from the simulation to the renderer without either waiting on the other.
+ * The simulation writes into its own state and publishes it, the renderer takes the newest
+ * published state and keeps the one before it to interpolate between the two.
+ * Each side may run on its own thread, though the client still renders on the simulating one.
+ */
+class Render_Buffer {
+    static constexpr int fresh_bit = 4;
+    static constexpr int index_mask = 3;
+
+    Render_State states[4];
+    // The newest published state, fresh_bit is set until the renderer took it
+    std::atomic<int> ready = 1;
+    // Owned by the simulation
+    int writing = 0;
+    // Owned by the renderer
+    int current = 2;
+    int previous = 3;
+
+  public:
+    /* Returns the cleared state for the simulation to fill. */
+    Render_State& Begin_Write();
+    void Publish();
+
+    /* Takes the newest published state if there is one, returns false otherwise. */
+    bool Read();
+    const Render_State& Get_Current() const { return states[current]; }
+    const Render_State& Get_Previous() const { return states[previous]; }
+};
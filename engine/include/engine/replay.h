@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Network;
+
+/**
+ * A lockstep match is decided by its seed and the rpcs each step runs, so a replay only stores
+ * those and simulates the match again to watch it.
+ * The file starts with a header holding the seed and the setup the game needs to build the same
+ * world, followed by records in step order, values use the rpc encoding, see rpc_codec.h:
+ * - the name of an rpc id, written before the first call to it since ids are local per machine
+ * - a call run by Process_Step_Rpcs
+ * - a hash of the state of a step, to find the first step a playback desyncs at
+ * - the step the match ended at
+ * Every record stores its step as the difference to the step of the record before it.
+ */
+enum Replay_Record : unsigned char {
+    Replay_Name_Record,
+    Replay_Rpc_Record,
+    Replay_Hash_Record,
+    Replay_End_Record,
+};
+
+/* FNV-1a of the bytes, used to compare the state of a step between machines. */
+uint64_t Hash_State(const char* data, size_t size);
+
+/* Writes the replay of a match while it is being played. */
+class Replay_Writer {
+    std::ofstream file;
+    Network& network;
+    // Indexed by Rpc_ID, set once the name of the id has been written
+    std::vector<bool> named_rpcs;
+    long last_step = 0;
+
+    void Write_Record(Replay_Record record, long step);
+
+  public:
+    explicit Replay_Writer(Network& network) : network(network) {}
+    /* Writes the end of the match if it wasn't written yet and stops recording. */
+    ~Replay_Writer();
+
+    void write(const char* bytes, size_t size) { file.write(bytes, size); }
+
+    /**
+     * Opens the file, writes the header and starts recording the step rpcs of the network.
+     * @param setup What the game needs besides the seed to build the world again, like the players
+     */
+    bool Open(const std::string& path, long seed, const std::vector<char>& setup);
+    bool Is_Open() const { return file.is_open(); }
+    void Write_Rpc(long step, const char* call, size_t size);
+    void Write_Hash(long step, uint64_t hash);
+    /* Writes the last step of the match and closes the file. */
+    void Close(long step);
+};
+
+/**
+ * Reads a whole replay into memory and feeds its calls to a Network that simulates the match.
+ * The Network should be a server without any clients that is never started, like in the headless
+ * tools, so that its Game_Manager steps as fast as it is updated.
+ */
+class Replay_Reader {
+    struct Replay_Rpc {
+        long step;
+        const char* call;
+        size_t size;
+    };
+
+    // The calls point into the data, their ids are rewritten to the local ids when loaded
+    std::vector<char> data;
+    std::vector<Replay_Rpc> rpcs;
+    size_t next_rpc = 0;
+    std::unordered_map<long, uint64_t> hashes;
+
+  public:
+    long seed = 0;
+    std::vector<char> setup;
+    // The step the match ended at, or the step of the last record if the recording was cut off
+    long end_step = 0;
+
+    /**
+     * Reads the replay and maps the rpcs it recorded to the local ids of the network.
+     * @return false if the file can't be read or is broken
+     */
+    bool Open(const std::string& path, Network& network);
+    /* Queues the recorded calls up to the step, call before the Game_Manager simulates it. */
+    void Queue_Step_Rpcs(Network& network, long step);
+    size_t Get_Rpc_Count() const { return rpcs.size(); }
+    size_t Get_Hash_Count() const { return hashes.size(); }
+    /* Returns the recorded hash of the step, or null if none was recorded for it. */
+    const uint64_t* Get_Hash(long step) const;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "entity_list.h"
+#include "networking/rpc_codec.h"
+
+/**
+ * Objects that exist on every machine outside of the ECS, like paths, textures and players.
+ * Components point at them directly, so a snapshot stores the index they were registered at
+ * instead. Every machine has to register the same objects in the same order before a snapshot is
+ * saved or loaded. Null is always index 0.
+ */
+class Snapshot_Pointers {
+    std::vector<void*> pointers = std::vector<void*>(1, nullptr);
+    std::unordered_map<const void*, uint32_t> indices;
+
+  public:
+    void Register(void* pointer);
+    /* Returns the index of the pointer, or no_pointer if it was never registered. */
+    uint32_t Get_Index(const void* pointer) const;
+    /* Returns the pointer at the index, or null if the index is out of range. */
+    void* Get_Pointer(uint32_t index) const {
+        return index < pointers.size() ? pointers[index] : nullptr;
+    }
+
+    static constexpr uint32_t no_pointer = UINT32_MAX;
+};
+
+/**
+ * Writes the state of a match so that another machine can continue simulating from it.
+ * Values are written with the rpc encoding, see rpc_codec.h.
+ */
+class Snapshot_Writer {
+  public:
+    std::vector<char> data;
+    const Snapshot_Pointers& pointers;
+
+    explicit Snapshot_Writer(const Snapshot_Pointers& pointers) : pointers(pointers) {}
+
+    void write(const char* bytes, size_t size) { data.insert(data.end(), bytes, bytes + size); }
+
+    template <typename T>
+    void Write(const T& value) {
+        Rpc_Codec<T>::Write(*this, value);
+    }
+
+    /**
+     * Writes the bytes of a plain value, like a whole component.
+     * Pointers inside it should be written with Write_Pointer and cleared first, so that the same
+     * state gives the same snapshot on every machine.
+     */
+    template <typename T>
+    void Write_Bytes(const T& value) {
+        write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    /* Writes a registered pointer as its index, an unregistered pointer is written as null. */
+    void Write_Pointer(const void* pointer);
+
+    /* Writes the items of a list of plain values. */
+    template <typename T, int N>
+    void Write_List(const Entity_List<T, N>& list) {
+        Write_Varint(*this, list.size());
+        write(reinterpret_cast<const char*>(list.data()), sizeof(T) * list.size());
+    }
+
+    /* Writes a list of registered pointers. */
+    template <typename T, int N>
+    void Write_Pointer_List(const Entity_List<T*, N>& list) {
+        Write_Varint(*this, list.size());
+        for (const T* pointer : list)
+            Write_Pointer(pointer);
+    }
+};
+
+/**
+ * Reads a snapshot written by Snapshot_Writer.
+ * Like the Rpc_Reader it returns zeros after reading past the end, check failed once done.
+ */
+class Snapshot_Reader : public Rpc_Reader {
+  public:
+    const Snapshot_Pointers& pointers;
+
+    Snapshot_Reader(const char* data, size_t size, const Snapshot_Pointers& pointers)
+        : Rpc_Reader(data, size), pointers(pointers) {}
+
+    template <typename T>
+    T Read() {
+        return Rpc_Codec<T>::Read(*this);
+    }
+
+    /* Reads a value written by Write_Bytes, the value is left as is if the snapshot ended. */
+    template <typename T>
+    void Read_Bytes_Into(T& value) {
+        if (const char* bytes = Read_Bytes(sizeof(T)))
+            memcpy(&value, bytes, sizeof(T));
+    }
+
+    template <typename T>
+    T* Read_Pointer() {
+        return static_cast<T*>(pointers.Get_Pointer(static_cast<uint32_t>(Read_Varint())));
+    }
+
+    /**
+     * Replaces the items of the list, the list must not own a page yet.
+     * Components are loaded into zeroed memory, so their lists start out empty.
+     */
+    template <typename T, int N>
+    void Read_List(Entity_List<T, N>& list, Side_Storage& storage) {
+        size_t count = Read_Varint();
+        const char* items = Read_Bytes(sizeof(T) * count);
+        if (items == nullptr)
+            return;
+        for (size_t i = 0; i < count; i++) {
+            T item;
+            memcpy(&item, items + sizeof(T) * i, sizeof(T));
+            list.Push_Back(storage, item);
+        }
+    }
+
+    template <typename T, int N>
+    void Read_Pointer_List(Entity_List<T*, N>& list, Side_Storage& storage) {
+        size_t count = Read_Varint();
+        for (size_t i = 0; i < count && !failed; i++)
+            list.Push_Back(storage, Read_Pointer<T>());
+    }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps the last samples of a measurement in a ring buffer to report their distribution.
+ * Adding a sample never allocates.
+ */
+class Stat_Histogram {
+    std::vector<float> samples;
+    size_t next = 0;
+    size_t count = 0;
+    // Every sample ever added, not just the kept ones
+    long total_count = 0;
+    double total = 0;
+
+  public:
+    explicit Stat_Histogram(size_t capacity = 1024);
+
+    void Add(float sample);
+    long Get_Total_Count() const { return total_count; }
+    double Get_Total() const { return total; }
+    /**
+     * Writes the kept samples as a JSON object with their count, average, p50, p90, p99 and max,
+     * plus the count and sum of every sample ever added.
+     */
+    void Write_Json(std::ostream& out) const;
+};
+
+/**
+ * Writes the stats of the application as one JSON object per line, so that the reports of a
+ * running server can be followed and parsed line by line.
+ * Every part of the application adds a section that writes its own JSON value.
+ */
+class Stats_Reporter {
+    struct Section {
+        std::string name;
+        std::function<void(std::ostream& out)> write;
+    };
+
+    std::vector<Section> sections;
+    std::ofstream file;
+    std::ostream* output = nullptr;
+    std::chrono::milliseconds interval{0};
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point next_report;
+
+  public:
+    /* Reports every interval to the file, which is overwritten. The path "-" reports to stdout. */
+    bool Start(const std::string& path, std::chrono::milliseconds interval);
+    bool Is_Reporting() const { return output != nullptr; }
+    /* The write function has to write exactly one JSON value. Replaces a section of that name. */
+    void Add_Section(const std::string& name, std::function<void(std::ostream& out)> write);
+    void Remove_Section(const std::string& name);
+    /* Writes a report if one is due. */
+    void Update();
+    void Write_Report(std::ostream& out) const;
+};
+
+/* Writes the string with the quotes and escapes of JSON. */
+void Write_Json_String(std::ostream& out, const std::string& value);
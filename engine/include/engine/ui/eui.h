@@ -83,6 +83,7 @@ class EUI_Context {
     void Begin_Frame();
     void End_Frame();
     void Update_Input();
+    /* Lays out the tree once if anything was marked dirty since the last layout. */
     void Perform_Layout();
     void Handle_Input();
     void Render();
@@ -106,6 +107,8 @@ class EUI_Element {
     bool is_focused = false;
     bool is_active = false;
     bool is_deleted = false;
+    // Set when the element or one of its children needs to be measured again
+    bool layout_dirty = true;
 
     // style attributes
     // Optional styles are inherited if not explicitly set
@@ -164,7 +167,14 @@ class EUI_Element {
     virtual void Set_Context(EUI_Context& ctx);
     virtual void Delete() { is_deleted = true; }
 
-    // layout
+    /**
+     * Marks the element and its parents to be laid out in the next Perform_Layout.
+     * Needs to be called after changing the size, padding or visibility of an element that is
+     * already in a laid out tree.
+     */
+    void Mark_Layout_Dirty();
+
+    // layout, Size skips the children that aren't dirty and Place clears the flag
     virtual void Size() = 0;
     virtual void Grow() = 0;
     virtual void Place() = 0;
@@ -208,6 +218,8 @@ class EUI_Box : public EUI_Element {
 class EUI_Text : public EUI_Element {
   protected:
     std::string text;
+    // Measured in Size and reused by Place
+    Vector2 text_size = {0};
 
   public:
     EUI_Text(const std::string& text);
@@ -1,6 +1,8 @@
 #include <iostream>
-#include <raylib.h>
 #include <thread>
+#ifndef EUCLID_HEADLESS
+#include <raylib.h>
+#endif
 
 #include "application.h"
 #include "application_factory.h"
@@ -15,12 +17,26 @@ Application::Application(std::string name, bool client, float screen_width, floa
     : application_name(name), client(client), screen_width(screen_width),
       screen_height(screen_height), application_state(ApplicationState::SettingUp),
       network(nullptr) {
+    stats.Add_Section("frame_ms", [this](ostream& out) { frame_times.Write_Json(out); });
+    stats.Add_Section("step_ms", [this](ostream& out) { step_times.Write_Json(out); });
+    stats.Add_Section("network_update_ms",
+                      [this](ostream& out) { network_update_times.Write_Json(out); });
+    if (client)
+        stats.Add_Section("render_ms", [this](ostream& out) { render_times.Write_Json(out); });
+    stats.Add_Section("network", [this](ostream& out) {
+        if (network)
+            network->Write_Stats(out);
+        else
+            out << "null";
+    });
 }
 
 void Application::Start_Application() {
     cout << "Starting application: " + Get_Name() << endl;
     client ? Start_Client() : Start_Headless();
-    Application_Loop();
+    // Starting closes the application if it fails, like when the port of the server is taken
+    if (application_state == ApplicationState::SettingUp)
+        Application_Loop();
 }
 
 void Application::Start_Headless() {
@@ -29,6 +45,10 @@ void Application::Start_Headless() {
 }
 
 void Application::Start_Client() {
+#ifdef EUCLID_HEADLESS
+    cerr << "Can't open a window for " << application_name << ", it was built headless!" << endl;
+    Close_Application();
+#else
     // Clients can be both host and player or just a player
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(screen_width, screen_height, application_name.c_str());
@@ -37,16 +57,19 @@ void Application::Start_Client() {
     } else {
         eui_ctx->default_font = LoadFont(eui_ctx->default_font_path.c_str());
     }
-    SetTargetFPS(60);
+    // The steps are interpolated, so the frames can follow the display instead of the steps
+    int refresh_rate = GetMonitorRefreshRate(GetCurrentMonitor());
+    SetTargetFPS(refresh_rate > 0 ? refresh_rate : 60);
     SetWindowFocused();
+#endif
 }
 
-void Application::Start_Server() {
-    network = make_shared<Network>(true, [this] { this->Close_Network(); });
+void Application::Start_Server(unique_ptr<Transport> transport) {
+    network = make_shared<Network>(true, [this] { this->Close_Network(); }, std::move(transport));
 }
 
-void Application::Connect_To_Server() {
-    network = make_shared<Network>(false, [this] { this->Close_Network(); });
+void Application::Connect_To_Server(unique_ptr<Transport> transport) {
+    network = make_shared<Network>(false, [this] { this->Close_Network(); }, std::move(transport));
 }
 
 void Application::Close_Network() {
@@ -61,52 +84,70 @@ shared_ptr<Network> Application::Get_Network() {
     return network;
 }
 
+static float Elapsed_Ms(chrono::steady_clock::time_point start) {
+    return chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+}
+
 void Application::Application_Loop() {
     application_state = ApplicationState::Running;
-    chrono::time_point<chrono::system_clock> frame_end_time = chrono::system_clock::now();
-    vector<long> pastTimes = vector<long>(100);
-    long totalTimes = 0;
-    int wait = 10;
+    const chrono::steady_clock::duration step_duration =
+        chrono::duration_cast<chrono::steady_clock::duration>(1s) / step_rate;
+    const auto step_delta_time = chrono::duration_cast<chrono::milliseconds>(step_duration);
+    chrono::steady_clock::duration accumulated_time = step_duration;
+    chrono::time_point<chrono::steady_clock> last_frame_start = chrono::steady_clock::now();
     while (application_state == ApplicationState::Running) {
-        chrono::time_point<chrono::system_clock> frame_start_time = chrono::system_clock::now();
-        auto delta_time =
-            /*chrono::duration_cast<std::chrono::milliseconds>(frame_start_time - frame_end_time);*/
-            16ms; // TODO: ???
-
-        if (network)
+        chrono::time_point<chrono::steady_clock> frame_start_time = chrono::steady_clock::now();
+        auto frame_time = frame_start_time - last_frame_start;
+        last_frame_start = frame_start_time;
+        accumulated_time += frame_time;
+        frame_times.Add(chrono::duration<float, milli>(frame_time).count());
+
+        if (network) {
+            auto network_start = chrono::steady_clock::now();
             network->Network_Update();
+            network_update_times.Add(Elapsed_Ms(network_start));
+        }
 
+        // Simulate every step that is due, several of them if a frame took too long
         in_update = true;
-        for (int i = 0; i < 1; i++) {
-            Update(delta_time);
+        int steps = 0;
+        while (accumulated_time >= step_duration && steps < max_steps_per_frame) {
+            auto step_start = chrono::steady_clock::now();
+            Update(step_delta_time);
+            step_times.Add(Elapsed_Ms(step_start));
+            accumulated_time -= step_duration;
+            steps++;
         }
         in_update = false;
+        // Time beyond the catch up budget is dropped so that a long hitch can't stall the frames
+        accumulated_time = min(accumulated_time, step_duration * max_steps_per_frame);
+        step_progress = min(chrono::duration<float>(accumulated_time) / step_duration, 1.f);
+        // Send everything the update queued in one go
+        if (network)
+            network->Flush_Messages();
 
-        frame_end_time = chrono::system_clock::now();
-        long time =
-            chrono::duration_cast<chrono::milliseconds>(frame_end_time - frame_start_time).count();
-        if (pastTimes.size() == 100) {
-            totalTimes -= pastTimes.front();
-            pastTimes.erase(pastTimes.begin());
-        }
-        pastTimes.push_back(time);
-        totalTimes += time;
-
-        wait--;
-        if (wait == 0) {
-            // cout << totalTimes / static_cast<float>(pastTimes.size()) << endl;
-            wait = 50;
-        }
-
+        // The frame is drawn on this thread right after the steps, so a slow step still delays
+        // it. The interpolation only smooths the motion between the steps. Rendering can't move
+        // to its own thread while the UI reads the game state and calls rpcs directly.
         if (client) {
-            Update_UI(delta_time);
+            auto render_start = chrono::steady_clock::now();
+            Update_UI(chrono::duration_cast<chrono::milliseconds>(frame_time));
+            render_times.Add(Elapsed_Ms(render_start));
         }
+        stats.Update();
 
-        this_thread::sleep_until(frame_start_time + 16ms);
+        // Clients render at the rate of the display and interpolate between the steps, the
+        // drawing already waits for it. Headless applications wait for the next step.
+        if (!client && accumulated_time < step_duration)
+            this_thread::sleep_until(frame_start_time + step_duration - accumulated_time);
     }
     Close_Application();
 }
 
+float Application::Get_Step_Progress() const {
+    return step_progress;
+}
+
 bool Application::In_Update() {
     return in_update;
 }
@@ -0,0 +1,103 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+Frame_Arena::Frame_Arena(size_t block_size)
+    : first(nullptr), current(nullptr), used(0), block_size(block_size), peak_used(0) {
+}
+
+Frame_Arena::~Frame_Arena() {
+    Free_Blocks();
+}
+
+void Frame_Arena::Free_Blocks() {
+    Block* block = first;
+    while (block != nullptr) {
+        Block* next = block->next;
+        free(block);
+        block = next;
+    }
+    first = nullptr;
+    current = nullptr;
+}
+
+Frame_Arena::Block* Frame_Arena::New_Block(size_t min_size) {
+    size_t size = max(block_size, min_size);
+    auto* block = static_cast<Block*>(malloc(sizeof(Block) + size));
+    if (block == nullptr)
+        throw bad_alloc();
+    block->next = nullptr;
+    block->size = size;
+    return block;
+}
+
+void* Frame_Arena::do_allocate(size_t bytes, size_t alignment) {
+    if (current == nullptr) {
+        first = New_Block(bytes + alignment);
+        current = first;
+        used = 0;
+    }
+
+    while (true) {
+        auto address = reinterpret_cast<uintptr_t>(Block_Data(current)) + used;
+        size_t padding = (alignment - address % alignment) % alignment;
+        if (used + padding + bytes <= current->size) {
+            used += padding + bytes;
+            return reinterpret_cast<void*>(address + padding);
+        }
+
+        // Move on to the next kept block if it is big enough, otherwise insert a new one
+        if (current->next == nullptr || current->next->size < bytes + alignment) {
+            Block* block = New_Block(bytes + alignment);
+            block->next = current->next;
+            current->next = block;
+        }
+        current = current->next;
+        used = 0;
+    }
+}
+
+size_t Frame_Arena::Get_Used() const {
+    size_t total = 0;
+    for (Block* block = first; block != current; block = block->next)
+        total += block->size;
+    return total + used;
+}
+
+size_t Frame_Arena::Get_Capacity() const {
+    size_t total = 0;
+    for (Block* block = first; block != nullptr; block = block->next)
+        total += block->size;
+    return total;
+}
+
+void Frame_Arena::Rewind(Marker marker) {
+    peak_used = max(peak_used, Get_Used());
+    if (marker.block == nullptr) {
+        // The marker was taken before the first allocation
+        current = first;
+        used = 0;
+        return;
+    }
+    current = marker.block;
+    used = marker.used;
+}
+
+void Frame_Arena::Reset() {
+    if (first == nullptr)
+        return;
+    peak_used = max(peak_used, Get_Used());
+    if (first->next != nullptr && current != first) {
+        // The step didn't fit in one block, replace them with a single block big enough for it
+        size_t capacity = Get_Capacity();
+        Free_Blocks();
+        first = New_Block(capacity);
+    }
+    current = first;
+    used = 0;
+}
@@ -0,0 +1,68 @@
+#include <iostream>
+
+#include "dedicated_server.h"
+
+Dedicated_Server::Dedicated_Server(std::string name, Match_Factory match_factory,
+                                   int worker_threads, unique_ptr<Transport> transport)
+    : Application(std::move(name), false, 0, 0), match_server(std::move(transport)),
+      worker_pool(worker_threads), match_factory(std::move(match_factory)) {
+    match_server.on_unknown_match = [this](Match_ID match_id) { Create_Match(match_id); };
+    stats.Add_Section("matches", [this](ostream& out) {
+        out << "{";
+        bool first = true;
+        for (auto& [match_id, match] : matches) {
+            out << (first ? "" : ",") << "\"" << match_id << "\":";
+            match->Write_Stats(out);
+            first = false;
+        }
+        out << "}";
+    });
+}
+
+void Dedicated_Server::Start_Headless() {
+    if (!match_server.Start(DEFAULT_SERVER_PORT))
+        Close_Application();
+}
+
+Match* Dedicated_Server::Create_Match(Match_ID match_id) {
+    if (matches.contains(match_id))
+        return nullptr;
+    unique_ptr<Transport> transport = match_server.Create_Match_Transport(match_id);
+    if (transport == nullptr)
+        return nullptr;
+    auto network = make_shared<Network>(
+        true,
+        [this, match_id] {
+            auto match = matches.find(match_id);
+            if (match != matches.end())
+                match->second->finished = true;
+        },
+        std::move(transport));
+    unique_ptr<Match> match = match_factory(match_id, network);
+    if (match == nullptr) {
+        cerr << "Failed to create match " << match_id << endl;
+        return nullptr;
+    }
+    cout << "Creating match " << match_id << endl;
+    network->Start_Network();
+    return matches.emplace(match_id, std::move(match)).first->second.get();
+}
+
+Match* Dedicated_Server::Get_Match(Match_ID match_id) {
+    auto match = matches.find(match_id);
+    return match == matches.end() ? nullptr : match->second.get();
+}
+
+void Dedicated_Server::Update(chrono::milliseconds delta_time) {
+    match_server.Update();
+    for (auto& match : matches) {
+        match.second->network->Network_Update();
+        match.second->Update(delta_time);
+        match.second->network->Flush_Messages();
+    }
+    erase_if(matches, [](const auto& match) {
+        if (match.second->finished)
+            cout << "Closing match " << match.first << endl;
+        return match.second->finished;
+    });
+}
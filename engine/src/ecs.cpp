@@ -1,9 +1,13 @@
 #include "ecs.h"
-#include "game_ui_manager.h"
 
+#include <ranges>
+#include <sstream>
 #include <thread>
 using namespace std;
 
+// The worker running on this thread, null on threads that aren't ECS worker threads
+static thread_local ECS_Worker* current_worker = nullptr;
+
 Entity_Type::Entity_Type(std::vector<Component_Type*> components)
     : Entity_Type(components, "", nullptr, nullptr, nullptr) {
 }
@@ -39,6 +43,13 @@ Entity_Array::Entity_Array(ECS& ecs, Entity_Type entity_type)
     array.entities = new unsigned char[entity_type.entity_size * array.entity_capacity];
 }
 
+Entity_Array::~Entity_Array() {
+    // Also merges the arrays, so only the first one is left to free
+    Clear();
+    delete[] array.entities;
+    pthread_mutex_destroy(&array_lock);
+}
+
 std::tuple<unsigned char*, int> Entity_Array::Create_Entity(ECS* ecs) {
     pthread_mutex_lock(&array_lock);
     Dynamic_Array* curr_arr = &array;
@@ -101,6 +112,17 @@ void Entity_Array::Copy_Entity(int src_index, int dst_index) {
     memcpy(array.entities + dst_index * entity_type.entity_size + sizeof(Entity_Component),
            array.entities + src_index * entity_type.entity_size + sizeof(Entity_Component),
            entity_type.entity_size - sizeof(Entity_Component));
+    Call_Component_Functions(array.entities + dst_index * entity_type.entity_size, true);
+}
+
+void Entity_Array::Call_Component_Functions(unsigned char* entity, bool copy) {
+    entity += sizeof(Entity_Component);
+    for (auto& component : entity_type.components) {
+        auto function = copy ? component->copy_function : component->delete_function;
+        if (function != nullptr)
+            function(ecs, entity);
+        entity += component->size;
+    }
 }
 
 void Entity_Array::Delete_Entity(ECS* ecs, int index) {
@@ -108,6 +130,7 @@ void Entity_Array::Delete_Entity(ECS* ecs, int index) {
     // cout << "Deleting" << entity_type.name << Get_Entity_Data(Get_Entity(index)).id << " " <<
     // index
     // << endl;
+    Call_Component_Functions(array.entities + index * entity_type.entity_size, false);
     if (index != array.entity_count - 1) {
         std::memcpy(array.entities + index * entity_type.entity_size,
                     array.entities + (array.entity_count - 1) * entity_type.entity_size,
@@ -177,6 +200,40 @@ void Entity_Array::Clean_Up() {
     }
 }
 
+void Entity_Array::Clear() {
+    Clean_Up();
+    for (int i = 0; i < array.entity_count; i++) {
+        unsigned char* entity = array.entities + i * entity_type.entity_size;
+        Call_Component_Functions(entity, false);
+        Get_Entity_Data(tuple(entity, this)).id = 0;
+    }
+    array.entity_count = 0;
+    entity_count = 0;
+}
+
+void Entity_Array::Save_Entity(const unsigned char* entity, Snapshot_Writer& writer) {
+    entity += sizeof(Entity_Component);
+    for (auto& component : entity_type.components) {
+        if (component->save_function != nullptr)
+            component->save_function(ecs, entity, writer);
+        else
+            writer.write(reinterpret_cast<const char*>(entity), component->size);
+        entity += component->size;
+    }
+}
+
+void Entity_Array::Load_Entity(unsigned char* entity, Snapshot_Reader& reader) {
+    entity += sizeof(Entity_Component);
+    for (auto& component : entity_type.components) {
+        if (component->load_function != nullptr) {
+            component->load_function(ecs, entity, reader);
+        } else if (const char* bytes = reader.Read_Bytes(component->size)) {
+            memcpy(entity, bytes, component->size);
+        }
+        entity += component->size;
+    }
+}
+
 Entity_Iterator::Entity_Iterator(Entity_Type_Iterator* type_iterator)
     : type_iterator(type_iterator), pos(0), index(0) {
 }
@@ -200,8 +257,9 @@ bool Entity_Iterator::operator!=(Entity_Iterator other) const {
 }
 
 Entity_Type_Iterator::Entity_Type_Iterator(ECS& ecs, Entity_Type* entity_type)
-    : entity_type(entity_type) {
-    arrays = vector<Entity_Array*>();
+    : entity_type(entity_type),
+      arrays(ecs.In_Block() ? &ecs.Get_Arena() : std::pmr::get_default_resource()) {
+    arrays.reserve(ecs.entity_arrays.size());
     for (auto entity_array : ecs.entity_arrays) {
         if (entity_array->entity_type.Is_Entity_Of_Type(entity_type) && entity_array->Count() > 0)
             arrays.emplace_back(entity_array);
@@ -233,9 +291,14 @@ Entity_Iterator Entity_Type_Iterator::end() {
     return Entity_Iterator(this, arrays.size());
 }
 
-ECS::ECS(Application& application, long seed)
+ECS::ECS(Application& application, long seed, int worker_count)
+    : ECS(application, seed, worker_count, nullptr) {
+}
+
+ECS::ECS(Application& application, long seed, int worker_count, ECS_Worker_Pool* worker_pool)
     : application(application), work_start(nullptr), work_end(nullptr),
-      main_thread(new ECS_Worker(*this, false)) {
+      main_thread(new ECS_Worker(*this, 0, false)), worker_pool(worker_pool),
+      profiler(*this, worker_count + 1) {
     pthread_mutex_init(&to_create_mutex, nullptr);
     entity_arrays = unordered_set<Entity_Array*>();
     blocks = vector<vector<System*>>();
@@ -244,27 +307,51 @@ ECS::ECS(Application& application, long seed)
     random = minstd_rand(seed);
     workers = vector<ECS_Worker*>();
     pthread_mutex_init(&work_mutex, nullptr);
-    for (int i = 0; i < 30; i++) {
-        workers.emplace_back(new ECS_Worker(*this));
+    // The threads of a pool run the workers, otherwise each worker gets its own thread
+    for (int i = 0; i < worker_count; i++) {
+        workers.emplace_back(new ECS_Worker(*this, i + 1, worker_pool == nullptr));
     }
+    if (worker_pool != nullptr)
+        worker_pool->Add_ECS(this);
+}
+
+ECS::ECS(Application& application, long seed, ECS_Worker_Pool& worker_pool)
+    : ECS(application, seed, worker_pool.Get_Thread_Count(), &worker_pool) {
 }
 
 ECS::~ECS() {
+    if (worker_pool != nullptr)
+        worker_pool->Remove_ECS(this);
     for (auto worker : workers) {
         delete worker;
     }
+    delete main_thread;
+    for (auto entity_array : entity_arrays)
+        delete entity_array;
+    for (auto& systems : blocks) {
+        for (System* system : systems)
+            delete system;
+    }
 }
 
 void ECS::Update() {
-    for (auto systems : blocks) {
+    long step_start = profiler.Now();
+    int system_index = 0;
+    for (int b = 0; b < blocks.size(); b++) {
+        long block_start = profiler.Now();
         in_block = true;
-        for (auto system : systems)
-            Apply_Function_To_Entities(system->entity_type, system->function);
+        for (auto system : blocks[b])
+            Apply_Function_To_Entities(system->entity_type, system->function, system_index++);
+        long complete_work_start = profiler.Now();
         Complete_Work();
+        profiler.Record(0, ECS_Profiler::Complete_Work, b, complete_work_start);
         in_block = false;
+        long clean_up_start = profiler.Now();
         for (auto entity_array : entity_arrays)
             entity_array->Clean_Up();
+        profiler.Record(0, ECS_Profiler::Clean_Up, b, clean_up_start);
 
+        long create_start = profiler.Now();
         // Sort the list to maintain determinism
         ranges::stable_sort(to_create, [](auto a, auto b) { return get<0>(a) < get<0>(b); });
         // We must create the entities and add them to the entities_by_id map before we delete
@@ -299,7 +386,9 @@ void ECS::Update() {
                 to_delete.emplace_back(id);
         }
         to_create.clear();
+        profiler.Record(0, ECS_Profiler::Create_Entities, b, create_start);
 
+        long delete_start = profiler.Now();
         ranges::stable_sort(to_delete);
         for (Entity_ID entity_id : to_delete) {
             if (!entities_by_id.contains(entity_id))
@@ -313,7 +402,15 @@ void ECS::Update() {
             get<1>(entity)->Delete_Entity(this, index);
         }
         to_delete.clear();
+        profiler.Record(0, ECS_Profiler::Delete_Entities, b, delete_start);
+        profiler.Record(0, ECS_Profiler::Block, b, block_start);
     }
+    // Nothing from this step is running anymore so the step memory can be reused
+    main_thread->arena.Reset();
+    for (auto worker : workers)
+        worker->arena.Reset();
+    profiler.Record(0, ECS_Profiler::Step, 0, step_start);
+    profiler.End_Step();
 }
 
 Entity_Array*
@@ -390,15 +487,19 @@ void ECS::Delete_Entity(Entity entity) {
 }
 
 void ECS::Apply_Function_To_Entities(Entity_Type* entity_type,
-                                     const std::function<void(ECS* ecs, Entity entity)>& op) {
+                                     const std::function<void(ECS* ecs, Entity entity)>& op,
+                                     int system_index) {
     for (auto entity_array : entity_arrays) {
         if (!entity_array->entity_type.Is_Entity_Of_Type(entity_type) || entity_array->Count() == 0)
             continue;
         int start_index = 0;
         int end_index = min(29, entity_array->Count() - 1);
+        long lock_start = profiler.Now();
         pthread_mutex_lock(&work_mutex);
+        profiler.Record_Lock_Wait(0, lock_start);
         while (start_index <= end_index && start_index <= entity_array->Count() - 1) {
-            auto work = new Work_Data{op, entity_array, start_index, end_index, nullptr};
+            auto work = Get_Arena().Create<Work_Data>(op, entity_array, start_index, end_index,
+                                                      system_index, nullptr);
             if (work_end == nullptr) {
                 work_start = work;
             } else {
@@ -410,6 +511,8 @@ void ECS::Apply_Function_To_Entities(Entity_Type* entity_type,
         }
         pthread_mutex_unlock(&work_mutex);
     }
+    if (worker_pool != nullptr)
+        worker_pool->Notify_Work();
 }
 
 Entity_Type_Iterator ECS::Get_Entities_Of_Type(Entity_Type* entity_type) {
@@ -431,9 +534,11 @@ void ECS::Register_System(System* system, int block_index) {
     blocks[block_index].emplace_back(system);
 }
 
-Work_Data* ECS::Get_Work(atomic_bool& doing_work) {
+Work_Data* ECS::Get_Work(atomic_bool& doing_work, int thread) {
     Work_Data* data = nullptr;
+    long lock_start = profiler.Now();
     pthread_mutex_lock(&work_mutex);
+    profiler.Record_Lock_Wait(thread, lock_start);
     data = work_start;
     if (data != nullptr) {
         work_start = data->next;
@@ -447,7 +552,9 @@ Work_Data* ECS::Get_Work(atomic_bool& doing_work) {
 
 void ECS::Complete_Work() {
     while (true) {
+        long lock_start = profiler.Now();
         pthread_mutex_lock(&work_mutex);
+        profiler.Record_Lock_Wait(0, lock_start);
         if (work_end != nullptr) {
             pthread_mutex_unlock(&work_mutex);
             main_thread->Do_Work();
@@ -470,45 +577,274 @@ void ECS::Complete_Work() {
     }
 }
 
+bool ECS::Do_Pool_Work(int thread) {
+    ECS_Worker* worker = workers[thread];
+    current_worker = worker;
+    bool worked = false;
+    // Taking every chunk clears the doing_work flag of the worker before the thread moves on
+    while (worker->Do_Chunk())
+        worked = true;
+    current_worker = nullptr;
+    return worked;
+}
+
+Frame_Arena& ECS::Get_Arena() {
+    if (current_worker != nullptr && &current_worker->Get_ECS() == this)
+        return current_worker->arena;
+    return main_thread->arena;
+}
+
+/* Entity arrays are matched between machines by the names of their components. */
+static vector<string> Get_Component_Names(const Entity_Type& entity_type) {
+    vector<string> names;
+    for (const Component_Type* component : entity_type.components)
+        names.emplace_back(component->name);
+    return names;
+}
+
+void ECS::Save_Snapshot(Snapshot_Writer& writer) {
+    writer.Write(next_id);
+    ostringstream random_state;
+    random_state << random;
+    writer.Write(random_state.str());
+
+    // The set of arrays is unordered, sorting them keeps the snapshot the same on every machine
+    vector<pair<vector<string>, Entity_Array*>> arrays;
+    for (auto entity_array : entity_arrays) {
+        if (entity_array->Count() > 0)
+            arrays.emplace_back(Get_Component_Names(entity_array->entity_type), entity_array);
+    }
+    ranges::sort(arrays, [](const auto& a, const auto& b) { return a.first < b.first; });
+    Write_Varint(writer, arrays.size());
+    for (auto& [names, entity_array] : arrays) {
+        Write_Varint(writer, names.size());
+        for (const string& name : names)
+            writer.Write(name);
+        Write_Varint(writer, entity_array->Count());
+        for (int i = 0; i < entity_array->Count(); i++) {
+            Entity entity = entity_array->Get_Entity(i);
+            writer.Write(Entity_Array::Get_Entity_ID(entity));
+            entity_array->Save_Entity(get<0>(entity), writer);
+        }
+    }
+}
+
+bool ECS::Load_Snapshot(Snapshot_Reader& reader) {
+    for (const auto& entity_id : entities_by_id | views::keys) {
+        if (on_delete_entity)
+            on_delete_entity(entity_id);
+    }
+    for (auto entity_array : entity_arrays)
+        entity_array->Clear();
+    entities_by_id.clear();
+    to_create.clear();
+    to_delete.clear();
+
+    next_id = reader.Read<Entity_ID>();
+    istringstream random_state(reader.Read<string>());
+    random_state >> random;
+
+    size_t array_count = reader.Read_Varint();
+    vector<Entity_ID> loaded;
+    for (size_t a = 0; a < array_count && !reader.failed; a++) {
+        vector<string> names(reader.Read_Varint());
+        for (string& name : names)
+            name = reader.Read<string>();
+        auto search = ranges::find_if(entity_arrays, [&names](Entity_Array* e) {
+            return Get_Component_Names(e->entity_type) == names;
+        });
+        if (search == entity_arrays.end()) {
+            cerr << "Snapshot has entities without a matching entity array!" << endl;
+            return false;
+        }
+        Entity_Array* entity_array = *search;
+        size_t entity_count = reader.Read_Varint();
+        for (size_t i = 0; i < entity_count && !reader.failed; i++) {
+            auto [entity, index] = entity_array->Create_Entity(this);
+            Entity_ID id = reader.Read<Entity_ID>();
+            Entity_Array::Get_Entity_Data(tuple(entity, entity_array)).id = id;
+            entity_array->Load_Entity(entity, reader);
+            entities_by_id.emplace(id, tuple(tuple(entity, entity_array), index));
+            loaded.emplace_back(id);
+        }
+    }
+    if (reader.failed) {
+        cerr << "Snapshot is broken!" << endl;
+        return false;
+    }
+    if (on_add_entity) {
+        for (Entity_ID entity_id : loaded)
+            on_add_entity(entity_id);
+    }
+    return true;
+}
+
 void* Worker_Function(void* worker) {
     static_cast<ECS_Worker*>(worker)->Do_Worker_Loop();
     return nullptr;
 }
 
-ECS_Worker::ECS_Worker(ECS& ecs, bool separate_thread) : ecs(ecs), canceled(false) {
+ECS_Worker::ECS_Worker(ECS& ecs, int index, bool separate_thread)
+    : separate_thread(separate_thread), ecs(ecs), canceled(false), index(index) {
     if (separate_thread)
         pthread_create(&thread, nullptr, Worker_Function, this);
 }
 
 void ECS_Worker::Do_Worker_Loop() {
+    current_worker = this;
     while (!canceled) {
         Do_Work();
     }
 }
 
 void ECS_Worker::Do_Work() {
-    auto work = ecs.Get_Work(doing_work);
+    if (Do_Chunk())
+        return;
+    long idle_start = ecs.profiler.Now();
+    if (ecs.application.In_Update())
+        this_thread::sleep_for(chrono::microseconds(1));
+    else
+        this_thread::sleep_for(chrono::milliseconds(1));
+    ecs.profiler.Record_Idle(index, idle_start);
+}
+
+bool ECS_Worker::Do_Chunk() {
+    auto work = ecs.Get_Work(doing_work, index);
     if (work == nullptr) {
         doing_work = false;
-        if (ecs.application.In_Update())
-            this_thread::sleep_for(chrono::microseconds(1));
-        else
-            this_thread::sleep_for(chrono::milliseconds(1));
-        return;
+        return false;
     }
+    long start = ecs.profiler.Now();
     for (int i = work->starting_index; i <= work->ending_index; i++) {
         work->op(&ecs, work->entity_array->Get_Entity(i));
     }
+    ecs.profiler.Record_Chunk(index, work->system_index,
+                              work->ending_index - work->starting_index + 1, start);
+    return true;
 }
 
 ECS_Worker::~ECS_Worker() {
     canceled = true;
-    pthread_cancel(thread);
+    // Wait for the current chunk to finish instead of cancelling the thread part way through it
+    if (separate_thread)
+        pthread_join(thread, nullptr);
+}
+
+ECS_Worker_Pool::ECS_Worker_Pool(int thread_count) {
+    pthread_mutex_init(&members_mutex, nullptr);
+    pthread_cond_init(&work_queued, nullptr);
+    for (int i = 0; i < thread_count; i++) {
+        auto* pool_thread = new Pool_Thread{this, i, {}};
+        threads.emplace_back(pool_thread);
+        pthread_create(&pool_thread->thread, nullptr, Thread_Function, pool_thread);
+    }
+}
+
+ECS_Worker_Pool::~ECS_Worker_Pool() {
+    pthread_mutex_lock(&members_mutex);
+    canceled = true;
+    pthread_cond_broadcast(&work_queued);
+    pthread_mutex_unlock(&members_mutex);
+    for (Pool_Thread* pool_thread : threads) {
+        pthread_join(pool_thread->thread, nullptr);
+        delete pool_thread;
+    }
+    for (Member* member : members)
+        delete member;
+    pthread_cond_destroy(&work_queued);
+    pthread_mutex_destroy(&members_mutex);
 }
 
-constexpr bool ECS_Worker::Doing_Work() {
-    return doing_work;
+void* ECS_Worker_Pool::Thread_Function(void* pool_thread) {
+    auto* thread = static_cast<Pool_Thread*>(pool_thread);
+    thread->pool->Do_Thread_Loop(thread->index);
+    return nullptr;
+}
+
+void ECS_Worker_Pool::Do_Thread_Loop(int index) {
+    // Each thread goes round the ECSs on its own, so that a round without work has seen every ECS
+    size_t next_member = index;
+    // Rounds in a row where none of the ECSs had work
+    size_t idle_turns = 0;
+    // The work generation when the thread last found work
+    unsigned long idle_generation = 0;
+    while (!canceled) {
+        Member* member = nullptr;
+        size_t member_count = 0;
+        pthread_mutex_lock(&members_mutex);
+        if (idle_turns == 0)
+            idle_generation = work_generation;
+        member_count = members.size();
+        if (member_count > 0) {
+            member = members[next_member++ % member_count];
+            member->threads_inside++;
+        }
+        pthread_mutex_unlock(&members_mutex);
+
+        bool worked = member != nullptr && member->ecs->Do_Pool_Work(index);
+        if (member != nullptr)
+            member->threads_inside--;
+        idle_turns = worked ? 0 : idle_turns + 1;
+        if (idle_turns > member_count) {
+            // Work queued before the round started was found by it, so only newer work wakes us
+            pthread_mutex_lock(&members_mutex);
+            sleeping_threads++;
+            while (!canceled && work_generation == idle_generation)
+                pthread_cond_wait(&work_queued, &members_mutex);
+            sleeping_threads--;
+            pthread_mutex_unlock(&members_mutex);
+            idle_turns = 0;
+        }
+    }
+}
+
+void ECS_Worker_Pool::Add_ECS(ECS* ecs) {
+    pthread_mutex_lock(&members_mutex);
+    members.emplace_back(new Member{ecs});
+    pthread_mutex_unlock(&members_mutex);
+}
+
+void ECS_Worker_Pool::Notify_Work() {
+    pthread_mutex_lock(&members_mutex);
+    work_generation++;
+    if (sleeping_threads > 0)
+        pthread_cond_broadcast(&work_queued);
+    pthread_mutex_unlock(&members_mutex);
+}
+
+void ECS_Worker_Pool::Remove_ECS(ECS* ecs) {
+    Member* member = nullptr;
+    pthread_mutex_lock(&members_mutex);
+    auto found = ranges::find_if(members, [ecs](Member* m) { return m->ecs == ecs; });
+    if (found != members.end()) {
+        member = *found;
+        members.erase(found);
+    }
+    pthread_mutex_unlock(&members_mutex);
+    if (member == nullptr)
+        return;
+    while (member->threads_inside > 0)
+        this_thread::yield();
+    delete member;
 }
 
 Component_Type Transform_Component::component_type =
     Component_Type{"Transform", sizeof(Transform_Component)};
+
+static void Save_UI_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    UI_Component ui = *static_cast<const UI_Component*>(component);
+    writer.Write_Pointer(ui.texture);
+    // Pointers differ between machines, leaving them out keeps the snapshots the same
+    ui.texture = nullptr;
+    writer.Write_Bytes(ui);
+}
+
+static void Load_UI_Component(ECS&, void* component, Snapshot_Reader& reader) {
+    auto* ui = static_cast<UI_Component*>(component);
+    auto* texture = reader.Read_Pointer<Texture2D>();
+    reader.Read_Bytes_Into(*ui);
+    ui->texture = texture;
+}
+
+Component_Type UI_Component::component_type = Component_Type{
+    "UI", sizeof(UI_Component), nullptr, nullptr, Save_UI_Component, Load_UI_Component};
@@ -0,0 +1,78 @@
+#include "entity_list.h"
+
+#include <bit>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+Side_Storage::Side_Storage() : chunk_pos(nullptr), chunk_left(0), pages_in_use(0) {
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+Side_Storage::~Side_Storage() {
+    for (void* chunk : chunks)
+        free(chunk);
+    pthread_mutex_destroy(&mutex);
+}
+
+int Side_Storage::Size_Class(size_t bytes) {
+    if (bytes <= min_page_size)
+        return 0;
+    return bit_width(bytes - 1) - bit_width(min_page_size - 1);
+}
+
+void* Side_Storage::Allocate(size_t bytes, size_t& page_size) {
+    int size_class = Size_Class(bytes);
+    if (size_class >= size_classes) {
+        page_size = bytes;
+        void* page = malloc(bytes);
+        if (page == nullptr)
+            throw bad_alloc();
+        return page;
+    }
+    page_size = min_page_size << size_class;
+
+    pthread_mutex_lock(&mutex);
+    pages_in_use++;
+    void* page;
+    if (!free_pages[size_class].empty()) {
+        page = free_pages[size_class].back();
+        free_pages[size_class].pop_back();
+    } else {
+        if (chunk_left < page_size) {
+            // The end of the old chunk is too small for this page, it is split into smaller pages
+            // so that it isn't wasted
+            while (chunk_left >= min_page_size) {
+                int leftover_class = Size_Class(chunk_left + 1) - 1;
+                free_pages[leftover_class].emplace_back(chunk_pos);
+                chunk_pos += min_page_size << leftover_class;
+                chunk_left -= min_page_size << leftover_class;
+            }
+            chunk_pos = static_cast<unsigned char*>(malloc(chunk_size));
+            if (chunk_pos == nullptr) {
+                pthread_mutex_unlock(&mutex);
+                throw bad_alloc();
+            }
+            chunks.emplace_back(chunk_pos);
+            chunk_left = chunk_size;
+        }
+        page = chunk_pos;
+        chunk_pos += page_size;
+        chunk_left -= page_size;
+    }
+    pthread_mutex_unlock(&mutex);
+    return page;
+}
+
+void Side_Storage::Free(void* page, size_t page_size) {
+    int size_class = Size_Class(page_size);
+    if (size_class >= size_classes) {
+        free(page);
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    pages_in_use--;
+    free_pages[size_class].emplace_back(page);
+    pthread_mutex_unlock(&mutex);
+}
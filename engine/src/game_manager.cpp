@@ -1,7 +1,10 @@
 #include "game_manager.h"
 
 #include "player.h"
+#include "snapshot.h"
+#include <cmath>
 #include <ranges>
+#include <sstream>
 #include <utility>
 
 using namespace std;
@@ -21,18 +24,19 @@ Game_Manager::Game_Manager(Application& application, Network& network, vector<Pl
         });
     }
 
-    network.bind_rpc("stepupdate", [this](const long new_step) {
+    step_update_rpc = network.bind_rpc("stepupdate", [this](const long new_step) {
         On_Receive_Step_Update(new_step);
         return RPC_Manager::VALID_CALL_ON_CLIENTS;
     });
-    if (network.Is_Server())
-        network.bind_rpc("minstepupdate", [this](const long player_id, const long min_step) {
+    // Only the newest step of a player matters, so a lost report is replaced by the next one
+    min_step_update_rpc = network.bind_server_rpc(
+        "minstepupdate",
+        [this](const long player_id, const long min_step) {
             On_Receive_Player_Step_Update(player_id, min_step);
             return RPC_Manager::VALID;
-        });
-    if (!network.Is_Server()) {
-        network.call_rpc(false, "minstepupdate", local_player->player_id, step);
-    }
+        },
+        RPC_Manager::Unreliable_Latest);
+    // Clients report their first step from Update, unless they are waiting for a snapshot
 }
 
 Game_Manager::~Game_Manager() {
@@ -43,25 +47,120 @@ void Game_Manager::On_Receive_Step_Update(long new_step) {
 }
 
 void Game_Manager::On_Receive_Player_Step_Update(Player_ID player_id, long player_min_step) {
+    if (spectators.contains(player_id))
+        return;
+    if (player_min_step > player_steps[player_id])
+        Measure_Player_Step(player_id, player_min_step);
     player_steps[player_id] = max(player_steps[player_id], player_min_step);
     min_step = step;
     for (auto const& [id, player_step] : player_steps) {
         min_step = min(min_step, player_step);
     }
+    // Every player is past these steps, so no report will measure them anymore
+    while (!step_release_times.empty() && step_release_times.begin()->first <= min_step)
+        step_release_times.erase(step_release_times.begin());
+}
+
+void Game_Manager::Measure_Player_Step(Player_ID player_id, long player_step) {
+    auto release = step_release_times.find(player_step);
+    if (release == step_release_times.end())
+        return;
+    // The round trip to the player and its wait for the next frame, smoothed like a TCP RTT
+    double sample =
+        chrono::duration<double, milli>(chrono::steady_clock::now() - release->second).count();
+    Player_Timing& timing = player_timings[player_id];
+    if (!timing.measured) {
+        timing.delay_ms = sample;
+        timing.jitter_ms = sample / 2;
+        timing.measured = true;
+    } else {
+        timing.jitter_ms += (abs(sample - timing.delay_ms) - timing.jitter_ms) / 4;
+        timing.delay_ms += (sample - timing.delay_ms) / 8;
+    }
+    Update_Step_Window();
+}
+
+void Game_Manager::Update_Step_Window() {
+    if (frame_interval_ms <= 0)
+        return;
+    // The slowest player sets the window, so that its reports usually arrive before the server
+    // runs out of steps to allow
+    double window_ms = 0;
+    for (auto const& [id, player_step] : player_steps) {
+        auto timing = player_timings.find(id);
+        if (timing == player_timings.end())
+            return;
+        window_ms = max(window_ms, timing->second.delay_ms + 4 * timing->second.jitter_ms);
+    }
+    step_window = clamp(static_cast<long>(ceil(window_ms / frame_interval_ms)) + 1,
+                        min_step_window, max_step_window);
+}
+
+void Game_Manager::Remove_Player_Steps(Player_ID player_id) {
+    player_steps.erase(player_id);
+    player_timings.erase(player_id);
+    min_step = step;
+    for (auto const& [id, player_step] : player_steps) {
+        min_step = min(min_step, player_step);
+    }
+    Update_Step_Window();
+}
+
+void Game_Manager::Set_Spectator(Player_ID player_id) {
+    spectators.emplace(player_id);
+    if (local_player != nullptr && local_player->player_id == player_id)
+        spectating = true;
+    if (network.Is_Server())
+        Remove_Player_Steps(player_id);
+}
+
+void Game_Manager::Update_Spectators() {
+    long delayed_step = step - spectator_delay;
+    if (delayed_step < spectator_step + spectator_batch_steps)
+        return;
+    spectator_step = delayed_step;
+    network.Send_Spectator_Frames(spectator_step - 1);
+    network.call_rpc_on_spectators(step_update_rpc, spectator_step);
+}
+
+int Game_Manager::Get_Steps_To_Simulate() const {
+    if (min_step == -1 || waiting_for_snapshot)
+        return 0;
+    if (network.Is_Server())
+        return step < max_step || min_step > step - step_window ? 1 : 0;
+    long behind = max_step - step;
+    // A spectator gets a batch of steps at once, it only catches up if it falls behind further
+    long lead = spectating ? catch_up_lead + spectator_batch_steps : catch_up_lead;
+    if (behind <= lead)
+        return behind > 0 ? 1 : 0;
+    return static_cast<int>(min<long>(behind - lead + 1, max_catch_up_steps));
 }
 
 void Game_Manager::Update() {
     // If there are players still loading in the game then we will wait for them to load
-    if (min_step == -1)
+    if (min_step == -1 || waiting_for_snapshot)
         return;
 
-    // If we are the server and the players have reached a close enough step
-    // We can continue on and proceed with the next step
-    if (network.Is_Server() && step == max_step && min_step > step - max_step_diff) {
-        max_step++;
+    auto now = chrono::steady_clock::now();
+    double interval = 0;
+    if (last_update_time != chrono::steady_clock::time_point())
+        interval = chrono::duration<double, milli>(now - last_update_time).count();
+    last_update_time = now;
+    if (network.Is_Server()) {
+        if (interval > 0) {
+            frame_interval_ms = frame_interval_ms == 0
+                                    ? interval
+                                    : frame_interval_ms + (interval - frame_interval_ms) / 8;
+        }
+        // If the players have reached a close enough step we can proceed with the next step
+        if (step == max_step && min_step > step - step_window) {
+            max_step++;
+            if (!player_steps.empty())
+                step_release_times.emplace(max_step, now);
+        }
     }
     if (step < max_step) {
-        application.Get_Network()->Process_Step_Rpcs(step);
+        network.Process_Step_Rpcs(step);
 
         for (const auto object : objects | views::values) {
             object->Update();
@@ -75,17 +174,47 @@ void Game_Manager::Update() {
         }
         objects_to_delete.clear();
         step++;
+        lockstep_stats.steps++;
         if (network.Is_Server()) {
-            network.call_rpc(true, "stepupdate", step);
+            // The clients get the rpcs of the step in one frame right before the step update
+            network.Send_Step_Frames(step - 1);
+            network.call_rpc_on_players(step_update_rpc, step);
+            Update_Spectators();
             if (player_steps.empty()) {
                 min_step = step;
             }
-        } else {
-            network.call_rpc(false, "minstepupdate", local_player->player_id, step);
+        } else if (!spectating) {
+            network.call_rpc(min_step_update_rpc, local_player->player_id, step);
         }
+    } else {
+        lockstep_stats.stalled_updates++;
+        lockstep_stats.stalled_ms += interval;
+        // The report of the current step might have been lost while the server waits for it
+        if (!network.Is_Server() && !spectating)
+            network.call_rpc(min_step_update_rpc, local_player->player_id, step);
     }
 }
 
+void Game_Manager::Write_Stats(ostream& out) const {
+    out << "{\"step\":" << step << ",\"max_step\":" << max_step
+        << ",\"step_window\":" << step_window << ",\"steps\":" << lockstep_stats.steps
+        << ",\"stalled_updates\":" << lockstep_stats.stalled_updates
+        << ",\"stalled_ms\":" << lockstep_stats.stalled_ms
+        << ",\"spectators\":" << spectators.size() << ",\"spectator_step\":" << spectator_step
+        << ",\"players\":{";
+    bool first = true;
+    for (const auto& [player_id, player_step] : player_steps) {
+        out << (first ? "" : ",") << "\"" << player_id << "\":{\"step\":" << player_step;
+        auto timing = player_timings.find(player_id);
+        if (timing != player_timings.end())
+            out << ",\"delay_ms\":" << timing->second.delay_ms
+                << ",\"jitter_ms\":" << timing->second.jitter_ms;
+        out << "}";
+        first = false;
+    }
+    out << "}}";
+}
+
 void Game_Manager::Add_Object(Game_Object* object) {
     objects.emplace(object->id, object);
     if (on_add_object != nullptr)
@@ -106,6 +235,35 @@ long Game_Manager::Get_Current_Step() const {
     return step;
 }
 
+void Game_Manager::Save_Snapshot(Snapshot_Writer& writer) {
+    writer.Write(step);
+    writer.Write(next_id);
+    ostringstream random_state;
+    random_state << random;
+    writer.Write(random_state.str());
+    if (on_save_snapshot != nullptr)
+        on_save_snapshot(writer);
+}
+
+bool Game_Manager::Load_Snapshot(Snapshot_Reader& reader) {
+    long snapshot_step = reader.Read<long>();
+    next_id = reader.Read<long>();
+    istringstream random_state(reader.Read<string>());
+    random_state >> random;
+    if (reader.failed || (on_load_snapshot != nullptr && !on_load_snapshot(reader)))
+        return false;
+    step = snapshot_step;
+    // The server can already have allowed steps past the snapshot
+    max_step = max(max_step, step);
+    min_step = max(min_step, step);
+    waiting_for_snapshot = false;
+    return true;
+}
+
+void Game_Manager::Wait_For_Snapshot() {
+    waiting_for_snapshot = true;
+}
+
 Game_Object* Game_Manager::Get_Object(Obj_ID id) {
     return objects[id];
 }
@@ -123,4 +281,9 @@ vector<Game_Object*> Game_Manager::Get_All_Objects() {
     return ret;
 }
 
-long Game_Manager::max_step_diff = 10;
\ No newline at end of file
+long Game_Manager::min_step_window = 2;
+long Game_Manager::max_step_window = 30;
+long Game_Manager::catch_up_lead = 2;
+int Game_Manager::max_catch_up_steps = 8;
+long Game_Manager::spectator_delay = 120;
+long Game_Manager::spectator_batch_steps = 15;
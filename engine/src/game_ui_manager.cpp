@@ -1,6 +1,9 @@
 #include "game_ui_manager.h"
 #include "game_object_ui.h"
 
+#include <cmath>
+#include <raymath.h>
+
 Game_UI_Manager::Game_UI_Manager(Application& application, ECS& ecs, Game_Manager& game_manager)
     : application(application), ecs(ecs), game_manager(game_manager), camera{0} {
     // centers camera on the middle of the screen
@@ -13,9 +16,8 @@ Game_UI_Manager::Game_UI_Manager(Application& application, ECS& ecs, Game_Manage
     active_ui_objects = unordered_map<Entity_ID, Object_UI*>();
     to_create = unordered_set<Entity_ID>();
     to_delete = unordered_set<Entity_ID>();
-    game_ui_manager_instance = this;
-    ecs.on_add_entity = [](Entity_ID id) { game_ui_manager_instance->On_Create_Object(id); };
-    ecs.on_delete_entity = [](Entity_ID id) { game_ui_manager_instance->On_Delete_Object(id); };
+    ecs.on_add_entity = [this](Entity_ID id) { On_Create_Object(id); };
+    ecs.on_delete_entity = [this](Entity_ID id) { On_Delete_Object(id); };
 }
 
 void Game_UI_Manager::Resize_UI(Vector2 screen_seize_change) {
@@ -24,6 +26,7 @@ void Game_UI_Manager::Resize_UI(Vector2 screen_seize_change) {
 }
 
 void Game_UI_Manager::Update_UI(std::chrono::milliseconds delta_time, EUI_Context* eui_ctx) {
+    render_buffer.Read();
     for (auto id : to_create) {
         if (to_delete.contains(id))
             continue;
@@ -48,6 +51,50 @@ void Game_UI_Manager::Update_UI(std::chrono::milliseconds delta_time, EUI_Contex
     }
 }
 
+static Entity_Type* Get_Render_Entity_Type() {
+    static Entity_Type render_entity_type =
+        Entity_Type({&Transform_Component::component_type, &UI_Component::component_type});
+    return &render_entity_type;
+}
+
+void Game_UI_Manager::Publish_Render_State() {
+    Render_State& state = render_buffer.Begin_Write();
+    state.step = game_manager.Get_Current_Step();
+    for (Entity_Array* entity_array : ecs.entity_arrays) {
+        if (!Get_Render_Entity_Type()->Is_Entity_Of_Type(&entity_array->entity_type))
+            continue;
+        for (int i = 0; i < entity_array->Count(); i++) {
+            Entity entity = entity_array->Get_Entity(i);
+            Entity_ID entity_id = Entity_Array::Get_Entity_ID(entity);
+            if (entity_id != 0)
+                state.transforms.emplace(
+                    entity_id, *entity_array->Get_Component<Transform_Component>(entity));
+        }
+    }
+    render_buffer.Publish();
+}
+
+Transform_Component Game_UI_Manager::Get_Render_Transform(
+    Entity_ID entity_id, const Transform_Component& transform) const {
+    const Render_State& current = render_buffer.Get_Current();
+    const Render_State& previous = render_buffer.Get_Previous();
+    // Only consecutive steps can be interpolated, catching up or loading a snapshot jumps
+    if (previous.step == -1 || current.step != previous.step + 1)
+        return transform;
+    auto to = current.transforms.find(entity_id);
+    auto from = previous.transforms.find(entity_id);
+    if (to == current.transforms.end() || from == previous.transforms.end())
+        return transform;
+    float progress = application.Get_Step_Progress();
+    Transform_Component result = to->second;
+    result.pos = Vector2Lerp(from->second.pos, to->second.pos, progress);
+    // Turn the short way around
+    float turn = fmodf(to->second.rot - from->second.rot + 540, 360) - 180;
+    result.rot = from->second.rot + turn * progress;
+    result.scale = Lerp(from->second.scale, to->second.scale, progress);
+    return result;
+}
+
 void Game_UI_Manager::DrawImage(Texture2D& texture, Vector2 pos, float rot, float scale,
                                 Color color) {
     BeginMode2D(camera);
@@ -76,6 +123,3 @@ void Game_UI_Manager::On_Delete_Object(Entity_ID id) {
     else
         to_delete.emplace(id);
 }
-
-Game_UI_Manager* Game_UI_Manager::game_ui_manager_instance = nullptr;
-Component_Type UI_Component::component_type = Component_Type{"UI", sizeof(UI_Component)};
@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <cstring>
+
+#include "networking/compression.h"
+
+using namespace std;
+
+// Matches shorter than this don't save anything over the token and offset
+static constexpr size_t min_match = 4;
+static constexpr size_t max_offset = 0xffff;
+// The hash table holds the last position of each hash of 4 bytes
+static constexpr int hash_bits = 12;
+
+static uint32_t Read_32(const unsigned char* bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint32_t Hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+static void Write_Length(vector<char>& output, size_t length) {
+    while (length >= 255) {
+        output.emplace_back(static_cast<char>(255));
+        length -= 255;
+    }
+    output.emplace_back(static_cast<char>(length));
+}
+
+static void Write_Sequence(vector<char>& output, const unsigned char* literals,
+                           size_t literal_count, size_t offset, size_t match_length) {
+    size_t match_code = match_length == 0 ? 0 : match_length - min_match;
+    output.emplace_back(static_cast<char>((literal_count < 15 ? literal_count : 15) << 4 |
+                                          (match_code < 15 ? match_code : 15)));
+    if (literal_count >= 15)
+        Write_Length(output, literal_count - 15);
+    output.insert(output.end(), literals, literals + literal_count);
+    // The last sequence ends with the literals
+    if (match_length == 0)
+        return;
+    output.emplace_back(static_cast<char>(offset));
+    output.emplace_back(static_cast<char>(offset >> 8));
+    if (match_code >= 15)
+        Write_Length(output, match_code - 15);
+}
+
+size_t Compress_Block(const char* data, size_t size, vector<char>& output) {
+    size_t start_size = output.size();
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    // Positions are stored plus one so that zero means empty
+    uint32_t table[1 << hash_bits] = {};
+    size_t literal_start = 0;
+    size_t position = 0;
+    while (position + min_match <= size) {
+        uint32_t value = Read_32(bytes + position);
+        uint32_t& entry = table[Hash(value)];
+        size_t candidate = entry;
+        entry = static_cast<uint32_t>(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > max_offset ||
+            Read_32(bytes + candidate - 1) != value) {
+            position++;
+            continue;
+        }
+        candidate--;
+        size_t match_length = min_match;
+        while (position + match_length < size &&
+               bytes[candidate + match_length] == bytes[position + match_length])
+            match_length++;
+        Write_Sequence(output, bytes + literal_start, position - literal_start,
+                       position - candidate, match_length);
+        position += match_length;
+        literal_start = position;
+    }
+    Write_Sequence(output, bytes + literal_start, size - literal_start, 0, 0);
+    return output.size() - start_size;
+}
+
+/* Reads a length that continues in extra bytes, returns false if the block ends first. */
+static bool Read_Length(const unsigned char*& position, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if (position == end)
+            return false;
+        byte = *position++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool Decompress_Block(const char* data, size_t size, char* output, size_t output_size) {
+    const auto* position = reinterpret_cast<const unsigned char*>(data);
+    const auto* end = position + size;
+    size_t written = 0;
+    while (position != end) {
+        unsigned char token = *position++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !Read_Length(position, end, literal_count))
+            return false;
+        if (static_cast<size_t>(end - position) < literal_count ||
+            output_size - written < literal_count)
+            return false;
+        memcpy(output + written, position, literal_count);
+        position += literal_count;
+        written += literal_count;
+        if (position == end)
+            break;
+
+        if (end - position < 2)
+            return false;
+        size_t offset = position[0] | static_cast<size_t>(position[1]) << 8;
+        position += 2;
+        size_t match_length = token & 0xf;
+        if (match_length == 15 && !Read_Length(position, end, match_length))
+            return false;
+        match_length += min_match;
+        if (offset == 0 || offset > written || output_size - written < match_length)
+            return false;
+        // The match can overlap the bytes it is writing, so it is copied one byte at a time
+        char* destination = output + written;
+        const char* source = destination - offset;
+        for (size_t i = 0; i < match_length; i++)
+            destination[i] = source[i];
+        written += match_length;
+    }
+    return written == output_size;
+}
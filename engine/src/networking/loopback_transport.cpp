@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+#include "networking/loopback_transport.h"
+
+using namespace std;
+
+/* The messages own their data, Release is the only way to free them. */
+class Loopback_Message : public ISteamNetworkingMessage {
+  public:
+    vector<char> data;
+
+    explicit Loopback_Message(int size);
+};
+
+static void Release_Loopback_Message(ISteamNetworkingMessage* message) {
+    delete static_cast<Loopback_Message*>(message);
+}
+
+Loopback_Message::Loopback_Message(int size) : ISteamNetworkingMessage(), data(size) {
+    m_pData = data.data();
+    m_cbSize = size;
+    m_pfnRelease = Release_Loopback_Message;
+}
+
+Loopback_Hub::Loopback_Hub() {
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+Loopback_Hub::~Loopback_Hub() {
+    for (auto& connection : connections) {
+        for (auto& message : connection.second.inbox)
+            message.second->Release();
+    }
+    pthread_mutex_destroy(&mutex);
+}
+
+SteamNetworkingMicroseconds Loopback_Hub::Now() {
+    return chrono::duration_cast<chrono::microseconds>(
+               chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Loopback_Hub::Set_State(HSteamNetConnection handle, ESteamNetworkingConnectionState state) {
+    Connection& connection = connections[handle];
+    SteamNetConnectionStatusChangedCallback_t status_change{};
+    status_change.m_hConn = handle;
+    status_change.m_eOldState = connection.state;
+    status_change.m_info.m_eState = state;
+    strncpy(status_change.m_info.m_szConnectionDescription, connection.name.c_str(),
+            sizeof(status_change.m_info.m_szConnectionDescription) - 1);
+    connection.state = state;
+    status_changes[connection.owner].emplace_back(status_change);
+}
+
+void Loopback_Hub::Remove_Connection(HSteamNetConnection handle) {
+    auto connection = connections.find(handle);
+    if (connection == connections.end())
+        return;
+    auto peer = connections.find(connection->second.peer);
+    if (peer != connections.end()) {
+        peer->second.peer = k_HSteamNetConnection_Invalid;
+        if (peer->second.state == k_ESteamNetworkingConnectionState_Connecting ||
+            peer->second.state == k_ESteamNetworkingConnectionState_Connected)
+            Set_State(peer->first, k_ESteamNetworkingConnectionState_ClosedByPeer);
+    }
+    for (auto& message : connection->second.inbox)
+        message.second->Release();
+    // Like the sockets, a closed connection gets no more callbacks
+    vector<SteamNetConnectionStatusChangedCallback_t>& changes =
+        status_changes[connection->second.owner];
+    erase_if(changes, [handle](const SteamNetConnectionStatusChangedCallback_t& status_change) {
+        return status_change.m_hConn == handle;
+    });
+    connections.erase(connection);
+}
+
+Loopback_Transport::Loopback_Transport(shared_ptr<Loopback_Hub> hub,
+                                       Loopback_Conditions conditions)
+    : hub(std::move(hub)), conditions(conditions), random(conditions.seed) {
+    assert(conditions.loss < 1);
+}
+
+Loopback_Transport::~Loopback_Transport() {
+    pthread_mutex_lock(&hub->mutex);
+    vector<HSteamNetConnection> owned_connections;
+    for (auto& connection : hub->connections) {
+        if (connection.second.owner == this)
+            owned_connections.emplace_back(connection.first);
+    }
+    for (HSteamNetConnection connection : owned_connections)
+        hub->Remove_Connection(connection);
+    erase_if(hub->listeners, [this](const auto& listener) { return listener.second == this; });
+    hub->status_changes.erase(this);
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+void Loopback_Transport::Set_Conditions(const Loopback_Conditions& conditions) {
+    assert(conditions.loss < 1);
+    pthread_mutex_lock(&hub->mutex);
+    this->conditions = conditions;
+    random.seed(conditions.seed);
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+bool Loopback_Transport::Start(Status_Callback status_callback) {
+    this->status_callback = std::move(status_callback);
+    return true;
+}
+
+HSteamListenSocket Loopback_Transport::Listen(uint16 port) {
+    pthread_mutex_lock(&hub->mutex);
+    HSteamListenSocket listen_socket = k_HSteamListenSocket_Invalid;
+    if (!hub->listeners.contains(port)) {
+        listen_socket = hub->next_handle++;
+        hub->listeners.emplace(port, this);
+        hub->listen_ports.emplace(listen_socket, port);
+    }
+    pthread_mutex_unlock(&hub->mutex);
+    return listen_socket;
+}
+
+void Loopback_Transport::Close_Listen_Socket(HSteamListenSocket listen_socket) {
+    pthread_mutex_lock(&hub->mutex);
+    auto port = hub->listen_ports.find(listen_socket);
+    if (port != hub->listen_ports.end()) {
+        hub->listeners.erase(port->second);
+        hub->listen_ports.erase(port);
+    }
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+HSteamNetConnection Loopback_Transport::Connect(uint16 port) {
+    pthread_mutex_lock(&hub->mutex);
+    HSteamNetConnection connection = hub->next_handle++;
+    hub->connections[connection].owner = this;
+    hub->Set_State(connection, k_ESteamNetworkingConnectionState_Connecting);
+    auto listener = hub->listeners.find(port);
+    if (listener == hub->listeners.end()) {
+        // The sockets would time out instead
+        hub->Set_State(connection, k_ESteamNetworkingConnectionState_ProblemDetectedLocally);
+    } else {
+        HSteamNetConnection server_connection = hub->next_handle++;
+        Loopback_Hub::Connection& incoming = hub->connections[server_connection];
+        incoming.owner = listener->second;
+        incoming.peer = connection;
+        incoming.name = "loopback #" + to_string(connection);
+        hub->connections[connection].peer = server_connection;
+        hub->Set_State(server_connection, k_ESteamNetworkingConnectionState_Connecting);
+    }
+    pthread_mutex_unlock(&hub->mutex);
+    return connection;
+}
+
+HSteamNetPollGroup Loopback_Transport::Create_Poll_Group() {
+    pthread_mutex_lock(&hub->mutex);
+    HSteamNetPollGroup poll_group = hub->next_handle++;
+    pthread_mutex_unlock(&hub->mutex);
+    return poll_group;
+}
+
+void Loopback_Transport::Destroy_Poll_Group(HSteamNetPollGroup poll_group) {
+    pthread_mutex_lock(&hub->mutex);
+    for (auto& connection : hub->connections) {
+        if (connection.second.poll_group == poll_group)
+            connection.second.poll_group = k_HSteamNetPollGroup_Invalid;
+    }
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+bool Loopback_Transport::Accept_Connection(HSteamNetConnection connection) {
+    pthread_mutex_lock(&hub->mutex);
+    auto incoming = hub->connections.find(connection);
+    bool accepted = incoming != hub->connections.end() && incoming->second.owner == this &&
+                    incoming->second.state == k_ESteamNetworkingConnectionState_Connecting &&
+                    hub->connections.contains(incoming->second.peer);
+    if (accepted) {
+        hub->Set_State(connection, k_ESteamNetworkingConnectionState_Connected);
+        hub->Set_State(incoming->second.peer, k_ESteamNetworkingConnectionState_Connected);
+    }
+    pthread_mutex_unlock(&hub->mutex);
+    return accepted;
+}
+
+bool Loopback_Transport::Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                                   HSteamNetPollGroup poll_group) {
+    pthread_mutex_lock(&hub->mutex);
+    auto found = hub->connections.find(connection);
+    if (found != hub->connections.end())
+        found->second.poll_group = poll_group;
+    pthread_mutex_unlock(&hub->mutex);
+    return found != hub->connections.end();
+}
+
+void Loopback_Transport::Set_Connection_Name(HSteamNetConnection connection, const char* name) {
+    pthread_mutex_lock(&hub->mutex);
+    auto found = hub->connections.find(connection);
+    if (found != hub->connections.end())
+        found->second.name = name;
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+bool Loopback_Transport::Configure_Lanes(HSteamNetConnection connection, int /*lane_count*/,
+                                         const int* /*priorities*/, const uint16* /*weights*/) {
+    pthread_mutex_lock(&hub->mutex);
+    bool found = hub->connections.contains(connection);
+    pthread_mutex_unlock(&hub->mutex);
+    return found;
+}
+
+void Loopback_Transport::Close_Connection(HSteamNetConnection connection, int /*reason*/,
+                                          const char* /*debug_message*/) {
+    pthread_mutex_lock(&hub->mutex);
+    hub->Remove_Connection(connection);
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+ISteamNetworkingMessage* Loopback_Transport::Allocate_Message(int size) {
+    return new Loopback_Message(size);
+}
+
+double Loopback_Transport::Random_Fraction() {
+    return uniform_real_distribution<double>(0, 1)(random);
+}
+
+SteamNetworkingMicroseconds Loopback_Transport::Arrival_Time(Loopback_Hub::Connection& from,
+                                                             int size, bool reliable) {
+    SteamNetworkingMicroseconds now = Loopback_Hub::Now();
+    SteamNetworkingMicroseconds sent = max(now, link_free);
+    if (conditions.bandwidth > 0) {
+        double waiting_bytes = (sent - now) * conditions.bandwidth / 1000000;
+        if (!reliable && waiting_bytes + size > conditions.send_buffer)
+            return -1;
+        sent += static_cast<SteamNetworkingMicroseconds>(size * 1000000.0 / conditions.bandwidth);
+    }
+    link_free = sent;
+
+    SteamNetworkingMicroseconds latency = conditions.latency_ms * 1000;
+    SteamNetworkingMicroseconds arrival =
+        sent + latency +
+        static_cast<SteamNetworkingMicroseconds>(conditions.jitter_ms * 1000 * Random_Fraction());
+    while (Random_Fraction() < conditions.loss) {
+        if (!reliable)
+            return -1;
+        arrival += 2 * latency;
+    }
+    if (reliable) {
+        arrival = max(arrival, from.last_reliable_arrival);
+        from.last_reliable_arrival = arrival;
+    }
+    return arrival;
+}
+
+void Loopback_Transport::Send_Messages(int count, ISteamNetworkingMessage* const* messages) {
+    pthread_mutex_lock(&hub->mutex);
+    for (int i = 0; i < count; i++) {
+        ISteamNetworkingMessage* message = messages[i];
+        auto from = hub->connections.find(message->m_conn);
+        auto to = from == hub->connections.end() ? hub->connections.end()
+                                                 : hub->connections.find(from->second.peer);
+        if (to == hub->connections.end()) {
+            message->Release();
+            continue;
+        }
+        SteamNetworkingMicroseconds arrival =
+            Arrival_Time(from->second, message->m_cbSize,
+                         message->m_nFlags & k_nSteamNetworkingSend_Reliable);
+        if (arrival < 0) {
+            message->Release();
+            continue;
+        }
+        message->m_conn = to->first;
+        to->second.inbox.emplace(arrival, message);
+    }
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+int Loopback_Transport::Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                                       ISteamNetworkingMessage** messages,
+                                                       int max) {
+    int received = 0;
+    SteamNetworkingMicroseconds now = Loopback_Hub::Now();
+    pthread_mutex_lock(&hub->mutex);
+    for (auto& connection : hub->connections) {
+        if (connection.second.owner != this || connection.second.poll_group != poll_group)
+            continue;
+        auto& inbox = connection.second.inbox;
+        while (received < max && !inbox.empty() && inbox.begin()->first <= now) {
+            messages[received++] = inbox.begin()->second;
+            inbox.erase(inbox.begin());
+        }
+    }
+    pthread_mutex_unlock(&hub->mutex);
+    return received;
+}
+
+int Loopback_Transport::Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                                       ISteamNetworkingMessage** messages,
+                                                       int max) {
+    int received = 0;
+    SteamNetworkingMicroseconds now = Loopback_Hub::Now();
+    pthread_mutex_lock(&hub->mutex);
+    auto found = hub->connections.find(connection);
+    if (found == hub->connections.end()) {
+        pthread_mutex_unlock(&hub->mutex);
+        return -1;
+    }
+    auto& inbox = found->second.inbox;
+    while (received < max && !inbox.empty() && inbox.begin()->first <= now) {
+        messages[received++] = inbox.begin()->second;
+        inbox.erase(inbox.begin());
+    }
+    pthread_mutex_unlock(&hub->mutex);
+    return received;
+}
+
+void Loopback_Transport::Run_Callbacks() {
+    vector<SteamNetConnectionStatusChangedCallback_t> changes;
+    pthread_mutex_lock(&hub->mutex);
+    changes.swap(hub->status_changes[this]);
+    pthread_mutex_unlock(&hub->mutex);
+    // The callback can call back into the transport
+    for (SteamNetConnectionStatusChangedCallback_t& status_change : changes)
+        status_callback(&status_change);
+}
@@ -0,0 +1,416 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+
+#include "networking/match_server.h"
+
+using namespace std;
+
+Match_Server::Match_Server(unique_ptr<Transport> transport) : transport(std::move(transport)) {
+    if (this->transport == nullptr)
+        this->transport = make_unique<Steam_Transport>();
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+Match_Server::~Match_Server() {
+    // The matches have to be destroyed first, only the connections without a match are left
+    for (auto& route : routes) {
+        for (ISteamNetworkingMessage* message : route.second.inbox)
+            message->Release();
+        transport->Close_Connection(route.first, 0, "Server Shutdown");
+    }
+    routes.clear();
+    if (poll_group != k_HSteamNetPollGroup_Invalid)
+        transport->Destroy_Poll_Group(poll_group);
+    if (listen_socket != k_HSteamListenSocket_Invalid)
+        transport->Close_Listen_Socket(listen_socket);
+    pthread_mutex_destroy(&mutex);
+}
+
+bool Match_Server::Start(uint16 port) {
+    if (!transport->Start([this](SteamNetConnectionStatusChangedCallback_t* status_change) {
+            On_Status_Changed(status_change);
+        }))
+        return false;
+    cout << "Starting match server on port " << port << endl;
+    listen_socket = transport->Listen(port);
+    if (listen_socket == k_HSteamListenSocket_Invalid) {
+        cerr << "Failed to listen on port " << port << endl;
+        return false;
+    }
+    poll_group = transport->Create_Poll_Group();
+    if (poll_group == k_HSteamNetPollGroup_Invalid) {
+        cerr << "Failed to create the poll group" << endl;
+        return false;
+    }
+    return true;
+}
+
+void Match_Server::On_Status_Changed(SteamNetConnectionStatusChangedCallback_t* status_change) {
+    HSteamNetConnection connection = status_change->m_hConn;
+    pthread_mutex_lock(&mutex);
+    switch (status_change->m_info.m_eState) {
+        case k_ESteamNetworkingConnectionState_Connecting:
+            // The match accepts the connection again once the client said which match it joins
+            if (!transport->Accept_Connection(connection) ||
+                !transport->Set_Connection_Poll_Group(connection, poll_group)) {
+                transport->Close_Connection(connection, 0, nullptr);
+                break;
+            }
+            routes[connection];
+            break;
+        case k_ESteamNetworkingConnectionState_ClosedByPeer:
+        case k_ESteamNetworkingConnectionState_ProblemDetectedLocally: {
+            auto route = routes.find(connection);
+            if (route == routes.end()) {
+                transport->Close_Connection(connection, 0, nullptr);
+                break;
+            }
+            Match_Transport* match = route->second.match;
+            if (match != nullptr && route->second.accepted) {
+                // The Network of the match closes the connection
+                match->Queue_Status_Change(connection, k_ESteamNetworkingConnectionState_Connected,
+                                           status_change->m_info.m_eState);
+                break;
+            }
+            if (match != nullptr) {
+                erase_if(match->status_changes,
+                         [connection](const SteamNetConnectionStatusChangedCallback_t& change) {
+                             return change.m_hConn == connection;
+                         });
+            }
+            Remove_Route(connection, nullptr);
+            break;
+        }
+        default:
+            break;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void Match_Server::Receive_Messages() {
+    ISteamNetworkingMessage* messages[64];
+    int received;
+    while ((received = transport->Receive_Messages_On_Poll_Group(poll_group, messages, 64)) > 0) {
+        for (int i = 0; i < received; i++) {
+            ISteamNetworkingMessage* message = messages[i];
+            auto route = routes.find(message->m_conn);
+            if (route == routes.end()) {
+                message->Release();
+                continue;
+            }
+            if (route->second.joined) {
+                route->second.inbox.emplace_back(message);
+                continue;
+            }
+            if (message->m_cbSize != sizeof(Match_ID)) {
+                message->Release();
+                cerr << "Expected the match to join from " << route->first << endl;
+                Remove_Route(route->first, "Expected the match to join");
+                continue;
+            }
+            route->second.joined = true;
+            memcpy(&route->second.match_id, message->m_pData, sizeof(Match_ID));
+            message->Release();
+            auto match = matches.find(route->second.match_id);
+            if (match != matches.end())
+                Route_Connection(route->first, route->second, match->second);
+        }
+        if (received < 64)
+            break;
+    }
+}
+
+void Match_Server::Route_Connection(HSteamNetConnection connection, Route& route,
+                                    Match_Transport* match) {
+    route.match = match;
+    match->connections.emplace_back(connection);
+    match->Queue_Status_Change(connection, k_ESteamNetworkingConnectionState_None,
+                               k_ESteamNetworkingConnectionState_Connecting);
+}
+
+void Match_Server::Remove_Route(HSteamNetConnection connection, const char* debug_message) {
+    auto route = routes.find(connection);
+    if (route == routes.end())
+        return;
+    for (ISteamNetworkingMessage* message : route->second.inbox)
+        message->Release();
+    if (route->second.match != nullptr)
+        erase(route->second.match->connections, connection);
+    routes.erase(route);
+    transport->Close_Connection(connection, 0, debug_message);
+}
+
+unique_ptr<Transport> Match_Server::Create_Match_Transport(Match_ID match_id) {
+    pthread_mutex_lock(&mutex);
+    if (matches.contains(match_id)) {
+        pthread_mutex_unlock(&mutex);
+        cerr << "Match " << match_id << " already exists" << endl;
+        return nullptr;
+    }
+    auto* match = new Match_Transport(*this, match_id);
+    matches.emplace(match_id, match);
+    for (auto& route : routes) {
+        if (route.second.joined && route.second.match == nullptr &&
+            route.second.match_id == match_id)
+            Route_Connection(route.first, route.second, match);
+    }
+    pthread_mutex_unlock(&mutex);
+    return unique_ptr<Transport>(match);
+}
+
+bool Match_Server::Has_Match(Match_ID match_id) {
+    pthread_mutex_lock(&mutex);
+    bool has_match = matches.contains(match_id);
+    pthread_mutex_unlock(&mutex);
+    return has_match;
+}
+
+void Match_Server::Update() {
+    transport->Run_Callbacks();
+    unordered_set<Match_ID> unknown_matches;
+    pthread_mutex_lock(&mutex);
+    Receive_Messages();
+    for (auto& route : routes) {
+        if (route.second.joined && route.second.match == nullptr)
+            unknown_matches.emplace(route.second.match_id);
+    }
+    pthread_mutex_unlock(&mutex);
+    if (unknown_matches.empty())
+        return;
+
+    // The hook creates the matches through Create_Match_Transport, so it can't hold the mutex
+    if (on_unknown_match) {
+        for (Match_ID match_id : unknown_matches)
+            on_unknown_match(match_id);
+    }
+    pthread_mutex_lock(&mutex);
+    vector<HSteamNetConnection> rejected;
+    for (auto& route : routes) {
+        if (route.second.joined && route.second.match == nullptr &&
+            unknown_matches.contains(route.second.match_id))
+            rejected.emplace_back(route.first);
+    }
+    for (HSteamNetConnection connection : rejected) {
+        cout << "Rejecting connection " << connection << " to an unknown match" << endl;
+        Remove_Route(connection, "Unknown match");
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+Match_Transport::Match_Transport(Match_Server& server, Match_ID match_id)
+    : server(server), match_id(match_id) {}
+
+Match_Transport::~Match_Transport() {
+    pthread_mutex_lock(&server.mutex);
+    server.matches.erase(match_id);
+    // Copied since Remove_Route removes the connection from the list
+    vector<HSteamNetConnection> remaining = connections;
+    for (HSteamNetConnection connection : remaining)
+        server.Remove_Route(connection, "Match closed");
+    pthread_mutex_unlock(&server.mutex);
+}
+
+void Match_Transport::Queue_Status_Change(HSteamNetConnection connection,
+                                          ESteamNetworkingConnectionState old_state,
+                                          ESteamNetworkingConnectionState state) {
+    SteamNetConnectionStatusChangedCallback_t status_change{};
+    status_change.m_hConn = connection;
+    status_change.m_eOldState = old_state;
+    status_change.m_info.m_eState = state;
+    snprintf(status_change.m_info.m_szConnectionDescription,
+             sizeof(status_change.m_info.m_szConnectionDescription), "match %u connection %u",
+             match_id, connection);
+    status_changes.emplace_back(status_change);
+}
+
+bool Match_Transport::Start(Status_Callback status_callback) {
+    this->status_callback = std::move(status_callback);
+    return true;
+}
+
+// The match shares the socket and the poll group of the server, the handles only need to be valid
+HSteamListenSocket Match_Transport::Listen(uint16 /*port*/) {
+    return 1;
+}
+
+HSteamNetConnection Match_Transport::Connect(uint16 /*port*/) {
+    return k_HSteamNetConnection_Invalid;
+}
+
+HSteamNetPollGroup Match_Transport::Create_Poll_Group() {
+    return 1;
+}
+
+bool Match_Transport::Accept_Connection(HSteamNetConnection connection) {
+    pthread_mutex_lock(&server.mutex);
+    auto route = server.routes.find(connection);
+    bool accepted = route != server.routes.end() && route->second.match == this &&
+                    !route->second.accepted;
+    if (accepted) {
+        route->second.accepted = true;
+        Queue_Status_Change(connection, k_ESteamNetworkingConnectionState_Connecting,
+                            k_ESteamNetworkingConnectionState_Connected);
+    }
+    pthread_mutex_unlock(&server.mutex);
+    return accepted;
+}
+
+bool Match_Transport::Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                                HSteamNetPollGroup /*poll_group*/) {
+    pthread_mutex_lock(&server.mutex);
+    auto route = server.routes.find(connection);
+    bool in_match = route != server.routes.end() && route->second.match == this;
+    pthread_mutex_unlock(&server.mutex);
+    return in_match;
+}
+
+void Match_Transport::Set_Connection_Name(HSteamNetConnection connection, const char* name) {
+    server.transport->Set_Connection_Name(connection, name);
+}
+
+bool Match_Transport::Configure_Lanes(HSteamNetConnection connection, int lane_count,
+                                      const int* priorities, const uint16* weights) {
+    return server.transport->Configure_Lanes(connection, lane_count, priorities, weights);
+}
+
+void Match_Transport::Close_Connection(HSteamNetConnection connection, int /*reason*/,
+                                       const char* debug_message) {
+    pthread_mutex_lock(&server.mutex);
+    auto route = server.routes.find(connection);
+    if (route != server.routes.end() && route->second.match == this) {
+        erase_if(status_changes,
+                 [connection](const SteamNetConnectionStatusChangedCallback_t& status_change) {
+                     return status_change.m_hConn == connection;
+                 });
+        server.Remove_Route(connection, debug_message);
+    }
+    pthread_mutex_unlock(&server.mutex);
+}
+
+ISteamNetworkingMessage* Match_Transport::Allocate_Message(int size) {
+    return server.transport->Allocate_Message(size);
+}
+
+void Match_Transport::Send_Messages(int count, ISteamNetworkingMessage* const* messages) {
+    server.transport->Send_Messages(count, messages);
+}
+
+int Match_Transport::Receive_Messages_On_Poll_Group(HSteamNetPollGroup /*poll_group*/,
+                                                    ISteamNetworkingMessage** messages, int max) {
+    int received = 0;
+    pthread_mutex_lock(&server.mutex);
+    for (HSteamNetConnection connection : connections) {
+        Match_Server::Route& route = server.routes[connection];
+        // Messages from a connection the Network didn't accept yet wait for it
+        if (!route.accepted)
+            continue;
+        while (received < max && !route.inbox.empty()) {
+            messages[received++] = route.inbox.front();
+            route.inbox.pop_front();
+        }
+    }
+    pthread_mutex_unlock(&server.mutex);
+    return received;
+}
+
+int Match_Transport::Receive_Messages_On_Connection(HSteamNetConnection /*connection*/,
+                                                    ISteamNetworkingMessage** /*messages*/,
+                                                    int /*max*/) {
+    return -1;
+}
+
+void Match_Transport::Run_Callbacks() {
+    vector<SteamNetConnectionStatusChangedCallback_t> changes;
+    pthread_mutex_lock(&server.mutex);
+    changes.swap(status_changes);
+    pthread_mutex_unlock(&server.mutex);
+    for (SteamNetConnectionStatusChangedCallback_t& status_change : changes)
+        status_callback(&status_change);
+}
+
+Match_Join_Transport::Match_Join_Transport(Match_ID match_id, unique_ptr<Transport> transport)
+    : transport(std::move(transport)), match_id(match_id) {
+    if (this->transport == nullptr)
+        this->transport = make_unique<Steam_Transport>();
+}
+
+bool Match_Join_Transport::Start(Status_Callback status_callback) {
+    return transport->Start(std::move(status_callback));
+}
+
+HSteamListenSocket Match_Join_Transport::Listen(uint16 port) {
+    return transport->Listen(port);
+}
+
+void Match_Join_Transport::Close_Listen_Socket(HSteamListenSocket listen_socket) {
+    transport->Close_Listen_Socket(listen_socket);
+}
+
+HSteamNetConnection Match_Join_Transport::Connect(uint16 port) {
+    HSteamNetConnection connection = transport->Connect(port);
+    if (connection == k_HSteamNetConnection_Invalid)
+        return connection;
+    ISteamNetworkingMessage* message = transport->Allocate_Message(sizeof(Match_ID));
+    memcpy(message->m_pData, &match_id, sizeof(Match_ID));
+    message->m_conn = connection;
+    message->m_nFlags = k_nSteamNetworkingSend_Reliable;
+    transport->Send_Messages(1, &message);
+    return connection;
+}
+
+HSteamNetPollGroup Match_Join_Transport::Create_Poll_Group() {
+    return transport->Create_Poll_Group();
+}
+
+void Match_Join_Transport::Destroy_Poll_Group(HSteamNetPollGroup poll_group) {
+    transport->Destroy_Poll_Group(poll_group);
+}
+
+bool Match_Join_Transport::Accept_Connection(HSteamNetConnection connection) {
+    return transport->Accept_Connection(connection);
+}
+
+bool Match_Join_Transport::Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                                     HSteamNetPollGroup poll_group) {
+    return transport->Set_Connection_Poll_Group(connection, poll_group);
+}
+
+void Match_Join_Transport::Set_Connection_Name(HSteamNetConnection connection, const char* name) {
+    transport->Set_Connection_Name(connection, name);
+}
+
+bool Match_Join_Transport::Configure_Lanes(HSteamNetConnection connection, int lane_count,
+                                           const int* priorities, const uint16* weights) {
+    return transport->Configure_Lanes(connection, lane_count, priorities, weights);
+}
+
+void Match_Join_Transport::Close_Connection(HSteamNetConnection connection, int reason,
+                                            const char* debug_message) {
+    transport->Close_Connection(connection, reason, debug_message);
+}
+
+ISteamNetworkingMessage* Match_Join_Transport::Allocate_Message(int size) {
+    return transport->Allocate_Message(size);
+}
+
+void Match_Join_Transport::Send_Messages(int count, ISteamNetworkingMessage* const* messages) {
+    transport->Send_Messages(count, messages);
+}
+
+int Match_Join_Transport::Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                                         ISteamNetworkingMessage** messages,
+                                                         int max) {
+    return transport->Receive_Messages_On_Poll_Group(poll_group, messages, max);
+}
+
+int Match_Join_Transport::Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                                         ISteamNetworkingMessage** messages,
+                                                         int max) {
+    return transport->Receive_Messages_On_Connection(connection, messages, max);
+}
+
+void Match_Join_Transport::Run_Callbacks() {
+    transport->Run_Callbacks();
+}
@@ -1,90 +1,155 @@
+#include <bit>
 #include <cassert>
-#include <steam/isteamnetworkingutils.h>
-#include <steam/steamnetworkingsockets.h>
+#include <cstring>
+#include <thread>
 
+#include "networking/compression.h"
 #include "networking/network.h"
 #include "networking/rpc_manager.h"
+#include "stats.h"
+#include <ranges>
 
 using namespace std;
-const uint16 DEFAULT_SERVER_PORT = 27020;
 
-Network::Network(bool server, std::function<void()> close_network_function)
-    : close_network_function(close_network_function), server(server) {
+Network::Network(bool server, std::function<void()> close_network_function,
+                 unique_ptr<Transport> transport)
+    : close_network_function(close_network_function), server(server),
+      transport(transport != nullptr ? std::move(transport) : make_unique<Steam_Transport>()) {
     pthread_mutex_init(&newly_connected_client_mutex, 0);
-    network_instance = this;
     state = Setting_Up;
     connection_events = make_unique<std::unordered_set<Network_Events_Receiver*>>();
     rpc_manager = make_unique<RPC_Manager>();
-    rpc_step_heap = priority_queue<Rpc_Message*, std::vector<Rpc_Message*>, Rpc_Step_Comparator>();
 }
 
 Network::~Network() {
+    // Start_Network was never called so there is nothing to shut down
+    if (state == Setting_Up) {
+        state = Closed;
+        return;
+    }
     state = Closed;
+    Stop_IO_Thread();
     if (server) {
         for (auto client_id : connected_clients) {
-            connection_api->CloseConnection(client_id.first, 0, "Shutting down server", false);
+            transport->Close_Connection(client_id.first, 0, "Shutting down server");
         }
         for (const Network_Events_Receiver* receiver : *connection_events) {
             const_cast<Network_Events_Receiver*>(receiver)->On_Server_Stop();
         }
-        connected_clients.clear();
-        connection_api->CloseListenSocket(listen_socket);
+        transport->Close_Listen_Socket(listen_socket);
         listen_socket = k_HSteamListenSocket_Invalid;
-        connection_api->DestroyPollGroup(poll_group);
+        transport->Destroy_Poll_Group(poll_group);
         poll_group = k_HSteamNetPollGroup_Invalid;
     }
-    GameNetworkingSockets_Kill();
+    for (auto& [client_id, connection_state] : connected_clients)
+        delete connection_state;
+    connected_clients.clear();
 }
 
 void Network::Start_Network() {
-    SteamDatagramErrMsg err_msg;
-    if (!GameNetworkingSockets_Init(nullptr, err_msg)) {
-        std::cerr << "GameNetworkingSockets initialization failed " << err_msg << std::endl;
+    if (!transport->Start([this](SteamNetConnectionStatusChangedCallback_t* new_status) {
+            On_Connection_Status_Changed(new_status);
+        }))
         exit(-1);
-    }
-    SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Debug,
-                                                   Debug_Output);
-
-    connection_api = SteamNetworkingSockets();
-    SteamNetworkingIPAddr addr_server;
-    addr_server.Clear();
-    addr_server.SetIPv6LocalHost(DEFAULT_SERVER_PORT);
-    SteamNetworkingConfigValue_t config_options;
-
-    config_options.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
-                          (void*) On_Connect_Changed_Adapter);
 
     if (server) {
         remote_host_connection = k_HSteamNetConnection_Invalid;
-        listen_socket = connection_api->CreateListenSocketIP(addr_server, 1, &config_options);
+        listen_socket = transport->Listen(DEFAULT_SERVER_PORT);
         if (listen_socket == k_HSteamListenSocket_Invalid)
-            cerr << "Failed to setup socket listener on port " << addr_server.m_port << endl;
-        poll_group = connection_api->CreatePollGroup();
+            cerr << "Failed to setup socket listener on port " << DEFAULT_SERVER_PORT << endl;
+        poll_group = transport->Create_Poll_Group();
         if (poll_group == k_HSteamNetPollGroup_Invalid)
-            cerr << "Failed to setup poll group listener on port " << addr_server.m_port << endl;
-        cout << "Starting server, listening on port: " << addr_server.m_port << endl;
+            cerr << "Failed to setup poll group listener on port " << DEFAULT_SERVER_PORT << endl;
+        cout << "Starting server, listening on port: " << DEFAULT_SERVER_PORT << endl;
         state = Server_Running;
         for (const Network_Events_Receiver* receiver : *connection_events) {
             const_cast<Network_Events_Receiver*>(receiver)->On_Server_Start();
         }
     } else {
         cout << "Starting client" << endl;
-        remote_host_connection =
-            connection_api->ConnectByIPAddress(addr_server, 1, &config_options);
+        remote_host_connection = transport->Connect(DEFAULT_SERVER_PORT);
         if (remote_host_connection == k_HSteamNetConnection_Invalid)
             cerr << "Failed to create connection to the host" << endl;
+        else
+            Configure_Lanes(remote_host_connection);
         state = Client_Connecting;
     }
+    if (transport->Needs_IO_Thread()) {
+        io_running = true;
+        pthread_create(&io_thread, nullptr, IO_Thread_Function, this);
+    }
+}
+
+void* Network::IO_Thread_Function(void* network) {
+    static_cast<Network*>(network)->Do_IO_Loop();
+    return nullptr;
+}
+
+void Network::Do_IO_Loop() {
+    while (io_running) {
+        bool sent = Send_Queued_Messages();
+        bool received = Receive_From_Sockets();
+        if (!sent && !received)
+            this_thread::sleep_for(chrono::microseconds(io_idle_sleep_us));
+    }
+    // Everything flushed before shutting down still has to go out, a batch at a time
+    bool sent = true;
+    while (sent)
+        sent = Send_Queued_Messages();
+}
+
+bool Network::Receive_From_Sockets() {
+    // Messages that don't fit stay in the sockets until the simulation catches up
+    int count = static_cast<int>(min<size_t>(receive_batch_size, incoming_queue.Free_Slots()));
+    if (count == 0)
+        return false;
+    ISteamNetworkingMessage* messages[receive_batch_size];
+    int received = server ? transport->Receive_Messages_On_Poll_Group(poll_group, messages, count)
+                          : transport->Receive_Messages_On_Connection(remote_host_connection,
+                                                                      messages, count);
+    for (int i = 0; i < received; i++)
+        incoming_queue.Push(messages[i]);
+    return received > 0;
+}
+
+bool Network::Send_Queued_Messages() {
+    ISteamNetworkingMessage* messages[receive_batch_size];
+    int count = 0;
+    while (count < receive_batch_size && (messages[count] = outgoing_queue.Pop()) != nullptr)
+        count++;
+    if (count == 0)
+        return false;
+    // The sockets take ownership of the messages and keep the order of each connection
+    transport->Send_Messages(count, messages);
+    return true;
+}
+
+void Network::Stop_IO_Thread() {
+    if (io_running) {
+        io_running = false;
+        pthread_join(io_thread, nullptr);
+    }
+    while (ISteamNetworkingMessage* message = incoming_queue.Pop())
+        message->Release();
+    while (ISteamNetworkingMessage* message = outgoing_queue.Pop())
+        message->Release();
 }
 
 void Network::Network_Update() {
     Poll_Incoming_Messages();
-    connection_api->RunCallbacks();
+    transport->Run_Callbacks();
+    // Send the rpcs that were relayed while receiving
+    Flush_Messages();
     if (state == Closing) {
         close_network_function();
     }
 }
 
+/* Deleter of received messages, the rpcs that point into a message share its ownership. */
+static void Release_Message(ISteamNetworkingMessage* message) {
+    message->Release();
+}
+
 /**
  * Handles receiving messages sent from the clients.
  */
@@ -99,56 +164,50 @@ void Network::Poll_Incoming_Messages() {
             if (get<0>(pre_connected_messages[i]) != client_id)
                 continue;
             Rpc_Message* d = get<1>(pre_connected_messages[i]);
-            Receive_Message(client_id, d);
             pre_connected_messages.erase(pre_connected_messages.begin() + i);
-            delete d;
+            Receive_Message(client_id, d);
             i--;
         }
     }
     newly_connected_clients.clear();
     pthread_mutex_unlock(&newly_connected_client_mutex);
 
-    while (true) {
-        ISteamNetworkingMessage* incoming_message = nullptr;
-        int num_messages = -2;
-
-        if (server)
-            num_messages =
-                connection_api->ReceiveMessagesOnPollGroup(poll_group, &incoming_message, 1);
-        else
-            num_messages = connection_api->ReceiveMessagesOnConnection(remote_host_connection,
-                                                                       &incoming_message, 1);
-
-        if (num_messages == 0)
+    // Without an I/O thread the messages are taken from the transport here, as many as fit
+    bool receiving = !transport->Needs_IO_Thread();
+    while (receiving)
+        receiving = Receive_From_Sockets();
+    // Only the messages that are already queued, the I/O thread keeps adding more
+    for (size_t i = 0; i < message_queue_size; i++) {
+        ISteamNetworkingMessage* incoming_message = incoming_queue.Pop();
+        if (incoming_message == nullptr)
             break;
-        if (num_messages < 0)
-            cerr << "Error checking messages on server: " << server
-                 << ". Number of messages is: " << num_messages << endl;
-        assert(num_messages == 1 && incoming_message);
-        // // It's easier to parse the string as a c-string instead of a c++ string at first
-        // std::string cstring_message;
-        // cstring_message.assign((const char*)incoming_message->m_pData,
-        // incoming_message->m_cbSize); const char* message = cstring_message.c_str();
-
-        if (server) {
-            auto client = connected_clients.find(incoming_message->m_conn);
-            assert(client != connected_clients.end());
-        } else {
-            // cout << cstring_message << endl;
+        // The I/O thread can receive a message right before the client is disconnected
+        if (server && !connected_clients.contains(incoming_message->m_conn)) {
+            incoming_message->Release();
+            continue;
         }
+        Traffic_Stats::Connection_Traffic& traffic =
+            traffic_stats.connections[incoming_message->GetConnection()];
+        traffic.messages_in++;
+        traffic.bytes_in += incoming_message->GetSize();
+        // Released once every rpc in it has been invoked
         Receive_Message(incoming_message->GetConnection(),
-                        static_cast<char*>(incoming_message->m_pData), incoming_message->m_cbSize);
-        incoming_message->Release();
+                        shared_ptr<ISteamNetworkingMessage>(incoming_message, Release_Message));
     }
 }
 
-/**
- * This static method is needed to convert On_Connection_Status_Changed to a
- * (void*) anonymous function instead of a method. We go around this by using a
- * static instance to point to the correct method that we wanted to call.
- */
-void Network::On_Connect_Changed_Adapter(SteamNetConnectionStatusChangedCallback_t* new_status) {
-    network_instance->On_Connection_Status_Changed(new_status);
+void Network::Remove_Client(HSteamNetConnection connection) {
+    for (const Network_Events_Receiver* receiver : *connection_events) {
+        const_cast<Network_Events_Receiver*>(receiver)->On_Client_Disconnected(connection);
+    }
+    delete connected_clients[connection];
+    connected_clients.erase(connection);
+    outgoing_batches.erase(connection);
+    outgoing_unreliable_batches.erase(connection);
+    outgoing_snapshots.erase(connection);
+    held_spectator_snapshots.erase(connection);
+    rpc_id_maps.erase(connection);
+    traffic_stats.connections.erase(connection);
 }
 
 void Network::On_Connection_Status_Changed(SteamNetConnectionStatusChangedCallback_t* new_status) {
@@ -166,13 +225,9 @@ void Network::On_Connection_Status_Changed(SteamNetConnectionStatusChangedCallba
                 if (new_status->m_eOldState != k_ESteamNetworkingConnectionState_Connected) {
                     assert(connected_clients.contains(client_id));
                     assert(new_status->m_eOldState == k_ESteamNetworkingConnectionState_Connecting);
-                    connection_api->CloseConnection(new_status->m_hConn,
-                                                    new_status->m_info.m_eState, nullptr, false);
-                    for (const Network_Events_Receiver* receiver : *connection_events) {
-                        const_cast<Network_Events_Receiver*>(receiver)->On_Client_Disconnected(
-                            client_id);
-                    }
-                    connected_clients.erase(client_id);
+                    transport->Close_Connection(new_status->m_hConn,
+                                                new_status->m_info.m_eState, nullptr);
+                    Remove_Client(client_id);
                     break;
                 }
 
@@ -186,20 +241,16 @@ void Network::On_Connection_Status_Changed(SteamNetConnectionStatusChangedCallba
                         "Internal problem on the server with id: " + to_string(client_id);
                 }
                 cout << debug_message << endl;
-                connection_api->CloseConnection(new_status->m_hConn, new_status->m_info.m_eState,
-                                                debug_message.c_str(), false);
-                for (const Network_Events_Receiver* receiver : *connection_events) {
-                    const_cast<Network_Events_Receiver*>(receiver)->On_Client_Disconnected(
-                        client_id);
-                }
-                connected_clients.erase(client_id);
+                transport->Close_Connection(new_status->m_hConn, new_status->m_info.m_eState,
+                                            debug_message.c_str());
+                Remove_Client(client_id);
             } else {
                 if (new_status->m_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer)
                     cout << "Leaving server due to server request" << endl;
                 else
                     cout << "Leaving server" << endl;
-                connection_api->CloseConnection(new_status->m_hConn, new_status->m_info.m_eState,
-                                                nullptr, false);
+                transport->Close_Connection(new_status->m_hConn, new_status->m_info.m_eState,
+                                            nullptr);
                 vector<Network_Events_Receiver*> receivers;
                 for (const Network_Events_Receiver* receiver : *connection_events) {
                     receivers.emplace_back(const_cast<Network_Events_Receiver*>(receiver));
@@ -217,20 +268,22 @@ void Network::On_Connection_Status_Changed(SteamNetConnectionStatusChangedCallba
                 cerr << "Trying to connect a client that has already been connected!" << endl;
             }
             cout << "Connecting client " << new_status->m_info.m_szConnectionDescription << endl;
-            if (connection_api->AcceptConnection(new_status->m_hConn) != k_EResultOK) {
-                connection_api->CloseConnection(new_status->m_hConn,
-                                                k_ESteamNetworkingConnectionState_ClosedByPeer,
-                                                "Likely disconnected before connected", false);
+            if (!transport->Accept_Connection(new_status->m_hConn)) {
+                transport->Close_Connection(new_status->m_hConn,
+                                            k_ESteamNetworkingConnectionState_ClosedByPeer,
+                                            "Likely disconnected before connected");
                 cout << "Couldn't connect client, they might have disconnected already" << endl;
                 break;
             }
-            if (!connection_api->SetConnectionPollGroup(new_status->m_hConn, poll_group)) {
-                connection_api->CloseConnection(new_status->m_hConn,
-                                                k_ESteamNetworkingConnectionState_ClosedByPeer,
-                                                "Couldn't add client to a poll group", false);
+            if (!transport->Set_Connection_Poll_Group(new_status->m_hConn, poll_group)) {
+                transport->Close_Connection(new_status->m_hConn,
+                                            k_ESteamNetworkingConnectionState_ClosedByPeer,
+                                            "Couldn't add client to a poll group");
             }
+            Configure_Lanes(new_status->m_hConn);
             connected_clients.emplace(client_id, new Connection_State());
-            connection_api->SetConnectionName(new_status->m_hConn, to_string(client_id).c_str());
+            connected_clients[client_id]->receives_step_frames = !sent_step_frames;
+            transport->Set_Connection_Name(new_status->m_hConn, to_string(client_id).c_str());
             for (const Network_Events_Receiver* receiver : *connection_events) {
                 const_cast<Network_Events_Receiver*>(receiver)->On_Client_Connected(client_id);
             }
@@ -287,26 +340,285 @@ std::string Network::Get_Network_State_Str() const {
     return "Error";
 }
 
+void Network::Configure_Lanes(HSteamNetConnection connection) {
+    // A lower number is a higher priority, the small unreliable messages go out first
+    const int priorities[] = {1, 0};
+    const uint16 weights[] = {1, 1};
+    if (!transport->Configure_Lanes(connection, 2, priorities, weights))
+        cerr << "Failed to configure the lanes of connection " << connection << endl;
+}
+
 void Network::Send_Message_To_Client(const Client_ID connection, const Rpc_Message& rpc_message) {
-    clmdep_msgpack::sbuffer message_data;
-    clmdep_msgpack::packer packer(message_data);
+    Rpc_ID id = RPC_Manager::Read_Id(rpc_message.rpc_call);
+    Announce_Rpc(connection, id);
+    if (rpc_message.associated_step == -2 &&
+        rpc_manager->Get_Delivery(id) == RPC_Manager::Unreliable_Latest) {
+        Message_Batch& batch = Get_Unreliable_Batch(connection, rpc_message.rpc_call_size + 16);
+        Write_Unreliable_Header(connection, batch, rpc_message.rpc_call_size);
+        batch.write(rpc_message.rpc_call, rpc_message.rpc_call_size);
+        return;
+    }
+    Message_Batch& batch = Get_Batch(connection, rpc_message.rpc_call_size + 24);
+    long rpc_id = rpc_message.order_sensitive ? Next_Rpc_Id(connection, true) : rpc_message.rpc_id;
+    rpc_message.Write(batch, rpc_id);
+}
+
+Network::Message_Batch& Network::Get_Batch(Client_ID connection, size_t size) {
+    Message_Batch& batch = outgoing_batches[connection];
+    if (!batch.data.empty() && batch.data.size() + size > max_batch_size)
+        Close_Batch(connection, batch, true);
+    return batch;
+}
+
+Network::Message_Batch& Network::Get_Unreliable_Batch(Client_ID connection, size_t size) {
+    Message_Batch& batch = outgoing_unreliable_batches[connection];
+    if (!batch.data.empty() && batch.data.size() + size > max_unreliable_batch_size)
+        Close_Batch(connection, batch, false);
+    return batch;
+}
+
+void Network::Write_Unreliable_Header(Client_ID connection, Message_Batch& batch,
+                                      size_t call_size) {
+    char record = Unreliable_Rpc_Record;
+    batch.write(&record, 1);
+    Write_Varint(batch, connected_clients[connection]->next_unreliable_sequence++);
+    Write_Varint(batch, call_size);
+}
 
+long Network::Next_Rpc_Id(Client_ID connection, bool order_sensitive) {
     // Only ordered rpc calls will have an ID
-    if (rpc_message.order_sensitive)
-        packer.pack(Rpc_Message(rpc_message, connected_clients[connection]->next_rpc_id++));
-    else
-        packer.pack(rpc_message);
+    if (!order_sensitive)
+        return -1;
+    return connected_clients[connection]->next_rpc_id++;
+}
+
+void Network::Close_Batch(Client_ID connection, Message_Batch& batch, bool reliable) {
+    // Unreliable batches are kept within a packet so there is nothing to gain from compressing them
+    const vector<char>& data =
+        reliable && batch.data.size() >= compression_threshold && Compress_Batch(batch)
+            ? compression_buffer.data
+            : batch.data;
+    ISteamNetworkingMessage* message = transport->Allocate_Message(static_cast<int>(data.size()));
+    memcpy(message->m_pData, data.data(), data.size());
+    message->m_conn = connection;
+    if (reliable) {
+        message->m_nFlags = k_nSteamNetworkingSend_Reliable;
+        message->m_idxLane = reliable_lane;
+    } else {
+        message->m_nFlags = k_nSteamNetworkingSend_UnreliableNoNagle;
+        message->m_idxLane = unreliable_lane;
+    }
+    outgoing_messages.emplace_back(message);
+    Traffic_Stats::Connection_Traffic& traffic = traffic_stats.connections[connection];
+    traffic.messages_out++;
+    traffic.bytes_out += static_cast<long>(data.size());
+    // Keeps the capacity for the next batch
+    batch.data.clear();
+}
 
-    connection_api->SendMessageToConnection(connection, message_data.data(),
-                                            static_cast<uint32>(message_data.size()),
-                                            k_nSteamNetworkingSend_Reliable, nullptr);
+bool Network::Compress_Batch(const Message_Batch& batch) {
+    compression_buffer.data.clear();
+    char record = Compressed_Record;
+    compression_buffer.write(&record, 1);
+    Write_Varint(compression_buffer, batch.data.size());
+    Compress_Block(batch.data.data(), batch.data.size(), compression_buffer.data);
+    compression_stats.bytes_before += static_cast<long>(batch.data.size());
+    if (compression_buffer.data.size() >= batch.data.size()) {
+        compression_stats.messages_not_compressed++;
+        compression_stats.bytes_after += static_cast<long>(batch.data.size());
+        return false;
+    }
+    compression_stats.messages_compressed++;
+    compression_stats.bytes_after += static_cast<long>(compression_buffer.data.size());
+    return true;
+}
+
+void Network::Write_Stats(ostream& out) const {
+    out << "{\"connections\":{";
+    bool first = true;
+    for (const auto& [connection, traffic] : traffic_stats.connections) {
+        out << (first ? "" : ",") << "\"" << connection << "\":{\"messages_in\":"
+            << traffic.messages_in << ",\"bytes_in\":" << traffic.bytes_in
+            << ",\"messages_out\":" << traffic.messages_out
+            << ",\"bytes_out\":" << traffic.bytes_out << "}";
+        first = false;
+    }
+    out << "},\"rpc_calls\":{";
+    first = true;
+    for (size_t rpc_id = 0; rpc_id < traffic_stats.rpc_calls.size(); rpc_id++) {
+        if (traffic_stats.rpc_calls[rpc_id] == 0 || rpc_id >= rpc_manager->Get_Rpc_Count())
+            continue;
+        out << (first ? "" : ",");
+        Write_Json_String(out, rpc_manager->Get_Name(rpc_id));
+        out << ":" << traffic_stats.rpc_calls[rpc_id];
+        first = false;
+    }
+    out << "},\"compression\":{\"messages_compressed\":"
+        << compression_stats.messages_compressed
+        << ",\"messages_not_compressed\":" << compression_stats.messages_not_compressed
+        << ",\"ratio\":" << compression_stats.Ratio() << "}}";
+}
+
+void Network::Flush_Messages() {
+    if (state != Server_Running && state != Client_Connecting && state != Client_Connected) {
+        outgoing_batches.clear();
+        outgoing_unreliable_batches.clear();
+        return;
+    }
+    for (auto it = outgoing_snapshots.begin(); it != outgoing_snapshots.end();) {
+        for (int i = 0; i < snapshot_chunks_per_flush && it->second.offset < it->second.data.size();
+             i++)
+            Write_Snapshot_Chunk(it->first, it->second);
+        if (it->second.offset >= it->second.data.size())
+            it = outgoing_snapshots.erase(it);
+        else
+            it++;
+    }
+    for (auto& [connection, batch] : outgoing_batches) {
+        if (!batch.data.empty())
+            Close_Batch(connection, batch, true);
+    }
+    for (auto& [connection, batch] : outgoing_unreliable_batches) {
+        if (!batch.data.empty())
+            Close_Batch(connection, batch, false);
+    }
+    if (!transport->Needs_IO_Thread()) {
+        if (!outgoing_messages.empty())
+            transport->Send_Messages(static_cast<int>(outgoing_messages.size()),
+                                     outgoing_messages.data());
+        outgoing_messages.clear();
+        return;
+    }
+    for (ISteamNetworkingMessage* message : outgoing_messages) {
+        // The I/O thread keeps sending, so a full queue has room again shortly
+        while (!outgoing_queue.Push(message))
+            this_thread::yield();
+    }
+    outgoing_messages.clear();
 }
 
 void Network::Send_Message_To_Clients(const Rpc_Message& rpc_message) {
     assert(rpc_message.associated_step != -1);
-    for (const auto& client_id : connected_clients) {
-        Send_Message_To_Client(client_id.first, rpc_message);
+    if (server && rpc_message.associated_step >= 0) {
+        // Step rpcs are the same for every client, so they are packed once and sent with the frame
+        Step_Frame& frame = step_frames[rpc_message.associated_step];
+        Write_Varint(frame.calls, rpc_message.rpc_call_size);
+        frame.calls.write(rpc_message.rpc_call, rpc_message.rpc_call_size);
+        frame.count++;
+        frame.rpc_ids.emplace_back(RPC_Manager::Read_Id(rpc_message.rpc_call));
+        return;
+    }
+    for (const auto& [client_id, connection] : connected_clients) {
+        // Rpcs of the running match are part of the snapshot a late client is waiting for
+        if (connection->receives_step_frames)
+            Send_Message_To_Client(client_id, rpc_message);
+    }
+}
+
+void Network::Send_Step_Frames(long step) {
+    sent_step_frames = true;
+    bool has_spectators = Has_Spectators();
+    while (!step_frames.empty() && step_frames.begin()->first <= step) {
+        auto& [frame_step, frame] = *step_frames.begin();
+        for (const auto& [client_id, connection] : connected_clients) {
+            if (connection->receives_step_frames && !connection->spectator)
+                Write_Step_Frame(client_id, *connection, frame_step, frame);
+        }
+        if (has_spectators)
+            spectator_frames.insert(step_frames.extract(step_frames.begin()));
+        else
+            step_frames.erase(step_frames.begin());
+    }
+}
+
+void Network::Write_Step_Frame(Client_ID client, Connection_State& connection, long step,
+                               const Step_Frame& frame) {
+    for (Rpc_ID rpc_id : frame.rpc_ids)
+        Announce_Rpc(client, rpc_id);
+    Message_Batch& batch = Get_Batch(client, frame.calls.data.size() + 32);
+    // Each call of the frame takes the next rpc id of the connection so the receiver orders them
+    // like rpcs that were sent on their own
+    long first_rpc_id = connection.next_rpc_id;
+    connection.next_rpc_id += frame.count;
+    char record = Step_Frame_Record;
+    batch.write(&record, 1);
+    Write_Varint(batch, first_rpc_id);
+    Write_Signed_Varint(batch, step);
+    Write_Varint(batch, frame.count);
+    batch.write(frame.calls.data.data(), frame.calls.data.size());
+}
+
+bool Network::Has_Spectators() const {
+    for (const auto& [client_id, connection] : connected_clients) {
+        if (connection->spectator)
+            return true;
     }
+    return false;
+}
+
+void Network::Set_Spectator(Client_ID client) {
+    auto connection = connected_clients.find(client);
+    if (connection != connected_clients.end())
+        connection->second->spectator = true;
+}
+
+void Network::Send_Spectator_Frames(long step) {
+    // The snapshots go first so that the frames after them are sent to their spectators as well
+    for (auto it = held_spectator_snapshots.begin(); it != held_spectator_snapshots.end();) {
+        if (it->second.step > step + 1) {
+            it++;
+            continue;
+        }
+        connected_clients[it->first]->receives_step_frames = true;
+        Snapshot_Transfer& snapshot = outgoing_snapshots[it->first];
+        snapshot = std::move(it->second);
+        Write_Snapshot_Chunk(it->first, snapshot);
+        it = held_spectator_snapshots.erase(it);
+    }
+    while (!spectator_frames.empty() && spectator_frames.begin()->first <= step) {
+        auto& [frame_step, frame] = *spectator_frames.begin();
+        for (const auto& [client_id, connection] : connected_clients) {
+            if (connection->receives_step_frames && connection->spectator &&
+                frame_step >= connection->first_spectator_step)
+                Write_Step_Frame(client_id, *connection, frame_step, frame);
+        }
+        spectator_frames.erase(spectator_frames.begin());
+    }
+}
+
+void Network::Send_Snapshot(Client_ID client, long step, vector<char> data) {
+    auto connection = connected_clients.find(client);
+    if (connection == connected_clients.end())
+        return;
+    if (connection->second->spectator) {
+        connection->second->first_spectator_step = step;
+        held_spectator_snapshots[client] = Snapshot_Transfer{step, std::move(data), 0};
+        return;
+    }
+    connection->second->receives_step_frames = true;
+    Snapshot_Transfer& snapshot = outgoing_snapshots[client];
+    snapshot = Snapshot_Transfer{step, std::move(data), 0};
+    // The first chunk goes before any step frame so the client knows which steps to drop
+    Write_Snapshot_Chunk(client, snapshot);
+}
+
+void Network::Write_Snapshot_Chunk(Client_ID client, Snapshot_Transfer& snapshot) {
+    size_t size = min(snapshot_chunk_size, snapshot.data.size() - snapshot.offset);
+    Message_Batch& batch = Get_Batch(client, size + 32);
+    char record = Snapshot_Chunk_Record;
+    batch.write(&record, 1);
+    Write_Signed_Varint(batch, snapshot.step);
+    Write_Varint(batch, snapshot.data.size());
+    Write_Varint(batch, snapshot.offset);
+    Write_Varint(batch, size);
+    batch.write(snapshot.data.data() + snapshot.offset, size);
+    snapshot.offset += size;
+}
+
+void Network::Set_Snapshot_Receiver(function<void(long step, const char* data, size_t size)>
+                                        receiver) {
+    snapshot_receiver = std::move(receiver);
+    Deliver_Snapshot();
 }
 
 void Network::Send_Message_To_Server(const Rpc_Message& rpc_message) {
@@ -314,11 +626,223 @@ void Network::Send_Message_To_Server(const Rpc_Message& rpc_message) {
     Send_Message_To_Client(remote_host_connection, rpc_message);
 }
 
-void Network::Receive_Message(Client_ID from, char* data, size_t size) {
-    clmdep_msgpack::object_handle result;
-    clmdep_msgpack::unpack(result, data, size);
-    auto tmp = result.get().as<Rpc_Message>();
-    auto* rpc = new Rpc_Message(result.get().as<Rpc_Message>());
+bool Rpc_Message::Read(unsigned char record, Rpc_Reader& reader,
+                       shared_ptr<ISteamNetworkingMessage> message, Rpc_Message& rpc) {
+    rpc.order_sensitive = record & record_order_sensitive_flag;
+    rpc.rpc_id = rpc.order_sensitive ? static_cast<long>(reader.Read_Varint()) : -1;
+    rpc.associated_step = reader.Read_Signed_Varint();
+    rpc.rpc_call_size = reader.Read_Varint();
+    rpc.rpc_call = reader.Read_Bytes(rpc.rpc_call_size);
+    rpc.message = std::move(message);
+    return !reader.failed;
+}
+
+void Network::Receive_Message(Client_ID from, shared_ptr<ISteamNetworkingMessage> message,
+                              bool decompressed) {
+    // A message holds every record that was batched for this connection in one flush
+    Rpc_Reader reader(static_cast<const char*>(message->GetData()), message->GetSize());
+    while (!reader.Done()) {
+        unsigned char record = reader.Read_Byte();
+        bool valid = true;
+        switch (record & record_type_mask) {
+            case Rpc_Record: {
+                auto* rpc = new Rpc_Message();
+                valid = Rpc_Message::Read(record, reader, message, *rpc);
+                if (!valid) {
+                    delete rpc;
+                    break;
+                }
+                Translate_Rpc_Call(from, rpc->rpc_call, rpc->rpc_call_size);
+                Queue_Received_Rpc(from, rpc);
+                break;
+            }
+            case Step_Frame_Record:
+                valid = Receive_Step_Frame(from, reader, message);
+                break;
+            case Announcement_Record:
+                valid = Receive_Rpc_Announcement(from, reader);
+                break;
+            case Unreliable_Rpc_Record:
+                valid = Receive_Unreliable_Rpc(from, reader);
+                break;
+            case Compressed_Record:
+                // Compressed records are never nested, refusing them keeps a message from
+                // expanding once more at every level
+                valid = !decompressed && Receive_Compressed_Message(from, reader);
+                break;
+            case Snapshot_Chunk_Record:
+                valid = Receive_Snapshot_Chunk(reader);
+                break;
+            default:
+                valid = false;
+        }
+        if (!valid) {
+            cerr << "Dropping the rest of a message with a broken record!" << endl;
+            return;
+        }
+    }
+}
+
+void Network::Announce_Rpc(Client_ID connection, Rpc_ID id) {
+    Rpc_Id_Map& map = rpc_id_maps[connection];
+    if (id < map.announced.size() && map.announced[id])
+        return;
+    if (id >= map.announced.size())
+        map.announced.resize(rpc_manager->Get_Rpc_Count(), false);
+    map.announced[id] = true;
+    const string& name = rpc_manager->Get_Name(id);
+    Message_Batch& batch = Get_Batch(connection, name.size() + 8);
+    char record = Announcement_Record;
+    batch.write(&record, 1);
+    Write_Varint(batch, id);
+    Rpc_Codec<string>::Write(batch, name);
+}
+
+bool Network::Receive_Rpc_Announcement(Client_ID from, Rpc_Reader& reader) {
+    auto remote_id = static_cast<Rpc_ID>(reader.Read_Varint());
+    string name = Rpc_Codec<string>::Read(reader);
+    if (reader.failed || remote_id >= RPC_Manager::no_rpc)
+        return false;
+    Rpc_Id_Map& map = rpc_id_maps[from];
+    if (remote_id >= map.remote_to_local.size())
+        map.remote_to_local.resize(remote_id + 1, RPC_Manager::no_rpc);
+    map.remote_to_local[remote_id] = rpc_manager->Get_Id(name);
+    return true;
+}
+
+bool Network::Translate_Rpc_Call(Client_ID from, const char* call, size_t size, bool report) {
+    if (size < RPC_Manager::id_size)
+        return false;
+    Rpc_ID remote_id = RPC_Manager::Read_Id(call);
+    const Rpc_Id_Map& map = rpc_id_maps[from];
+    Rpc_ID local_id = remote_id < map.remote_to_local.size() ? map.remote_to_local[remote_id]
+                                                             : RPC_Manager::no_rpc;
+    if (local_id == RPC_Manager::no_rpc && report)
+        cerr << "Received rpc " << remote_id << " before its name was announced!" << endl;
+    // The call points into a message received by this machine, so it can be rewritten. An unknown
+    // id is kept in order as an invalid call so that the rpcs after it aren't stuck.
+    RPC_Manager::Write_Id(const_cast<char*>(call), local_id);
+    return local_id != RPC_Manager::no_rpc;
+}
+
+bool Network::Receive_Step_Frame(Client_ID from, Rpc_Reader& reader,
+                                 const shared_ptr<ISteamNetworkingMessage>& message) {
+    // Only the server frames the steps, a client sending frames would rewrite the rpc order
+    if (server)
+        return false;
+    long first_rpc_id = static_cast<long>(reader.Read_Varint());
+    long step = reader.Read_Signed_Varint();
+    uint64_t count = reader.Read_Varint();
+    // Check the whole frame first, queueing part of it would leave a gap in the rpc ids
+    Rpc_Reader check = reader;
+    for (uint64_t i = 0; i < count && !check.failed; i++)
+        check.Read_Bytes(check.Read_Varint());
+    if (check.failed)
+        return false;
+    for (uint64_t i = 0; i < count; i++) {
+        size_t call_size = reader.Read_Varint();
+        auto* rpc = new Rpc_Message(true, step, reader.Read_Bytes(call_size), call_size);
+        rpc->rpc_id = first_rpc_id + static_cast<long>(i);
+        rpc->message = message;
+        Translate_Rpc_Call(from, rpc->rpc_call, rpc->rpc_call_size);
+        Queue_Received_Rpc(from, rpc);
+    }
+    return true;
+}
+
+bool Network::Receive_Compressed_Message(Client_ID from, Rpc_Reader& reader) {
+    size_t size = reader.Read_Varint();
+    if (reader.failed || size == 0 || size > max_decompressed_size)
+        return false;
+    const char* block = reader.Position();
+    size_t block_size = reader.Remaining();
+    reader.Read_Bytes(block_size);
+    // The records are decompressed into a message of their own so that the received rpcs can point
+    // into it like into any other message
+    ISteamNetworkingMessage* message = transport->Allocate_Message(static_cast<int>(size));
+    message->m_conn = from;
+    if (!Decompress_Block(block, block_size, static_cast<char*>(message->m_pData), size)) {
+        message->Release();
+        return false;
+    }
+    Receive_Message(from, shared_ptr<ISteamNetworkingMessage>(message, Release_Message), true);
+    return true;
+}
+
+bool Network::Receive_Snapshot_Chunk(Rpc_Reader& reader) {
+    // Only the server sends snapshots, a client sending one would rewind the steps of the server
+    if (server)
+        return false;
+    long step = reader.Read_Signed_Varint();
+    size_t size = reader.Read_Varint();
+    size_t offset = reader.Read_Varint();
+    size_t chunk_size = reader.Read_Varint();
+    const char* chunk = reader.Read_Bytes(chunk_size);
+    if (reader.failed || size > max_snapshot_size)
+        return false;
+    if (offset == 0) {
+        incoming_snapshot = make_unique<Snapshot_Transfer>();
+        incoming_snapshot->step = step;
+        incoming_snapshot->data.resize(size);
+        Skip_To_Step(step);
+    }
+    // The chunks are sent reliably and in order, so each one continues the last
+    if (incoming_snapshot == nullptr || incoming_snapshot->step != step ||
+        incoming_snapshot->offset != offset || offset + chunk_size > size) {
+        cerr << "Received a snapshot chunk out of order!" << endl;
+        return false;
+    }
+    if (chunk_size > 0)
+        memcpy(incoming_snapshot->data.data() + offset, chunk, chunk_size);
+    incoming_snapshot->offset += chunk_size;
+    Deliver_Snapshot();
+    return true;
+}
+
+void Network::Deliver_Snapshot() {
+    if (snapshot_receiver == nullptr || incoming_snapshot == nullptr ||
+        incoming_snapshot->offset != incoming_snapshot->data.size())
+        return;
+    auto snapshot = std::move(incoming_snapshot);
+    snapshot_receiver(snapshot->step, snapshot->data.data(), snapshot->data.size());
+}
+
+void Network::Skip_To_Step(long step) {
+    for (auto& bucket : step_buckets) {
+        for (Rpc_Message* rpc : bucket)
+            delete rpc;
+        bucket.clear();
+    }
+    for (Rpc_Message* rpc : next_step_rpcs)
+        delete rpc;
+    next_step_rpcs.clear();
+    last_step = step - 1;
+    last_processed_step = step - 1;
+}
+
+bool Network::Receive_Unreliable_Rpc(Client_ID from, Rpc_Reader& reader) {
+    long sequence = static_cast<long>(reader.Read_Varint());
+    size_t call_size = reader.Read_Varint();
+    const char* call = reader.Read_Bytes(call_size);
+    if (reader.failed)
+        return false;
+    // The announcement of the rpc is sent reliably and can arrive after the call, the call is
+    // dropped like a lost one since the sender sends these again anyway
+    auto connection = connected_clients.find(from);
+    if (connection == connected_clients.end() || !Translate_Rpc_Call(from, call, call_size, false))
+        return true;
+    Rpc_ID id = RPC_Manager::Read_Id(call);
+    vector<long>& latest = connection->second->latest_unreliable_sequence;
+    if (id >= latest.size())
+        latest.resize(rpc_manager->Get_Rpc_Count(), -1);
+    if (sequence <= latest[id])
+        return true;
+    latest[id] = sequence;
+    invoke_rpc(false, -2, call, call_size);
+    return true;
+}
+
+void Network::Queue_Received_Rpc(Client_ID from, Rpc_Message* rpc) {
     if (!connected_clients.contains(from)) {
         pre_connected_messages.emplace_back(make_tuple(from, rpc));
         return;
@@ -328,39 +852,103 @@ void Network::Receive_Message(Client_ID from, char* data, size_t size) {
 
 void Network::Receive_Message(Client_ID from, Rpc_Message* rpc) {
     if (!rpc->order_sensitive) {
-        invoke_rpc(rpc->order_sensitive, rpc->associated_step, rpc->rpc_call.data(),
-                   rpc->rpc_call.size());
+        Deliver_Rpc(rpc);
+        return;
+    }
+    Connection_State* connection = connected_clients[from];
+    if (rpc->rpc_id < connection->next_rpc_id_to_receive) {
+        cerr << "Dropping rpc " << rpc->rpc_id << " that was already received!" << endl;
+        delete rpc;
         return;
     }
-    if (rpc->rpc_id > connected_clients[from]->next_rpc_id) {
+    if (rpc->rpc_id > connection->next_rpc_id_to_receive) {
         // This rpc has arrived earlier than a previous rpc and should be called later once the
-        // previous ones arrive Make sure to copy the rpc to memory so that it isn't accidentally
-        // deleted
-        connected_clients[from]->rpc_order_heap.push(rpc);
+        // previous ones arrive
+        connection->Hold_Rpc(rpc);
         return;
     }
 
-    connected_clients[from]->next_rpc_id++;
-    rpc->associated_step == -2 ? invoke_rpc(rpc->order_sensitive, rpc->associated_step,
-                                            rpc->rpc_call.data(), rpc->rpc_call.size())
-                               : rpc_step_heap.emplace(rpc);
-
+    connection->next_rpc_id_to_receive++;
+    Deliver_Rpc(rpc);
     // Check if we have any other rpcs stored to call
-    while (!connected_clients[from]->rpc_order_heap.empty() &&
-           connected_clients[from]->next_rpc_id ==
-               connected_clients[from]->rpc_order_heap.top()->rpc_id) {
-        connected_clients[from]->next_rpc_id++;
-        Rpc_Message* next_rpc_message = connected_clients[from]->rpc_order_heap.top();
-        next_rpc_message->associated_step == -2
-            ? invoke_rpc(next_rpc_message->order_sensitive, rpc->associated_step,
-                         next_rpc_message->rpc_call.data(), next_rpc_message->rpc_call.size())
-            : rpc_step_heap.emplace(rpc);
+    while (Rpc_Message* next_rpc_message = connection->Take_Next_Rpc()) {
+        connection->next_rpc_id_to_receive++;
+        Deliver_Rpc(next_rpc_message);
+    }
+}
+
+Network::Connection_State::~Connection_State() {
+    for (Rpc_Message* rpc : reorder_window)
+        delete rpc;
+}
+
+void Network::Connection_State::Hold_Rpc(Rpc_Message* rpc) {
+    size_t distance = rpc->rpc_id - next_rpc_id_to_receive;
+    if (distance >= reorder_window.size()) {
+        // Every held rpc is within the old size of next_rpc_id_to_receive, so they can't collide
+        // in the bigger window
+        vector<Rpc_Message*> window(bit_ceil(distance + 1), nullptr);
+        for (Rpc_Message* held : reorder_window) {
+            if (held != nullptr)
+                window[held->rpc_id & (window.size() - 1)] = held;
+        }
+        reorder_window = std::move(window);
+    }
+    Rpc_Message*& slot = reorder_window[rpc->rpc_id & (reorder_window.size() - 1)];
+    if (slot != nullptr) {
+        cerr << "Dropping rpc " << rpc->rpc_id << " that was already received!" << endl;
+        delete rpc;
+        return;
+    }
+    slot = rpc;
+}
+
+Rpc_Message* Network::Connection_State::Take_Next_Rpc() {
+    Rpc_Message*& slot = reorder_window[next_rpc_id_to_receive & (reorder_window.size() - 1)];
+    if (slot == nullptr || slot->rpc_id != next_rpc_id_to_receive)
+        return nullptr;
+    Rpc_Message* rpc = slot;
+    slot = nullptr;
+    return rpc;
+}
+
+void Network::Deliver_Rpc(Rpc_Message* rpc) {
+    if (rpc->associated_step == -2) {
+        invoke_rpc(rpc->order_sensitive, rpc->associated_step, rpc->rpc_call, rpc->rpc_call_size);
+        delete rpc;
+        return;
+    }
+    Add_Step_Rpc(rpc);
+}
 
-        connected_clients[from]->rpc_order_heap.pop();
+void Network::Add_Step_Rpc(Rpc_Message* rpc) {
+    if (rpc->associated_step == -1 || rpc->associated_step <= last_processed_step) {
+        if (rpc->associated_step != -1)
+            cerr << "Received an rpc for step " << rpc->associated_step
+                 << " after the step was processed!" << endl;
+        next_step_rpcs.emplace_back(rpc);
+        return;
+    }
+    size_t distance = rpc->associated_step - last_processed_step;
+    if (distance >= step_buckets.size()) {
+        vector<vector<Rpc_Message*>> buckets(bit_ceil(distance + 1));
+        for (auto& bucket : step_buckets) {
+            if (!bucket.empty())
+                buckets[bucket.front()->associated_step & (buckets.size() - 1)] = std::move(bucket);
+        }
+        step_buckets = std::move(buckets);
     }
+    step_buckets[rpc->associated_step & (step_buckets.size() - 1)].emplace_back(rpc);
 }
 
-void Network::invoke_rpc(bool order_sensitive, long associated_step, char* data, size_t size) {
+void Network::invoke_rpc(bool order_sensitive, long associated_step, const char* data,
+                         size_t size) {
+    if (size >= RPC_Manager::id_size) {
+        Rpc_ID rpc_id = RPC_Manager::Read_Id(data);
+        if (rpc_id >= traffic_stats.rpc_calls.size())
+            traffic_stats.rpc_calls.resize(rpc_id + 1);
+        traffic_stats.rpc_calls[rpc_id]++;
+    }
     if (server) {
         auto result = rpc_manager->call_data_rpc(data, size);
         if (result == RPC_Manager::INVALID) {
@@ -375,7 +963,10 @@ void Network::invoke_rpc(bool order_sensitive, long associated_step, char* data,
         auto result = rpc_manager->call_data_rpc(data, size);
         // The rpc call must be valid by this point
         if (result != RPC_Manager::VALID && result != RPC_Manager::VALID_CALL_ON_CLIENTS) {
-            string rpc_name = data + 4;
+            Rpc_ID rpc_id =
+                size >= RPC_Manager::id_size ? RPC_Manager::Read_Id(data) : RPC_Manager::no_rpc;
+            string rpc_name =
+                rpc_id < rpc_manager->Get_Rpc_Count() ? rpc_manager->Get_Name(rpc_id) : "unknown";
             cerr << "Client received an invalid rpc call " << rpc_name
                  << "! This is probably due to a desync!" << endl;
         }
@@ -383,27 +974,28 @@ void Network::invoke_rpc(bool order_sensitive, long associated_step, char* data,
 }
 
 void Network::Process_Step_Rpcs(long step) {
-    if (!rpc_step_heap.empty() && !server)
-        assert(rpc_step_heap.top()->associated_step >= step);
-
+    assert(step > last_processed_step);
     last_step = step;
-
-    while (!rpc_step_heap.empty() && (rpc_step_heap.top()->associated_step == step ||
-                                      rpc_step_heap.top()->associated_step == -1)) {
-        Rpc_Message* rpc = rpc_step_heap.top();
-        assert(rpc->associated_step == step || (server && rpc->associated_step == -1));
-        invoke_rpc(rpc->order_sensitive, step, rpc->rpc_call.data(), rpc->rpc_call.size());
-
-        rpc_step_heap.pop();
+    last_processed_step = step;
+
+    // The rpcs are taken out first since calling them can add more rpcs
+    vector<Rpc_Message*>& bucket = step_buckets[step & (step_buckets.size() - 1)];
+    step_rpcs_to_call.insert(step_rpcs_to_call.end(), next_step_rpcs.begin(),
+                             next_step_rpcs.end());
+    step_rpcs_to_call.insert(step_rpcs_to_call.end(), bucket.begin(), bucket.end());
+    next_step_rpcs.clear();
+    bucket.clear();
+    for (Rpc_Message* rpc : step_rpcs_to_call) {
+        assert(rpc->associated_step <= step);
+        if (on_step_rpc != nullptr)
+            on_step_rpc(step, rpc->rpc_call, rpc->rpc_call_size);
+        invoke_rpc(rpc->order_sensitive, step, rpc->rpc_call, rpc->rpc_call_size);
+        delete rpc;
     }
+    // Keeps the capacity for the next step
+    step_rpcs_to_call.clear();
 }
 
-void Debug_Output(ESteamNetworkingSocketsDebugOutputType error_type, const char* pszMsg) {
-    if (error_type == k_ESteamNetworkingSocketsDebugOutputType_Bug) {
-        cerr << pszMsg << endl;
-    } else {
-        // cout << pszMsg << endl;
-    }
+void Network::Queue_Recorded_Rpc(long step, const char* call, size_t size) {
+    Add_Step_Rpc(new Rpc_Message(true, step, call, size));
 }
-
-Network* Network::network_instance = nullptr;
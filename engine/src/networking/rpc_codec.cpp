@@ -0,0 +1,44 @@
+#include "networking/rpc_codec.h"
+
+using namespace std;
+
+unsigned char Rpc_Reader::Read_Byte() {
+    if (position == end) {
+        failed = true;
+        return 0;
+    }
+    return *position++;
+}
+
+uint64_t Rpc_Reader::Read_Varint() {
+    uint64_t value = 0;
+    // A 64 bit value takes at most 10 bytes
+    for (int shift = 0; shift < 70; shift += 7) {
+        if (position == end) {
+            failed = true;
+            return 0;
+        }
+        unsigned char byte = *position++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    failed = true;
+    return 0;
+}
+
+int64_t Rpc_Reader::Read_Signed_Varint() {
+    uint64_t value = Read_Varint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+const char* Rpc_Reader::Read_Bytes(size_t size) {
+    if (static_cast<size_t>(end - position) < size) {
+        failed = true;
+        position = end;
+        return nullptr;
+    }
+    const char* bytes = reinterpret_cast<const char*>(position);
+    position += size;
+    return bytes;
+}
@@ -1,46 +1,40 @@
-#include "rpc/client.h"
 #include <iostream>
 
 #include "networking/rpc_manager.h"
 
 using namespace std;
-RPC_Manager::RPC_Manager() : dispatcher(std::make_shared<rpc::detail::dispatcher>()) {}
 
-
-template <typename... Elements>
-void RPC_Manager::call_rpc(std::string const& function_name, tuple<Elements...> args) const {
-    auto call_obj = make_tuple(static_cast<uint8_t>(0), 1, function_name, args);
-
-    auto buffer = new clmdep_msgpack::v1::sbuffer;
-    clmdep_msgpack::v1::pack(*buffer, call_obj);
-    clmdep_msgpack::v1::object_handle result;
-    // Pass the msgpack::object_handle
-    unpack(result, buffer->data(), buffer->size());
-    dispatcher->dispatch(result.get());
-    delete buffer;
+Rpc_ID RPC_Manager::Get_Id(std::string const& function_name) {
+    auto id = ids.find(function_name);
+    if (id != ids.end())
+        return id->second;
+    auto new_id = static_cast<Rpc_ID>(bindings.size());
+    if (new_id >= no_rpc) {
+        cerr << "Can't register rpc " << function_name << ", there are too many rpcs!" << endl;
+        exit(-1);
+    }
+    bindings.push_back({function_name});
+    ids.emplace(function_name, new_id);
+    return new_id;
 }
 
-RPC_Manager::Rpc_Validator_Result RPC_Manager::call_data_rpc(char* data, size_t length) const {
-    clmdep_msgpack::v1::object_handle result2;
-    // Pass the msgpack::object_handle
-    unpack(result2, data, length);
-    auto response = dispatcher->dispatch(result2.get());
-    auto result = response.get_result()->get();
-    if (result.type != clmdep_msgpack::type::POSITIVE_INTEGER)
+RPC_Manager::Rpc_Validator_Result RPC_Manager::call_data_rpc(const char* data,
+                                                             size_t length) const {
+    if (length < id_size)
         return INVALID;
-    return static_cast<Rpc_Validator_Result>(result.as<int>());
+    Rpc_ID id = Read_Id(data);
+    if (id >= bindings.size() || !bindings[id].thunk)
+        return INVALID;
+    Rpc_Reader reader(data + id_size, length - id_size);
+    return bindings[id].thunk(reader);
 }
 
-template <typename Function>
-void RPC_Manager::bind_rpc(string const& function_name, Function function) {
-    dispatcher->bind(function_name, function);
+Rpc_ID RPC_Manager::Read_Id(const char* data) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<Rpc_ID>(bytes[0]) | static_cast<Rpc_ID>(bytes[1]) << 8;
 }
 
-template <typename... Args>
-clmdep_msgpack::v1::sbuffer* RPC_Manager::pack_rpc(std::string const& function_name, Args... args) {
-    auto call_obj = make_tuple(static_cast<uint8_t>(0), 1, function_name, make_tuple(args...));
-
-    auto buffer = new clmdep_msgpack::v1::sbuffer;
-    clmdep_msgpack::v1::pack(*buffer, call_obj);
-    return buffer;
+void RPC_Manager::Write_Id(char* data, Rpc_ID id) {
+    data[0] = static_cast<char>(id);
+    data[1] = static_cast<char>(id >> 8);
 }
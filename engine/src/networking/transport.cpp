@@ -0,0 +1,127 @@
+#include <iostream>
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+
+#include "networking/transport.h"
+
+using namespace std;
+
+static void Debug_Output(ESteamNetworkingSocketsDebugOutputType error_type, const char* pszMsg) {
+    if (error_type == k_ESteamNetworkingSocketsDebugOutputType_Bug) {
+        cerr << pszMsg << endl;
+    } else {
+        // cout << pszMsg << endl;
+    }
+}
+
+Steam_Transport::~Steam_Transport() {
+    if (!started)
+        return;
+    transport_instance = nullptr;
+    GameNetworkingSockets_Kill();
+}
+
+bool Steam_Transport::Start(Status_Callback status_callback) {
+    SteamDatagramErrMsg err_msg;
+    if (!GameNetworkingSockets_Init(nullptr, err_msg)) {
+        cerr << "GameNetworkingSockets initialization failed " << err_msg << endl;
+        return false;
+    }
+    SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Debug,
+                                                   Debug_Output);
+    sockets = SteamNetworkingSockets();
+    this->status_callback = std::move(status_callback);
+    transport_instance = this;
+    started = true;
+    return true;
+}
+
+/**
+ * The sockets take a plain function pointer as the callback, so the static instance points the
+ * call at the transport.
+ */
+void Steam_Transport::On_Status_Changed_Adapter(
+    SteamNetConnectionStatusChangedCallback_t* new_status) {
+    transport_instance->status_callback(new_status);
+}
+
+static SteamNetworkingIPAddr Local_Address(uint16 port) {
+    SteamNetworkingIPAddr address;
+    address.Clear();
+    address.SetIPv6LocalHost(port);
+    return address;
+}
+
+HSteamListenSocket Steam_Transport::Listen(uint16 port) {
+    SteamNetworkingConfigValue_t config_options;
+    config_options.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
+                          (void*) On_Status_Changed_Adapter);
+    return sockets->CreateListenSocketIP(Local_Address(port), 1, &config_options);
+}
+
+void Steam_Transport::Close_Listen_Socket(HSteamListenSocket listen_socket) {
+    sockets->CloseListenSocket(listen_socket);
+}
+
+HSteamNetConnection Steam_Transport::Connect(uint16 port) {
+    SteamNetworkingConfigValue_t config_options;
+    config_options.SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
+                          (void*) On_Status_Changed_Adapter);
+    return sockets->ConnectByIPAddress(Local_Address(port), 1, &config_options);
+}
+
+HSteamNetPollGroup Steam_Transport::Create_Poll_Group() {
+    return sockets->CreatePollGroup();
+}
+
+void Steam_Transport::Destroy_Poll_Group(HSteamNetPollGroup poll_group) {
+    sockets->DestroyPollGroup(poll_group);
+}
+
+bool Steam_Transport::Accept_Connection(HSteamNetConnection connection) {
+    return sockets->AcceptConnection(connection) == k_EResultOK;
+}
+
+bool Steam_Transport::Set_Connection_Poll_Group(HSteamNetConnection connection,
+                                                HSteamNetPollGroup poll_group) {
+    return sockets->SetConnectionPollGroup(connection, poll_group);
+}
+
+void Steam_Transport::Set_Connection_Name(HSteamNetConnection connection, const char* name) {
+    sockets->SetConnectionName(connection, name);
+}
+
+bool Steam_Transport::Configure_Lanes(HSteamNetConnection connection, int lane_count,
+                                      const int* priorities, const uint16* weights) {
+    return sockets->ConfigureConnectionLanes(connection, lane_count, priorities, weights) ==
+           k_EResultOK;
+}
+
+void Steam_Transport::Close_Connection(HSteamNetConnection connection, int reason,
+                                       const char* debug_message) {
+    sockets->CloseConnection(connection, reason, debug_message, false);
+}
+
+ISteamNetworkingMessage* Steam_Transport::Allocate_Message(int size) {
+    return SteamNetworkingUtils()->AllocateMessage(size);
+}
+
+void Steam_Transport::Send_Messages(int count, ISteamNetworkingMessage* const* messages) {
+    sockets->SendMessages(count, messages, nullptr);
+}
+
+int Steam_Transport::Receive_Messages_On_Poll_Group(HSteamNetPollGroup poll_group,
+                                                    ISteamNetworkingMessage** messages, int max) {
+    return sockets->ReceiveMessagesOnPollGroup(poll_group, messages, max);
+}
+
+int Steam_Transport::Receive_Messages_On_Connection(HSteamNetConnection connection,
+                                                    ISteamNetworkingMessage** messages, int max) {
+    return sockets->ReceiveMessagesOnConnection(connection, messages, max);
+}
+
+void Steam_Transport::Run_Callbacks() {
+    sockets->RunCallbacks();
+}
+
+Steam_Transport* Steam_Transport::transport_instance = nullptr;
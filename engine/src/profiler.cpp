@@ -0,0 +1,305 @@
+#include "profiler.h"
+
+#include "ecs.h"
+#include <fstream>
+#include <iomanip>
+#include <utility>
+
+using namespace std;
+
+ECS_Profiler::ECS_Profiler(ECS& ecs, int thread_count, int history_size)
+    : ecs(ecs), enabled(false), start_time(chrono::steady_clock::now()),
+      thread_count(thread_count), worker_counters(new Worker_Counters[thread_count]),
+      worker_stats_start(0), worker_stats_end(0), steps(0), worker_stats_interval(0), history_start(0),
+      history_count(0), trace_steps_left(0) {
+    thread_events = vector<vector<Event>>(thread_count);
+    history = vector<Step_Stats>(history_size);
+    Reset_Worker_Stats();
+}
+
+void ECS_Profiler::Set_Enabled(bool enabled) {
+    // The worker stats only cover the time the profiler was enabled
+    if (enabled && !Is_Enabled())
+        Reset_Worker_Stats();
+    if (!enabled && Is_Enabled())
+        worker_stats_end = chrono::duration_cast<chrono::nanoseconds>(
+                               chrono::steady_clock::now() - start_time)
+                               .count();
+    this->enabled = enabled;
+    if (!enabled)
+        trace_steps_left = 0;
+}
+
+void ECS_Profiler::End_Step() {
+    if (!Is_Enabled())
+        return;
+
+    int system_count = 0;
+    for (auto& systems : ecs.blocks)
+        system_count += systems.size();
+
+    // Reuse the oldest entry once the history is full so that its vectors keep their capacity
+    int history_index = (history_start + history_count) % history.size();
+    if (history_count == history.size())
+        history_start = (history_start + 1) % history.size();
+    else
+        history_count++;
+    Step_Stats& stats = history[history_index];
+    stats.step_time = 0;
+    stats.clean_up_time = 0;
+    stats.create_time = 0;
+    stats.delete_time = 0;
+    stats.block_times.assign(ecs.blocks.size(), 0);
+    stats.system_times.assign(system_count, 0);
+    stats.system_chunks.assign(system_count, 0);
+
+    for (auto& events : thread_events) {
+        for (auto& event : events) {
+            switch (event.type) {
+                case Step:
+                    stats.step_time += event.duration;
+                    break;
+                case Block:
+                    stats.block_times[event.index] += event.duration;
+                    break;
+                case System_Chunk:
+                    if (event.index >= 0 && event.index < system_count) {
+                        stats.system_times[event.index] += event.duration;
+                        stats.system_chunks[event.index]++;
+                    }
+                    break;
+                case Clean_Up:
+                    stats.clean_up_time += event.duration;
+                    break;
+                case Create_Entities:
+                    stats.create_time += event.duration;
+                    break;
+                case Delete_Entities:
+                    stats.delete_time += event.duration;
+                    break;
+                case Complete_Work:
+                    break;
+            }
+        }
+        if (trace_steps_left > 0)
+            trace_events.insert(trace_events.end(), events.begin(), events.end());
+        events.clear();
+    }
+
+    if (trace_steps_left > 0 && --trace_steps_left == 0) {
+        Write_Chrome_Trace(trace_path);
+        trace_events.clear();
+    }
+
+    steps++;
+    if (worker_stats_interval > 0 && steps % worker_stats_interval == 0) {
+        Print_Worker_Stats(cout);
+        Reset_Worker_Stats();
+    }
+}
+
+void ECS_Profiler::Start_Trace(int steps, string path) {
+    trace_events.clear();
+    trace_steps_left = steps;
+    trace_path = std::move(path);
+    Set_Enabled(true);
+}
+
+void ECS_Profiler::Write_Chrome_Trace(const string& path) const {
+    ofstream out(path);
+    if (!out) {
+        cerr << "Failed to open " << path << " to write the ECS trace." << endl;
+        return;
+    }
+    static const char* categories[] = {"step",     "block",  "system", "complete_work",
+                                       "clean_up", "create", "delete"};
+    // The trace format expects microseconds
+    out << fixed << setprecision(3) << "{\"traceEvents\":[";
+    for (size_t i = 0; i < trace_events.size(); i++) {
+        const Event& event = trace_events[i];
+        if (i != 0)
+            out << ",";
+        out << "\n{\"name\":\"" << Get_Event_Name(event) << "\",\"cat\":\""
+            << categories[event.type] << "\",\"ph\":\"X\",\"ts\":" << event.start / 1000.0
+            << ",\"dur\":" << event.duration / 1000.0 << ",\"pid\":0,\"tid\":" << event.thread
+            << "}";
+    }
+    out << "\n]}" << endl;
+    cout << "Wrote " << trace_events.size() << " ECS trace events to " << path << endl;
+}
+
+vector<ECS_Profiler::Step_Stats> ECS_Profiler::Get_Step_History() const {
+    vector<Step_Stats> steps;
+    steps.reserve(history_count);
+    for (int i = 0; i < history_count; i++)
+        steps.emplace_back(history[(history_start + i) % history.size()]);
+    return steps;
+}
+
+ECS_Profiler::Step_Stats ECS_Profiler::Get_Average_Stats() const {
+    Step_Stats average = {0, 0, 0, 0, {}, {}, {}};
+    if (history_count == 0)
+        return average;
+    for (int i = 0; i < history_count; i++) {
+        const Step_Stats& stats = history[(history_start + i) % history.size()];
+        average.step_time += stats.step_time;
+        average.clean_up_time += stats.clean_up_time;
+        average.create_time += stats.create_time;
+        average.delete_time += stats.delete_time;
+        // Systems and blocks registered part way through are averaged over all steps
+        average.block_times.resize(max(average.block_times.size(), stats.block_times.size()));
+        average.system_times.resize(max(average.system_times.size(), stats.system_times.size()));
+        average.system_chunks.resize(
+            max(average.system_chunks.size(), stats.system_chunks.size()));
+        for (size_t b = 0; b < stats.block_times.size(); b++)
+            average.block_times[b] += stats.block_times[b];
+        for (size_t s = 0; s < stats.system_times.size(); s++) {
+            average.system_times[s] += stats.system_times[s];
+            average.system_chunks[s] += stats.system_chunks[s];
+        }
+    }
+    average.step_time /= history_count;
+    average.clean_up_time /= history_count;
+    average.create_time /= history_count;
+    average.delete_time /= history_count;
+    for (auto& time : average.block_times)
+        time /= history_count;
+    for (auto& time : average.system_times)
+        time /= history_count;
+    for (auto& chunks : average.system_chunks)
+        chunks /= history_count;
+    return average;
+}
+
+void ECS_Profiler::Print_Summary(ostream& out) const {
+    Step_Stats average = Get_Average_Stats();
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << fixed << setprecision(3);
+    out << "ECS step (average of " << history_count << " steps): " << average.step_time / 1e6
+        << " ms" << endl;
+    for (size_t b = 0; b < average.block_times.size(); b++)
+        out << "  Block " << b << ": " << average.block_times[b] / 1e6 << " ms" << endl;
+    out << "  Clean_Up: " << average.clean_up_time / 1e6
+        << " ms, create: " << average.create_time / 1e6
+        << " ms, delete: " << average.delete_time / 1e6 << " ms" << endl;
+    // The averaged chunk counts are rounded down, so count them again here
+    vector<long> chunks(average.system_chunks.size(), 0);
+    for (int i = 0; i < history_count; i++) {
+        const Step_Stats& stats = history[(history_start + i) % history.size()];
+        for (size_t s = 0; s < stats.system_chunks.size(); s++)
+            chunks[s] += stats.system_chunks[s];
+    }
+    out << "Systems (cpu time summed over all workers):" << endl;
+    for (size_t s = 0; s < average.system_times.size(); s++) {
+        Event event = {System_Chunk, static_cast<int>(s), 0, 0, 0};
+        out << "  " << left << setw(12) << Get_Event_Name(event) << right << setw(12)
+            << average.system_times[s] / 1e6 << " ms" << setw(8)
+            << static_cast<double>(chunks[s]) / history_count << " chunks" << endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void ECS_Profiler::Clear_History() {
+    history_start = 0;
+    history_count = 0;
+}
+
+void ECS_Profiler::Set_History_Size(int size) {
+    history = vector<Step_Stats>(max(size, 1));
+    Clear_History();
+}
+
+string ECS_Profiler::Get_Event_Name(const Event& event) const {
+    switch (event.type) {
+        case Step:
+            return "Step";
+        case Block:
+            return "Block " + to_string(event.index);
+        case System_Chunk: {
+            int index = event.index;
+            for (auto& systems : ecs.blocks) {
+                if (index < systems.size())
+                    return systems[index]->name.empty() ? "System " + to_string(event.index)
+                                                        : systems[index]->name;
+                index -= systems.size();
+            }
+            return "System " + to_string(event.index);
+        }
+        case Complete_Work:
+            return "Complete_Work";
+        case Clean_Up:
+            return "Clean_Up";
+        case Create_Entities:
+            return "Create_Entities";
+        case Delete_Entities:
+            return "Delete_Entities";
+    }
+    return "Unknown";
+}
+
+vector<ECS_Profiler::Worker_Stats> ECS_Profiler::Get_Worker_Stats() const {
+    vector<Worker_Stats> stats;
+    stats.reserve(thread_count);
+    for (int i = 0; i < thread_count; i++) {
+        const Worker_Counters& counters = worker_counters[i];
+        stats.emplace_back(counters.chunks.load(memory_order_relaxed),
+                           counters.entities.load(memory_order_relaxed),
+                           counters.busy_time.load(memory_order_relaxed),
+                           counters.idle_time.load(memory_order_relaxed),
+                           counters.lock_wait_time.load(memory_order_relaxed),
+                           counters.empty_polls.load(memory_order_relaxed));
+    }
+    return stats;
+}
+
+void ECS_Profiler::Reset_Worker_Stats() {
+    for (int i = 0; i < thread_count; i++) {
+        Worker_Counters& counters = worker_counters[i];
+        counters.chunks = 0;
+        counters.entities = 0;
+        counters.busy_time = 0;
+        counters.idle_time = 0;
+        counters.lock_wait_time = 0;
+        counters.empty_polls = 0;
+    }
+    // Now returns 0 while disabled, so use the clock directly
+    worker_stats_start =
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_time)
+            .count();
+}
+
+void ECS_Profiler::Print_Worker_Stats(ostream& out) const {
+    long end = Is_Enabled() ? Now() : worker_stats_end;
+    long elapsed = end - worker_stats_start;
+    auto stats = Get_Worker_Stats();
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << fixed << setprecision(3);
+    out << "ECS workers over " << elapsed / 1e6 << " ms:" << endl;
+    out << "  thread  chunks  entities  busy ms  util %  lock wait ms  idle ms  empty polls"
+        << endl;
+    Worker_Stats total = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < stats.size(); i++) {
+        const Worker_Stats& worker = stats[i];
+        total.chunks += worker.chunks;
+        total.entities += worker.entities;
+        total.busy_time += worker.busy_time;
+        total.idle_time += worker.idle_time;
+        total.lock_wait_time += worker.lock_wait_time;
+        total.empty_polls += worker.empty_polls;
+        out << setw(8) << (i == 0 ? "main" : to_string(i)) << setw(8) << worker.chunks
+            << setw(10) << worker.entities << setw(9) << worker.busy_time / 1e6 << setw(8)
+            << (elapsed > 0 ? worker.busy_time * 100.0 / elapsed : 0) << setw(14)
+            << worker.lock_wait_time / 1e6 << setw(9) << worker.idle_time / 1e6 << setw(13)
+            << worker.empty_polls << endl;
+    }
+    out << setw(8) << "total" << setw(8) << total.chunks << setw(10) << total.entities << setw(9)
+        << total.busy_time / 1e6 << setw(8)
+        << (elapsed > 0 ? total.busy_time * 100.0 / elapsed / stats.size() : 0) << setw(14)
+        << total.lock_wait_time / 1e6 << setw(9) << total.idle_time / 1e6 << setw(13)
+        << total.empty_polls << endl;
+    out.flags(flags);
+    out.precision(precision);
+}
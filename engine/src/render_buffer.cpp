@@ -0,0 +1,24 @@
+#include "render_buffer.h"
+
+using namespace std;
+
+Render_State& Render_Buffer::Begin_Write() {
+    Render_State& state = states[writing];
+    state.step = -1;
+    state.transforms.clear();
+    return state;
+}
+
+void Render_Buffer::Publish() {
+    writing = ready.exchange(writing | fresh_bit) & index_mask;
+}
+
+bool Render_Buffer::Read() {
+    if ((ready.load() & fresh_bit) == 0)
+        return false;
+    // The oldest state goes back to the simulation
+    int taken = ready.exchange(previous) & index_mask;
+    previous = current;
+    current = taken;
+    return true;
+}
@@ -0,0 +1,153 @@
+#include "replay.h"
+
+#include "networking/network.h"
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+
+static constexpr char replay_magic[4] = {'E', 'R', 'P', 'L'};
+static constexpr uint64_t replay_version = 1;
+
+uint64_t Hash_State(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+Replay_Writer::~Replay_Writer() {
+    if (file.is_open())
+        Close(last_step);
+}
+
+bool Replay_Writer::Open(const string& path, long seed, const vector<char>& setup) {
+    file.open(path, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        cerr << "Couldn't open the replay file " << path << "!" << endl;
+        return false;
+    }
+    write(replay_magic, sizeof(replay_magic));
+    Write_Varint(*this, replay_version);
+    Write_Signed_Varint(*this, seed);
+    Write_Varint(*this, setup.size());
+    write(setup.data(), setup.size());
+    network.on_step_rpc = [this](long step, const char* call, size_t size) {
+        Write_Rpc(step, call, size);
+    };
+    return true;
+}
+
+void Replay_Writer::Write_Record(Replay_Record record, long step) {
+    char type = record;
+    write(&type, 1);
+    Write_Signed_Varint(*this, step - last_step);
+    last_step = step;
+}
+
+void Replay_Writer::Write_Rpc(long step, const char* call, size_t size) {
+    if (size < RPC_Manager::id_size)
+        return;
+    Rpc_ID id = RPC_Manager::Read_Id(call);
+    if (id >= named_rpcs.size())
+        named_rpcs.resize(id + 1);
+    if (!named_rpcs[id]) {
+        Write_Record(Replay_Name_Record, step);
+        Write_Varint(*this, id);
+        Rpc_Codec<string>::Write(*this, network.Get_Rpc_Name(id));
+        named_rpcs[id] = true;
+    }
+    Write_Record(Replay_Rpc_Record, step);
+    Write_Varint(*this, size);
+    write(call, size);
+}
+
+void Replay_Writer::Write_Hash(long step, uint64_t hash) {
+    Write_Record(Replay_Hash_Record, step);
+    Rpc_Codec<uint64_t>::Write(*this, hash);
+}
+
+void Replay_Writer::Close(long step) {
+    Write_Record(Replay_End_Record, step);
+    file.close();
+    network.on_step_rpc = nullptr;
+}
+
+bool Replay_Reader::Open(const string& path, Network& network) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        cerr << "Couldn't open the replay file " << path << "!" << endl;
+        return false;
+    }
+    data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+
+    Rpc_Reader reader(data.data(), data.size());
+    const char* magic = reader.Read_Bytes(sizeof(replay_magic));
+    if (magic == nullptr || memcmp(magic, replay_magic, sizeof(replay_magic)) != 0 ||
+        reader.Read_Varint() != replay_version) {
+        cerr << path << " isn't a replay of this version!" << endl;
+        return false;
+    }
+    seed = reader.Read_Signed_Varint();
+    size_t setup_size = reader.Read_Varint();
+    if (const char* setup_data = reader.Read_Bytes(setup_size))
+        setup.assign(setup_data, setup_data + setup_size);
+
+    // Indexed by the id the rpc had on the machine that recorded it
+    vector<Rpc_ID> local_ids;
+    long step = 0;
+    while (!reader.failed && !reader.Done()) {
+        unsigned char record = reader.Read_Byte();
+        step += reader.Read_Signed_Varint();
+        end_step = step;
+        if (record == Replay_Name_Record) {
+            size_t id = reader.Read_Varint();
+            string name = Rpc_Codec<string>::Read(reader);
+            if (id >= RPC_Manager::no_rpc) {
+                reader.failed = true;
+                break;
+            }
+            if (id >= local_ids.size())
+                local_ids.resize(id + 1, RPC_Manager::no_rpc);
+            local_ids[id] = network.Get_Rpc_Id(name);
+        } else if (record == Replay_Rpc_Record) {
+            size_t size = reader.Read_Varint();
+            const char* call = reader.Read_Bytes(size);
+            if (call == nullptr || size < RPC_Manager::id_size) {
+                reader.failed = true;
+                break;
+            }
+            Rpc_ID id = RPC_Manager::Read_Id(call);
+            if (id >= local_ids.size() || local_ids[id] == RPC_Manager::no_rpc) {
+                cerr << "The replay calls an rpc it never named!" << endl;
+                return false;
+            }
+            // The call points into data, which isn't const
+            RPC_Manager::Write_Id(data.data() + (call - data.data()), local_ids[id]);
+            rpcs.emplace_back(step, call, size);
+        } else if (record == Replay_Hash_Record) {
+            hashes[step] = Rpc_Codec<uint64_t>::Read(reader);
+        } else if (record == Replay_End_Record) {
+            break;
+        } else {
+            reader.failed = true;
+        }
+    }
+    if (reader.failed) {
+        cerr << "The replay " << path << " is broken after step " << step << "!" << endl;
+        return false;
+    }
+    return true;
+}
+
+void Replay_Reader::Queue_Step_Rpcs(Network& network, long step) {
+    for (; next_rpc < rpcs.size() && rpcs[next_rpc].step <= step; next_rpc++)
+        network.Queue_Recorded_Rpc(rpcs[next_rpc].step, rpcs[next_rpc].call, rpcs[next_rpc].size);
+}
+
+const uint64_t* Replay_Reader::Get_Hash(long step) const {
+    auto hash = hashes.find(step);
+    return hash == hashes.end() ? nullptr : &hash->second;
+}
@@ -0,0 +1,28 @@
+#include <iostream>
+
+#include "snapshot.h"
+
+using namespace std;
+
+void Snapshot_Pointers::Register(void* pointer) {
+    if (indices.contains(pointer))
+        return;
+    indices.emplace(pointer, static_cast<uint32_t>(pointers.size()));
+    pointers.emplace_back(pointer);
+}
+
+uint32_t Snapshot_Pointers::Get_Index(const void* pointer) const {
+    if (pointer == nullptr)
+        return 0;
+    auto index = indices.find(pointer);
+    return index == indices.end() ? no_pointer : index->second;
+}
+
+void Snapshot_Writer::Write_Pointer(const void* pointer) {
+    uint32_t index = pointers.Get_Index(pointer);
+    if (index == Snapshot_Pointers::no_pointer) {
+        cerr << "Saving a pointer that isn't registered for snapshots!" << endl;
+        index = 0;
+    }
+    Write_Varint(*this, index);
+}
@@ -0,0 +1,102 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+Stat_Histogram::Stat_Histogram(size_t capacity) : samples(capacity) {
+}
+
+void Stat_Histogram::Add(float sample) {
+    samples[next] = sample;
+    next = (next + 1) % samples.size();
+    count = min(count + 1, samples.size());
+    total_count++;
+    total += sample;
+}
+
+void Stat_Histogram::Write_Json(ostream& out) const {
+    double sum = 0;
+    float max_sample = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += samples[i];
+        max_sample = max(max_sample, samples[i]);
+    }
+    // Sorted once for all of the percentiles
+    vector<float> sorted(samples.begin(), samples.begin() + count);
+    sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double fraction) {
+        return sorted.empty() ? 0 : sorted[static_cast<size_t>(fraction * (sorted.size() - 1))];
+    };
+    out << "{\"count\":" << count << ",\"avg\":" << (count == 0 ? 0 : sum / count)
+        << ",\"p50\":" << percentile(.5) << ",\"p90\":" << percentile(.9)
+        << ",\"p99\":" << percentile(.99) << ",\"max\":" << max_sample
+        << ",\"total_count\":" << total_count << ",\"total\":" << total << "}";
+}
+
+bool Stats_Reporter::Start(const string& path, chrono::milliseconds interval) {
+    if (path == "-") {
+        output = &cout;
+    } else {
+        file.open(path, ios::out | ios::trunc);
+        if (!file) {
+            cerr << "Failed to open the stats file " << path << endl;
+            return false;
+        }
+        output = &file;
+    }
+    this->interval = interval;
+    start_time = chrono::steady_clock::now();
+    next_report = start_time + interval;
+    return true;
+}
+
+void Stats_Reporter::Add_Section(const string& name, function<void(ostream& out)> write) {
+    Remove_Section(name);
+    sections.emplace_back(name, std::move(write));
+}
+
+void Stats_Reporter::Remove_Section(const string& name) {
+    erase_if(sections, [&name](const Section& section) { return section.name == name; });
+}
+
+void Stats_Reporter::Update() {
+    if (output == nullptr)
+        return;
+    auto now = chrono::steady_clock::now();
+    if (now < next_report)
+        return;
+    // Skips the reports that were missed instead of writing them all at once
+    while (interval.count() > 0 && next_report <= now)
+        next_report += interval;
+    Write_Report(*output);
+    // Flushed so that the report can be read while the server runs
+    output->flush();
+}
+
+void Stats_Reporter::Write_Report(ostream& out) const {
+    out << "{\"time_ms\":"
+        << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time)
+               .count();
+    for (const Section& section : sections) {
+        out << ",";
+        Write_Json_String(out, section.name);
+        out << ":";
+        section.write(out);
+    }
+    out << "}\n";
+}
+
+void Write_Json_String(ostream& out, const string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 15];
+        else
+            out << c;
+    }
+    out << '"';
+}
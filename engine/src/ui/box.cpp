@@ -26,6 +26,7 @@ void EUI_Box::Add_Child(EUI_Element* child) {
     if (ctx) {
         child->Set_Context(*ctx);
     }
+    child->Mark_Layout_Dirty();
 }
 
 void EUI_Box::Set_Context(EUI_Context& ctx) {
@@ -61,10 +62,11 @@ void EUI_Box::Size() {
     // # of visible, non-absolutely positioned children
     int visible_count = 0;
 
-    // Size children first (size bottom up)
+    // Size children first (size bottom up), the sizes of clean children are still valid
     for (EUI_Element* child : children) {
         if (child->is_visible) {
-            child->Size();
+            if (child->layout_dirty)
+                child->Size();
 
             // Skip absolutely positioned children
             if (child->Is_Absolute()) {
@@ -379,6 +381,8 @@ void EUI_Box::Place() {
         }
     }
 
+    layout_dirty = false;
+
     // Apply relative positioning offset after normal placement
     if (Is_Relative()) {
         pos.x += left - right;
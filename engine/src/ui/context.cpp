@@ -1,4 +1,3 @@
-#include <iostream>
 #include "ui/eui.h"
 
 /* EUI_Context Implementations */
@@ -10,6 +9,7 @@ void EUI_Context::Set_Root(EUI_Element* new_root) {
     root = new_root;
     if (root) {
         root->Set_Context(*this);
+        root->Mark_Layout_Dirty();
     }
 }
 
@@ -29,15 +29,11 @@ void EUI_Context::Begin_Frame() {
 void EUI_Context::End_Frame() {
 }
 void EUI_Context::Perform_Layout() {
-    if (root) {
-        std::cout << "\n========== LAYOUT PASS 1: SIZE (Bottom-Up) ==========" << std::endl;
-        root->Size();
-        std::cout << "\n========== LAYOUT PASS 2: GROW (Top-Down) ==========" << std::endl;
-        root->Grow();
-        std::cout << "\n========== LAYOUT PASS 3: PLACE (Top-Down) ==========" << std::endl;
-        root->Place();
-        std::cout << "\n========== LAYOUT COMPLETE ==========\n" << std::endl;
-    }
+    if (!root || !root->layout_dirty)
+        return;
+    root->Size();
+    root->Grow();
+    root->Place();
 }
 void EUI_Context::Handle_Input() {
     if (root)
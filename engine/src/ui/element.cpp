@@ -12,6 +12,13 @@ void EUI_Element::Set_Context(EUI_Context& ctx) {
     this->ctx = &ctx;
 }
 
+void EUI_Element::Mark_Layout_Dirty() {
+    // Walk up to the root even if a parent is dirty already, since hidden children aren't laid out
+    // and can stay dirty below a clean parent
+    for (EUI_Element* element = this; element != nullptr; element = element->parent)
+        element->layout_dirty = true;
+}
+
 Color EUI_Element::Get_Text_Color() const {
     RETURN_STYLE_PROP(text_color, Get_Text_Color, default_text_color);
 }
@@ -18,8 +18,7 @@ void EUI_Text::Size() {
     // std::cout << get_indent() << "[SIZE] Text '" << text << "'" << std::endl;
     layout_depth++;
 
-    Vector2 text_size =
-        MeasureTextEx(Get_Font(), text.c_str(), Get_Font_Size(), Get_Font_Spacing());
+    text_size = MeasureTextEx(Get_Font(), text.c_str(), Get_Font_Size(), Get_Font_Spacing());
 
     // min size is text and padding
     min_size = {text_size.x + padding.left + padding.right,
@@ -50,9 +49,6 @@ void EUI_Text::Place() {
     layout_depth++;
 
     // Calculate text position based on alignment within element bounds
-    Vector2 text_size =
-        MeasureTextEx(Get_Font(), text.c_str(), Get_Font_Size(), Get_Font_Spacing());
-
     // Vertical alignment
     switch (main_axis_alignment) {
         case Alignment::Center:
@@ -93,6 +89,7 @@ void EUI_Text::Place() {
         // << pos.y << ")" << std::endl;
     }
 
+    layout_dirty = false;
     layout_depth--;
     // std::cout << get_indent() << "  → text_pos=(" << text_pos.x << ", " << text_pos.y << ")"
     // << std::endl;
@@ -124,12 +121,9 @@ std::string& EUI_Text::Get_Text() {
 }
 
 void EUI_Text::Set_Text(const std::string& text) {
+    if (this->text == text)
+        return;
     this->text = text;
-
-    // recalculate size
-    if (ctx && parent) {
-        parent->Size();
-        parent->Grow();
-        parent->Place();
-    }
+    // Measured again in the next layout of the context
+    Mark_Layout_Dirty();
 }
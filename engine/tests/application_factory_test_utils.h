@@ -2,48 +2,48 @@
 
 #include <functional>
 
+#include "application.h"
 #include "application_factory.h"
-#include "application_window.h"
+#include "networking/loopback_transport.h"
 
-class TestWindow : public ApplicationWindow {
+class TestApplication : public Application {
   private:
-    function<void(std::chrono::milliseconds, ApplicationWindow&)> render_function;
+    function<void(std::chrono::milliseconds, Application&)> update_function;
+
+  protected:
+    /* Hosts over a loopback transport, so that the tests don't need to open a socket. */
+    void Start_Headless() override { Start_Server(make_unique<Loopback_Transport>(hub)); }
 
   public:
-    TestWindow(Application& application,
-               function<void(std::chrono::milliseconds, ApplicationWindow&)> render_function)
-        : ApplicationWindow(application), render_function(render_function) {}
+    shared_ptr<Loopback_Hub> hub = make_shared<Loopback_Hub>();
 
-    void Render(std::chrono::milliseconds delta_time) override {
-        render_function(delta_time, *this);
+    TestApplication(bool client,
+                    function<void(std::chrono::milliseconds, Application&)> update_function)
+        : Application("TestGame", client, 800, 450), update_function(update_function) {}
+
+    void Update(std::chrono::milliseconds delta_time) override {
+        update_function(delta_time, *this);
     }
+
+    void Update_UI(std::chrono::milliseconds) override {}
 };
 
 class TestFactory : public ApplicationFactory {
   private:
-    function<void(std::chrono::milliseconds, ApplicationWindow&)> render_function;
     function<void(std::chrono::milliseconds, Application&)> update_function;
 
   public:
-    TestFactory(function<void(std::chrono::milliseconds, ApplicationWindow&)> render_function,
-                function<void(std::chrono::milliseconds, Application&)> update_function)
-        : render_function(render_function), update_function(update_function) {}
-
-    string Get_Name() override { return "TestGame"; }
-
-    unique_ptr<ApplicationWindow> Create_Window(Application& application) override {
-        return make_unique<TestWindow>(application, render_function);
-    }
+    TestFactory(function<void(std::chrono::milliseconds, Application&)> update_function)
+        : update_function(update_function) {}
 
-    function<void(std::chrono::milliseconds, Application&)> Create_Update_Function() override {
-        return update_function;
+    unique_ptr<Application> Create_Application(bool client) override {
+        return make_unique<TestApplication>(client, update_function);
     }
 
     ~TestFactory() override = default;
 };
 
 inline unique_ptr<ApplicationFactory> CreateApplicationTestFactory(
-    function<void(std::chrono::milliseconds, ApplicationWindow&)> render_function,
     function<void(std::chrono::milliseconds, Application&)> update_function) {
-    return make_unique<TestFactory>(render_function, update_function);
+    return make_unique<TestFactory>(update_function);
 }
@@ -6,9 +6,9 @@
 
 TEST(GTest, GameSetsUp) {
     auto test_factory = CreateApplicationTestFactory(
-        [](chrono::milliseconds delta_time, ApplicationWindow& window) {},
         [](chrono::milliseconds delta_time, Application& application) {
             application.Close_Application();
         });
-    Create_Application(move(test_factory), true);
+    // The tests are linked against the headless library, which can't open a window
+    Create_Application(std::move(test_factory), false);
 }
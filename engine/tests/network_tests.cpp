@@ -1,13 +1,268 @@
 #include "gtest/gtest.h"
 
+#include <cstring>
+#include <sstream>
+#include <thread>
+
 #include "application.h"
 #include "application_factory.h"
 #include "application_factory_test_utils.h"
+#include "networking/loopback_transport.h"
+#include "networking/match_server.h"
+
+/* Updates the networks until the condition holds, gives up after a second. */
+static bool Update_Until(const vector<Network*>& networks, const function<bool()>& condition) {
+    auto give_up = chrono::steady_clock::now() + 1s;
+    while (!condition()) {
+        if (chrono::steady_clock::now() > give_up)
+            return false;
+        for (Network* network : networks)
+            network->Network_Update();
+        this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+TEST(LoopbackNetwork, ClientConnectsToServer) {
+    auto hub = make_shared<Loopback_Hub>();
+    Network server(true, [] {}, make_unique<Loopback_Transport>(hub));
+    Network client(false, [] {}, make_unique<Loopback_Transport>(hub));
+    server.Start_Network();
+    client.Start_Network();
+    ASSERT_TRUE(Update_Until({&server, &client}, [&] {
+        return client.Get_Network_State() == Network::Client_Connected &&
+               server.Get_Num_Connected_Clients() == 1;
+    }));
+}
+
+TEST(LoopbackNetwork, RpcReachesServerAndClients) {
+    auto hub = make_shared<Loopback_Hub>();
+    Loopback_Conditions conditions;
+    conditions.latency_ms = 2;
+    Network server(true, [] {}, make_unique<Loopback_Transport>(hub, conditions));
+    Network client(false, [] {}, make_unique<Loopback_Transport>(hub, conditions));
+    int server_value = 0;
+    int client_value = 0;
+    server.bind_rpc("setvalue", [&](int value) {
+        server_value = value;
+        return RPC_Manager::VALID_CALL_ON_CLIENTS;
+    });
+    auto set_value = client.bind_rpc("setvalue", [&](int value) {
+        client_value = value;
+        return RPC_Manager::VALID;
+    });
+    server.Start_Network();
+    client.Start_Network();
+    ASSERT_TRUE(Update_Until({&server, &client}, [&] {
+        return client.Get_Network_State() == Network::Client_Connected;
+    }));
+
+    client.call_rpc(set_value, 42);
+    ASSERT_TRUE(Update_Until({&server, &client}, [&] { return client_value == 42; }));
+    ASSERT_EQ(server_value, 42);
+}
+
+TEST(LoopbackNetwork, ServerRefusesSnapshotsFromClients) {
+    auto hub = make_shared<Loopback_Hub>();
+    Network server(true, [] {}, make_unique<Loopback_Transport>(hub));
+    bool received = false;
+    server.Set_Snapshot_Receiver([&](long, const char*, size_t) { received = true; });
+    server.Start_Network();
+    Loopback_Transport client(hub);
+    client.Start([](SteamNetConnectionStatusChangedCallback_t*) {});
+    HSteamNetConnection connection = client.Connect(DEFAULT_SERVER_PORT);
+    ASSERT_TRUE(Update_Until({&server}, [&] { return server.Get_Num_Connected_Clients() == 1; }));
+
+    // A whole snapshot in one chunk, which would rewind the steps of the server if it was taken
+    ostringstream chunk;
+    char record = Snapshot_Chunk_Record;
+    chunk.write(&record, 1);
+    Write_Signed_Varint(chunk, 0);
+    Write_Varint(chunk, 4);
+    Write_Varint(chunk, 0);
+    Write_Varint(chunk, 4);
+    chunk.write("snap", 4);
+    string data = chunk.str();
+    ISteamNetworkingMessage* message = client.Allocate_Message(static_cast<int>(data.size()));
+    memcpy(message->m_pData, data.data(), data.size());
+    message->m_conn = connection;
+    message->m_nFlags = k_nSteamNetworkingSend_Reliable;
+    client.Send_Messages(1, &message);
+    ASSERT_FALSE(Update_Until({&server}, [&] { return received; }));
+}
+
+/* Connects two transports directly and returns the connection of each end. */
+static pair<HSteamNetConnection, HSteamNetConnection> Connect_Transports(Transport& server,
+                                                                         Transport& client) {
+    HSteamNetConnection server_connection = k_HSteamNetConnection_Invalid;
+    server.Start([&](SteamNetConnectionStatusChangedCallback_t* status_change) {
+        if (status_change->m_info.m_eState == k_ESteamNetworkingConnectionState_Connecting) {
+            server.Accept_Connection(status_change->m_hConn);
+            server_connection = status_change->m_hConn;
+        }
+    });
+    client.Start([](SteamNetConnectionStatusChangedCallback_t*) {});
+    server.Listen(1);
+    HSteamNetConnection client_connection = client.Connect(1);
+    server.Run_Callbacks();
+    client.Run_Callbacks();
+    return {server_connection, client_connection};
+}
+
+static void Send_Number(Transport& transport, HSteamNetConnection connection, int number,
+                        int flags) {
+    ISteamNetworkingMessage* message = transport.Allocate_Message(sizeof(int));
+    memcpy(message->m_pData, &number, sizeof(int));
+    message->m_conn = connection;
+    message->m_nFlags = flags;
+    transport.Send_Messages(1, &message);
+}
+
+/* Receives until count messages arrived or the time is up. */
+static vector<int> Receive_Numbers(Transport& transport, HSteamNetConnection connection,
+                                   size_t count, chrono::milliseconds wait = 1s) {
+    vector<int> numbers;
+    auto give_up = chrono::steady_clock::now() + wait;
+    while (numbers.size() < count && chrono::steady_clock::now() < give_up) {
+        ISteamNetworkingMessage* messages[16];
+        int received = transport.Receive_Messages_On_Connection(connection, messages, 16);
+        for (int i = 0; i < received; i++) {
+            int number;
+            memcpy(&number, messages[i]->m_pData, sizeof(int));
+            numbers.emplace_back(number);
+            messages[i]->Release();
+        }
+        this_thread::sleep_for(1ms);
+    }
+    return numbers;
+}
+
+TEST(LoopbackTransport, ReliableMessagesKeepTheirOrder) {
+    auto hub = make_shared<Loopback_Hub>();
+    Loopback_Conditions conditions;
+    conditions.latency_ms = 2;
+    conditions.jitter_ms = 10;
+    conditions.loss = 0.3;
+    Loopback_Transport server(hub);
+    Loopback_Transport client(hub, conditions);
+    auto [server_connection, client_connection] = Connect_Transports(server, client);
+    ASSERT_NE(server_connection, k_HSteamNetConnection_Invalid);
+
+    for (int i = 0; i < 100; i++)
+        Send_Number(client, client_connection, i, k_nSteamNetworkingSend_Reliable);
+    vector<int> numbers = Receive_Numbers(server, server_connection, 100);
+    ASSERT_EQ(numbers.size(), 100);
+    for (int i = 0; i < 100; i++)
+        ASSERT_EQ(numbers[i], i);
+}
+
+TEST(LoopbackTransport, UnreliableMessagesCanBeLost) {
+    auto hub = make_shared<Loopback_Hub>();
+    Loopback_Conditions conditions;
+    conditions.loss = 0.5;
+    Loopback_Transport server(hub);
+    Loopback_Transport client(hub, conditions);
+    auto [server_connection, client_connection] = Connect_Transports(server, client);
+
+    for (int i = 0; i < 1000; i++)
+        Send_Number(client, client_connection, i, k_nSteamNetworkingSend_Unreliable);
+    vector<int> numbers = Receive_Numbers(server, server_connection, 1000, 50ms);
+    ASSERT_GT(numbers.size(), 300);
+    ASSERT_LT(numbers.size(), 700);
+}
+
+TEST(LoopbackTransport, MessagesArriveAfterTheLatency) {
+    auto hub = make_shared<Loopback_Hub>();
+    Loopback_Conditions conditions;
+    conditions.latency_ms = 50;
+    Loopback_Transport server(hub);
+    Loopback_Transport client(hub, conditions);
+    auto [server_connection, client_connection] = Connect_Transports(server, client);
+
+    auto sent = chrono::steady_clock::now();
+    Send_Number(client, client_connection, 1, k_nSteamNetworkingSend_Reliable);
+    ASSERT_EQ(Receive_Numbers(server, server_connection, 1).size(), 1);
+    ASSERT_GE(chrono::steady_clock::now() - sent, 50ms);
+}
+
+/* Like Update_Until, but also updates the match server the networks of the matches run on. */
+static bool Update_Matches_Until(Match_Server& match_server, const vector<Network*>& networks,
+                                 const function<bool()>& condition) {
+    return Update_Until(networks, [&] {
+        match_server.Update();
+        return condition();
+    });
+}
+
+TEST(MatchServer, RpcsStayInTheirMatch) {
+    auto hub = make_shared<Loopback_Hub>();
+    Match_Server match_server(make_unique<Loopback_Transport>(hub));
+    ASSERT_TRUE(match_server.Start(DEFAULT_SERVER_PORT));
+    Network match_1(true, [] {}, match_server.Create_Match_Transport(1));
+    Network match_2(true, [] {}, match_server.Create_Match_Transport(2));
+    Network client_1(false, [] {},
+                     make_unique<Match_Join_Transport>(1, make_unique<Loopback_Transport>(hub)));
+    Network other_client_1(
+        false, [] {}, make_unique<Match_Join_Transport>(1, make_unique<Loopback_Transport>(hub)));
+    Network client_2(false, [] {},
+                     make_unique<Match_Join_Transport>(2, make_unique<Loopback_Transport>(hub)));
+    vector<Network*> networks = {&match_1, &match_2, &client_1, &other_client_1, &client_2};
+    vector<int> values(networks.size());
+    vector<Rpc<int>> set_value_rpcs;
+    for (size_t i = 0; i < networks.size(); i++) {
+        set_value_rpcs.emplace_back(networks[i]->bind_rpc("setvalue", [&values, i](int value) {
+            values[i] = value;
+            return RPC_Manager::VALID_CALL_ON_CLIENTS;
+        }));
+    }
+    for (Network* network : networks)
+        network->Start_Network();
+    ASSERT_TRUE(Update_Matches_Until(match_server, networks, [&] {
+        return match_1.Get_Num_Connected_Clients() == 2 && match_2.Get_Num_Connected_Clients() == 1;
+    }));
+
+    client_1.call_rpc(set_value_rpcs[2], 1);
+    client_2.call_rpc(set_value_rpcs[4], 2);
+    ASSERT_TRUE(Update_Matches_Until(match_server, networks, [&] {
+        return values[2] == 1 && values[3] == 1 && values[4] == 2;
+    }));
+    ASSERT_EQ(values[0], 1);
+    ASSERT_EQ(values[1], 2);
+}
+
+TEST(MatchServer, UnknownMatchesAreCreatedOrRejected) {
+    auto hub = make_shared<Loopback_Hub>();
+    Match_Server match_server(make_unique<Loopback_Transport>(hub));
+    ASSERT_TRUE(match_server.Start(DEFAULT_SERVER_PORT));
+    unique_ptr<Network> match;
+    match_server.on_unknown_match = [&](Match_ID match_id) {
+        if (match_id != 7)
+            return;
+        match = make_unique<Network>(true, [] {}, match_server.Create_Match_Transport(match_id));
+        match->Start_Network();
+    };
+    bool rejected_client_closed = false;
+    Network client(false, [] {},
+                   make_unique<Match_Join_Transport>(7, make_unique<Loopback_Transport>(hub)));
+    Network rejected_client(
+        false, [&] { rejected_client_closed = true; },
+        make_unique<Match_Join_Transport>(8, make_unique<Loopback_Transport>(hub)));
+    client.Start_Network();
+    rejected_client.Start_Network();
+    ASSERT_TRUE(Update_Matches_Until(match_server, {&client, &rejected_client}, [&] {
+        if (match != nullptr)
+            match->Network_Update();
+        return match != nullptr && match->Get_Num_Connected_Clients() == 1 &&
+               rejected_client_closed;
+    }));
+    ASSERT_TRUE(match_server.Has_Match(7));
+    ASSERT_FALSE(match_server.Has_Match(8));
+}
 
 /**
  * Due to the way GameNetworkingSockets works it isn't easy to run two applications at the same
- * time. I'll try and figure out a better way to test connection in the future. For now, I will
- * leave the code here before I realised that the tests don't work.
+ * time, so the tests above run over the Loopback_Transport instead. The old application tests are
+ * left here until the applications can be given a transport by the test factory.
  */
 
 // TEST(GTest, ServerSetsUp) {
@@ -0,0 +1,188 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "networking/compression.h"
+#include "networking/network.h"
+
+using namespace std;
+
+/**
+ * Benchmark of the network message compression.
+ * Builds the messages the server sends to a client during a match, the lobby burst when the game
+ * starts and one step frame per step, and compresses every message that reaches the threshold the
+ * way Network::Close_Batch does. Reports the achieved ratio and the time spent for each threshold
+ * so that the default threshold can be picked from real message sizes.
+ *
+ * Usage: compression_benchmark [--players N] [--steps N] [--cards N] [--seed N]
+ */
+
+struct Benchmark_Config {
+    int players = 8;
+    int steps = 2000;
+    // Cards played per step over all players
+    int cards = 2;
+    long seed = 10;
+};
+
+struct Record_Buffer {
+    vector<char> data;
+    void write(const char* bytes, size_t size) { data.insert(data.end(), bytes, bytes + size); }
+};
+
+static bool Parse_Args(int argc, char** argv, Benchmark_Config& config) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        long value = strtol(argv[++i], nullptr, 10);
+        if (arg == "--players")
+            config.players = static_cast<int>(value);
+        else if (arg == "--steps")
+            config.steps = static_cast<int>(value);
+        else if (arg == "--cards")
+            config.cards = static_cast<int>(value);
+        else if (arg == "--seed")
+            config.seed = value;
+        else {
+            cerr << "Unknown argument " << arg << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Write_Announcement(Record_Buffer& buffer, RPC_Manager& rpc_manager, Rpc_ID id) {
+    char record = Announcement_Record;
+    buffer.write(&record, 1);
+    Write_Varint(buffer, id);
+    Rpc_Codec<string>::Write(buffer, rpc_manager.Get_Name(id));
+}
+
+template <typename... Args>
+static void Write_Rpc(Record_Buffer& buffer, long& rpc_id, const Rpc<Args...>& rpc,
+                      const Args&... args) {
+    Rpc_Message::Write_Header(buffer, rpc_id++, true, -2, RPC_Manager::Get_Call_Size(rpc, args...));
+    RPC_Manager::Pack_Call(buffer, rpc, args...);
+}
+
+/* The messages a client receives, in the order they are sent. */
+static vector<vector<char>> Build_Messages(const Benchmark_Config& config) {
+    RPC_Manager rpc_manager;
+    auto set_player_count = rpc_manager.Get_Rpc<int>("setplayercount");
+    auto add_player = rpc_manager.Get_Rpc<Client_ID, long>("addplayer");
+    auto set_player_team = rpc_manager.Get_Rpc<long, int>("setplayerteam");
+    auto start_game = rpc_manager.Get_Rpc<long>("startgame");
+    auto play_card = rpc_manager.Get_Rpc<long, long, float, float>("playcard");
+    auto step_update = rpc_manager.Get_Rpc<long>("stepupdate");
+    srand(static_cast<unsigned>(config.seed));
+
+    vector<vector<char>> messages;
+    long rpc_id = 0;
+    Record_Buffer lobby;
+    for (Rpc_ID id = 0; id < 4; id++)
+        Write_Announcement(lobby, rpc_manager, id);
+    for (int i = 0; i < config.players; i++) {
+        Write_Rpc(lobby, rpc_id, set_player_count, i + 1);
+        Write_Rpc(lobby, rpc_id, add_player, static_cast<Client_ID>(rand()), static_cast<long>(i));
+    }
+    for (int i = 0; i < config.players; i++)
+        Write_Rpc(lobby, rpc_id, set_player_team, static_cast<long>(i), i % 2);
+    Write_Rpc(lobby, rpc_id, start_game, 1700000000000L + rand());
+    messages.emplace_back(std::move(lobby.data));
+
+    for (long step = 0; step < config.steps; step++) {
+        Record_Buffer frame;
+        if (step == 0) {
+            Write_Announcement(frame, rpc_manager, play_card.id);
+            Write_Announcement(frame, rpc_manager, step_update.id);
+        }
+        Record_Buffer calls;
+        for (int i = 0; i < config.cards; i++) {
+            auto player = static_cast<long>(rand() % config.players);
+            auto card = static_cast<long>(rand() % 1000);
+            float x = static_cast<float>(rand() % 1920) + .5f;
+            float y = static_cast<float>(rand() % 1080) + .5f;
+            Write_Varint(calls, RPC_Manager::Get_Call_Size(play_card, player, card, x, y));
+            RPC_Manager::Pack_Call(calls, play_card, player, card, x, y);
+        }
+        char record = Step_Frame_Record;
+        frame.write(&record, 1);
+        Write_Varint(frame, rpc_id);
+        Write_Signed_Varint(frame, step);
+        Write_Varint(frame, config.cards);
+        frame.write(calls.data.data(), calls.data.size());
+        rpc_id += config.cards;
+        Write_Rpc(frame, rpc_id, step_update, step + 1);
+        messages.emplace_back(std::move(frame.data));
+    }
+    return messages;
+}
+
+int main(int argc, char** argv) {
+    Benchmark_Config config;
+    if (!Parse_Args(argc, argv, config)) {
+        cerr << "Usage: compression_benchmark [--players N] [--steps N] [--cards N] [--seed N]"
+             << endl;
+        return 1;
+    }
+
+    vector<vector<char>> messages = Build_Messages(config);
+    long total_size = 0;
+    for (const auto& message : messages)
+        total_size += static_cast<long>(message.size());
+    cout << "Messages: " << messages.size() << ", " << total_size << " bytes, the lobby burst is "
+         << messages.front().size() << " bytes" << endl;
+
+    cout << setw(10) << "Threshold" << setw(12) << "Compressed" << setw(12) << "Bytes" << setw(10)
+         << "Ratio" << setw(16) << "Compress us" << setw(18) << "Decompress us" << endl;
+    vector<char> compressed;
+    vector<char> decompressed;
+    for (size_t threshold : {16, 64, 128, 256, 512, 1024, 4096}) {
+        long compressed_count = 0;
+        long sent_size = 0;
+        long compress_time = 0;
+        long decompress_time = 0;
+        for (const auto& message : messages) {
+            if (message.size() < threshold) {
+                sent_size += static_cast<long>(message.size());
+                continue;
+            }
+            compressed.clear();
+            auto start = chrono::steady_clock::now();
+            size_t size = Compress_Block(message.data(), message.size(), compressed);
+            auto middle = chrono::steady_clock::now();
+            compress_time += chrono::duration_cast<chrono::nanoseconds>(middle - start).count();
+            // The record type and the original size go in front of the block
+            size += 4;
+            if (size >= message.size()) {
+                sent_size += static_cast<long>(message.size());
+                continue;
+            }
+            decompressed.resize(message.size());
+            middle = chrono::steady_clock::now();
+            if (!Decompress_Block(compressed.data(), compressed.size(), decompressed.data(),
+                                  decompressed.size()) ||
+                decompressed != message) {
+                cerr << "A message didn't decompress back to the original!" << endl;
+                return 1;
+            }
+            decompress_time += chrono::duration_cast<chrono::nanoseconds>(
+                                   chrono::steady_clock::now() - middle)
+                                   .count();
+            compressed_count++;
+            sent_size += static_cast<long>(size);
+        }
+        cout << setw(10) << threshold << setw(12) << compressed_count << setw(12) << sent_size
+             << setw(10) << fixed << setprecision(3)
+             << static_cast<double>(sent_size) / static_cast<double>(total_size) << setw(16)
+             << setprecision(1) << compress_time / 1000.0 << setw(18) << decompress_time / 1000.0
+             << endl;
+    }
+    return 0;
+}
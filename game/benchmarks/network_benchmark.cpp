@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application.h"
+#include "game_manager.h"
+#include "networking/loopback_transport.h"
+#include "player.h"
+
+/**
+ * Benchmark of the lockstep over the network.
+ * Runs a server and a number of clients in one process, connected through the Loopback_Transport
+ * with the given network conditions. Every machine runs a Game_Manager without any objects, so the
+ * steps only cost the step updates and the step reports. The clients also ping the server with an
+ * rpc that the server relays back to every client.
+ * Reports how fast the clients step, how far ahead the server runs with its adaptive step window
+ * and the round trip time of the pings. Clients that fall behind catch up like the game does.
+ * The frames run back to back unless --frame-rate is given. Waiting clients report their step every
+ * frame, so a limited bandwidth should come with a limited frame rate.
+ *
+ * Usage: network_benchmark [--clients N] [--steps N] [--frame-rate N] [--ping-interval MS]
+ *                          [--latency MS] [--jitter MS] [--loss FRACTION]
+ *                          [--bandwidth BYTES_PER_S] [--seed N]
+ */
+
+// How far the server can be ahead of the slowest client before the measurement starts
+static constexpr long caught_up_lead = 20;
+
+struct Benchmark_Config {
+    int clients = 4;
+    int steps = 2000;
+    // Milliseconds between the pings of a client
+    int ping_interval = 10;
+    // Frames per second of every machine, 0 runs the frames back to back
+    int frame_rate = 0;
+    Loopback_Conditions conditions;
+};
+
+class Benchmark_Application : public Application {
+  public:
+    Benchmark_Application() : Application("Network Benchmark", false, 0, 0) {}
+
+    void Update(chrono::milliseconds) override {}
+    void Update_UI(chrono::milliseconds) override {}
+};
+
+struct Machine {
+    Benchmark_Application application;
+    unique_ptr<Game_Manager> game_manager;
+    Rpc<int, long> ping_rpc;
+};
+
+static bool Parse_Args(int argc, char** argv, Benchmark_Config& config) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        double value = strtod(argv[++i], nullptr);
+        if (arg == "--clients")
+            config.clients = static_cast<int>(value);
+        else if (arg == "--steps")
+            config.steps = static_cast<int>(value);
+        else if (arg == "--frame-rate")
+            config.frame_rate = static_cast<int>(value);
+        else if (arg == "--ping-interval")
+            config.ping_interval = static_cast<int>(value);
+        else if (arg == "--latency")
+            config.conditions.latency_ms = value;
+        else if (arg == "--jitter")
+            config.conditions.jitter_ms = value;
+        else if (arg == "--loss")
+            config.conditions.loss = value;
+        else if (arg == "--bandwidth")
+            config.conditions.bandwidth = value;
+        else if (arg == "--seed")
+            config.conditions.seed = static_cast<unsigned int>(value);
+        else {
+            cerr << "Unknown argument " << arg << endl;
+            return false;
+        }
+    }
+    return config.clients > 0 && config.conditions.loss >= 0 && config.conditions.loss < 1;
+}
+
+static long Now_Us() {
+    return chrono::duration_cast<chrono::microseconds>(
+               chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void Update_Network(Machine& machine) {
+    machine.application.Get_Network()->Network_Update();
+}
+
+static double Percentile(const vector<long>& sorted, double fraction) {
+    if (sorted.empty())
+        return 0;
+    return sorted[static_cast<size_t>(fraction * (sorted.size() - 1))] / 1000.0;
+}
+
+int main(int argc, char** argv) {
+    Benchmark_Config config;
+    if (!Parse_Args(argc, argv, config)) {
+        cerr << "Usage: network_benchmark [--clients N] [--steps N] [--frame-rate N] "
+                "[--ping-interval MS] [--latency MS] [--jitter MS] [--loss FRACTION] "
+                "[--bandwidth BYTES_PER_S] [--seed N]"
+             << endl;
+        return 1;
+    }
+
+    auto hub = make_shared<Loopback_Hub>();
+    Machine server;
+    vector<unique_ptr<Machine>> clients;
+    server.application.Start_Server(make_unique<Loopback_Transport>(hub, config.conditions));
+    server.application.Get_Network()->Start_Network();
+    for (int i = 0; i < config.clients; i++) {
+        Loopback_Conditions conditions = config.conditions;
+        conditions.seed += i + 1;
+        clients.emplace_back(make_unique<Machine>());
+        clients.back()->application.Connect_To_Server(
+            make_unique<Loopback_Transport>(hub, conditions));
+        clients.back()->application.Get_Network()->Start_Network();
+    }
+
+    auto all_connected = [&] {
+        for (auto& client : clients) {
+            if (client->application.Get_Network()->Get_Network_State() !=
+                Network::Client_Connected)
+                return false;
+        }
+        return server.application.Get_Network()->Get_Num_Connected_Clients() == config.clients;
+    };
+    while (!all_connected()) {
+        Update_Network(server);
+        for (auto& client : clients)
+            Update_Network(*client);
+    }
+
+    vector<Player*> players;
+    for (int i = 0; i < config.clients; i++)
+        players.emplace_back(new Player(0, i));
+    server.game_manager = make_unique<Game_Manager>(
+        server.application, *server.application.Get_Network(), players, nullptr, 0);
+    server.ping_rpc = server.application.Get_Network()->bind_rpc(
+        "ping", [](int, long) { return RPC_Manager::VALID_CALL_ON_CLIENTS; });
+    vector<long> round_trips;
+    for (int i = 0; i < config.clients; i++) {
+        Machine& client = *clients[i];
+        client.game_manager = make_unique<Game_Manager>(
+            client.application, *client.application.Get_Network(), players, players[i], 0);
+        client.ping_rpc = client.application.Get_Network()->bind_rpc(
+            "ping", [i, &round_trips](int sender, long sent_us) {
+                if (sender == i)
+                    round_trips.emplace_back(Now_Us() - sent_us);
+                return RPC_Manager::VALID;
+            });
+    }
+
+    auto min_client_step = [&] {
+        long step = clients[0]->game_manager->Get_Current_Step();
+        for (auto& client : clients)
+            step = min(step, client->game_manager->Get_Current_Step());
+        return step;
+    };
+    auto server_lead = [&] { return server.game_manager->Get_Current_Step() - min_client_step(); };
+    long frames = 0;
+    long next_ping = 0;
+    auto run_frame = [&] {
+        auto frame_start = chrono::steady_clock::now();
+        bool ping_due = Now_Us() >= next_ping;
+        if (ping_due)
+            next_ping = Now_Us() + config.ping_interval * 1000L;
+        Update_Network(server);
+        server.game_manager->Update();
+        server.application.Get_Network()->Flush_Messages();
+        for (int i = 0; i < config.clients; i++) {
+            Machine& client = *clients[i];
+            Update_Network(client);
+            int steps = max(client.game_manager->Get_Steps_To_Simulate(), 1);
+            for (int s = 0; s < steps; s++)
+                client.game_manager->Update();
+            if (ping_due)
+                client.application.Get_Network()->call_rpc(client.ping_rpc, i, Now_Us());
+            client.application.Get_Network()->Flush_Messages();
+        }
+        frames++;
+        if (config.frame_rate > 0)
+            this_thread::sleep_until(frame_start + 1000000us / config.frame_rate);
+    };
+
+    // The server runs ahead until the first step reports arrive, measure once the clients caught up
+    while (min_client_step() == 0 || server_lead() > caught_up_lead)
+        run_frame();
+    round_trips.clear();
+    frames = 0;
+    long start_step = min_client_step();
+    long step_lag = 0;
+    long step_window = 0;
+    auto start_time = chrono::steady_clock::now();
+    while (min_client_step() < start_step + config.steps) {
+        run_frame();
+        step_lag += server_lead();
+        step_window += server.game_manager->Get_Step_Window();
+    }
+    auto total_time =
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_time)
+            .count();
+
+    sort(round_trips.begin(), round_trips.end());
+    double average_round_trip = 0;
+    for (long round_trip : round_trips)
+        average_round_trip += round_trip / 1000.0;
+    if (!round_trips.empty())
+        average_round_trip /= round_trips.size();
+
+    const Loopback_Conditions& conditions = config.conditions;
+    cout << fixed << setprecision(3);
+    cout << "Clients: " << config.clients << " steps: " << config.steps
+         << " latency: " << conditions.latency_ms << " ms jitter: " << conditions.jitter_ms
+         << " ms loss: " << conditions.loss << " bandwidth: " << conditions.bandwidth << " B/s"
+         << endl;
+    cout << "Total time: " << total_time / 1e6 << " ms, " << config.steps / (total_time / 1e9)
+         << " steps/s, " << frames << " frames" << endl;
+    cout << "Server ahead of the slowest client: " << static_cast<double>(step_lag) / frames
+         << " steps on average, step window " << static_cast<double>(step_window) / frames
+         << " steps on average" << endl;
+    cout << "Ping round trip over " << round_trips.size() << " pings: average "
+         << average_round_trip << " ms, p50 " << Percentile(round_trips, .5) << " ms, p99 "
+         << Percentile(round_trips, .99) << " ms, max " << Percentile(round_trips, 1) << " ms"
+         << endl;
+
+    for (auto& client : clients)
+        client->game_manager.reset();
+    server.game_manager.reset();
+    for (Player* player : players)
+        delete player;
+    return 0;
+}
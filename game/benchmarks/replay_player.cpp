@@ -0,0 +1,129 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "application.h"
+#include "card_player.h"
+#include "game_world.h"
+#include "replay.h"
+
+/**
+ * Simulates a recorded match again as fast as possible without rendering, see replay.h.
+ * Matches are recorded by the dedicated server with --record. The world is built from the seed
+ * and the players of the replay, then every step gets the rpcs it ran in the match.
+ * Reports the step throughput, and unless --no-verify is given compares the state hashes of the
+ * replay and stops at the first step that differs. Exits with 1 if the playback desynced.
+ *
+ * Usage: replay_player FILE [--workers N] [--no-verify]
+ */
+
+struct Player_Config {
+    string replay_path;
+    int workers = 4;
+    bool verify = true;
+};
+
+class Replay_Application : public Application {
+  public:
+    Replay_Application() : Application("Replay Player", false, 0, 0) {}
+
+    void Update(chrono::milliseconds) override {}
+    void Update_UI(chrono::milliseconds) override {}
+
+    void Set_In_Update(bool value) { in_update = value; }
+};
+
+static bool Parse_Args(int argc, char** argv, Player_Config& config) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--no-verify") {
+            config.verify = false;
+            continue;
+        }
+        if (arg == "--workers" && i + 1 < argc) {
+            config.workers = static_cast<int>(strtol(argv[++i], nullptr, 10));
+            continue;
+        }
+        if (arg.starts_with("--") || !config.replay_path.empty()) {
+            cerr << "Unknown argument " << arg << endl;
+            return false;
+        }
+        config.replay_path = arg;
+    }
+    return !config.replay_path.empty() && config.workers >= 0;
+}
+
+int main(int argc, char** argv) {
+    Player_Config config;
+    if (!Parse_Args(argc, argv, config)) {
+        cerr << "Usage: replay_player FILE [--workers N] [--no-verify]" << endl;
+        return 1;
+    }
+
+    Replay_Application application;
+    // The network is never started, the recorded rpcs are invoked locally as if we were a server
+    // without any clients
+    application.Start_Server();
+    Network& network = *application.Get_Network();
+    Replay_Reader replay;
+    vector<Player*> players;
+    int num_paths = 0;
+    if (!replay.Open(config.replay_path, network) ||
+        !Game_World::Load_Replay_Setup(replay.setup, players, num_paths))
+        return 1;
+
+    Texture2D unit_texture = {};
+    Texture2D tower_texture = {};
+    Texture2D card_texture = {};
+    auto world = make_unique<Game_World>(application, network, nullptr, &unit_texture,
+                                         &tower_texture, &card_texture);
+    world->Setup_World(players, nullptr, replay.seed, num_paths, config.workers);
+    long hashes_checked = 0;
+    long desync_step = -1;
+    if (config.verify) {
+        world->on_ecs_updated = [&] {
+            long step = world->game_manager->Get_Current_Step();
+            const uint64_t* hash = replay.Get_Hash(step);
+            if (hash == nullptr || desync_step != -1)
+                return;
+            hashes_checked++;
+            if (*hash != world->Hash_State())
+                desync_step = step;
+        };
+    }
+
+    application.Set_In_Update(true);
+    auto start_time = chrono::steady_clock::now();
+    while (world->game_manager->Get_Current_Step() < replay.end_step && desync_step == -1) {
+        replay.Queue_Step_Rpcs(network, world->game_manager->Get_Current_Step());
+        world->Update();
+    }
+    auto total_time =
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_time)
+            .count();
+    application.Set_In_Update(false);
+
+    long steps = world->game_manager->Get_Current_Step();
+    cout << fixed << setprecision(3);
+    cout << "Replay: " << config.replay_path << " seed: " << replay.seed
+         << " players: " << players.size() << " paths: " << num_paths
+         << " rpcs: " << replay.Get_Rpc_Count() << endl;
+    cout << "Steps: " << steps << " of " << replay.end_step << " in " << total_time / 1e6
+         << " ms, " << steps / (total_time / 1e9) << " steps/s" << endl;
+    if (desync_step != -1) {
+        cout << "Desynced at step " << desync_step << " after " << hashes_checked - 1
+             << " matching hashes" << endl;
+    } else if (config.verify) {
+        cout << "Hashes: " << hashes_checked << " of " << replay.Get_Hash_Count() << " matched"
+             << endl;
+    }
+    // The world calls rpcs on the network and points to the players, so it goes first
+    world.reset();
+    for (Player* player : players)
+        delete player;
+    application.Close_Network();
+    return desync_step == -1 ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "application.h"
+#include "card_player.h"
+#include "game_world.h"
+#include "projectile.h"
+#include "tower.h"
+#include "tower_card.h"
+#include "unit.h"
+
+/**
+ * Headless benchmark of the game simulation.
+ * Builds the same world as the Game_Scene with two AI players, keeps a configurable number of
+ * units and towers alive and reports the step throughput, the time spent in each system and the
+ * number of heap allocations.
+ * The timings come from the ECS_Profiler, --trace also writes the measured steps as a Chrome trace.
+ *
+ * Usage: simulation_benchmark [--steps N] [--warmup N] [--units N] [--towers N] [--paths N]
+ *                             [--seed N] [--workers N] [--trace FILE]
+ */
+
+// Every heap allocation in the process goes through here so we can count them per step
+static std::atomic<long> allocation_count = 0;
+static std::atomic<long> allocation_bytes = 0;
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(static_cast<long>(size), std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+struct Benchmark_Config {
+    int steps = 1000;
+    int warmup = 100;
+    int units = 200;
+    int towers = 20;
+    int paths = 3;
+    long seed = 10;
+    int workers = 30;
+    string trace_path;
+};
+
+class Benchmark_Application : public Application {
+  public:
+    Benchmark_Application() : Application("Simulation Benchmark", false, 0, 0) {}
+
+    void Update(chrono::milliseconds) override {}
+    void Update_UI(chrono::milliseconds) override {}
+
+    void Set_In_Update(bool value) { in_update = value; }
+};
+
+static bool Parse_Args(int argc, char** argv, Benchmark_Config& config) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        if (arg == "--trace") {
+            config.trace_path = argv[++i];
+            continue;
+        }
+        long value = strtol(argv[++i], nullptr, 10);
+        if (arg == "--steps")
+            config.steps = static_cast<int>(value);
+        else if (arg == "--warmup")
+            config.warmup = static_cast<int>(value);
+        else if (arg == "--units")
+            config.units = static_cast<int>(value);
+        else if (arg == "--towers")
+            config.towers = static_cast<int>(value);
+        else if (arg == "--paths")
+            config.paths = static_cast<int>(value);
+        else if (arg == "--seed")
+            config.seed = value;
+        else if (arg == "--workers")
+            config.workers = static_cast<int>(value);
+        else {
+            cerr << "Unknown argument " << arg << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static int Count_Entities(ECS* ecs, Entity_Type* entity_type) {
+    int count = 0;
+    for (auto entity_array : ecs->entity_arrays) {
+        if (entity_array->entity_type.Is_Entity_Of_Type(entity_type))
+            count += entity_array->Count();
+    }
+    return count;
+}
+
+/**
+ * Tops the units up to the target count so the hot systems see a steady load.
+ * New units are spread over both teams and all of their paths.
+ */
+static void Spawn_Units(Game_World& world, vector<Card_Player*>& players, int target) {
+    int to_spawn = target - Count_Entities(world.ecs, Get_Unit_Entity_Type());
+    for (int i = 0; i < to_spawn; i++) {
+        Card_Player* player = players[i % players.size()];
+        auto paths = world.Get_Team_Paths(player->team);
+        Path* path = paths[(i / players.size()) % paths.size()];
+        Init_Unit(world.ecs, world.ecs->Create_Entity(Get_Unit_Entity_Type(), 0),
+                  player->base_id, path, 1.3f, 3, 2, static_cast<float>(i / players.size()) * 10,
+                  player->team, world.unit_texture, .4f, WHITE);
+    }
+}
+
+static void Spawn_Towers(Game_World& world, vector<Card_Player*>& players, int count) {
+    Tower_Card_Component tower_card = {world.tower_texture, 0, true, 30, 2, 120,
+                                       5,                   world.unit_texture};
+    for (int i = 0; i < count; i++) {
+        Card_Player* player = players[i % players.size()];
+        auto paths = world.Get_Team_Paths(player->team);
+        int placement = static_cast<int>(i / players.size());
+        Path* path = paths[placement % paths.size()];
+        Vector2 pos = path->positions[5 + placement % (path->positions.size() - 10)];
+        float offset = (placement % 2 == 0 ? 1 : -1) * (60 + 40 * (placement / 2 % 3));
+        Init_Tower(world.ecs->Create_Entity(Get_Tower_Entity_Type(), 0),
+                   Vector2(pos.x + offset, pos.y), player->team, tower_card, world.tower_texture,
+                   .4f, WHITE);
+    }
+}
+
+int main(int argc, char** argv) {
+    Benchmark_Config config;
+    if (!Parse_Args(argc, argv, config)) {
+        cerr << "Usage: simulation_benchmark [--steps N] [--warmup N] [--units N] [--towers N] "
+                "[--paths N] [--seed N] [--workers N] [--trace FILE]"
+             << endl;
+        return 1;
+    }
+
+    Benchmark_Application application;
+    // The network is never started, rpcs are invoked locally as if we were a server
+    // without any clients
+    application.Start_Server();
+    Texture2D unit_texture = {};
+    Texture2D tower_texture = {};
+    Texture2D card_texture = {};
+    auto world = make_unique<Game_World>(application, *application.Get_Network(), nullptr,
+                                         &unit_texture, &tower_texture, &card_texture);
+    auto* player0 = new Card_Player(0, 0);
+    auto* player1 = new Card_Player(1, 1);
+    vector<Card_Player*> players = {player0, player1};
+    world->Setup_World({player0, player1}, player0, config.seed, config.paths, config.workers);
+    Spawn_Towers(*world, players, config.towers);
+    ECS_Profiler& profiler = world->ecs->profiler;
+
+    application.Set_In_Update(true);
+    for (int i = 0; i < config.warmup; i++) {
+        Spawn_Units(*world, players, config.units);
+        world->Update();
+    }
+    // Keep every measured step so the averages cover all of them
+    profiler.Set_History_Size(config.steps);
+    profiler.Set_Enabled(true);
+    if (!config.trace_path.empty())
+        profiler.Start_Trace(config.steps, config.trace_path);
+
+    long ecs_time = 0;
+    long game_manager_time = 0;
+    long starting_allocations = allocation_count;
+    long starting_allocation_bytes = allocation_bytes;
+    auto start_time = chrono::steady_clock::now();
+    for (int i = 0; i < config.steps; i++) {
+        Spawn_Units(*world, players, config.units);
+        auto step_start = chrono::steady_clock::now();
+        world->ecs->Update();
+        auto ecs_end = chrono::steady_clock::now();
+        world->game_manager->Update();
+        auto step_end = chrono::steady_clock::now();
+        ecs_time += chrono::duration_cast<chrono::nanoseconds>(ecs_end - step_start).count();
+        game_manager_time +=
+            chrono::duration_cast<chrono::nanoseconds>(step_end - ecs_end).count();
+    }
+    auto total_time =
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_time)
+            .count();
+    long allocations = allocation_count - starting_allocations;
+    long allocated_bytes = allocation_bytes - starting_allocation_bytes;
+    application.Set_In_Update(false);
+    profiler.Set_Enabled(false);
+
+    double steps = config.steps;
+    cout << fixed << setprecision(3);
+    cout << "Steps: " << config.steps << " (warmup " << config.warmup << ") units: " << config.units
+         << " towers: " << config.towers << " paths: " << config.paths << " seed: " << config.seed
+         << " workers: " << config.workers << endl;
+    cout << "Total time: " << total_time / 1e6 << " ms, " << steps / (total_time / 1e9)
+         << " steps/s" << endl;
+    cout << "ECS::Update: " << ecs_time / 1e6 / steps << " ms/step" << endl;
+    cout << "Game_Manager::Update: " << game_manager_time / 1e6 / steps << " ms/step" << endl;
+    profiler.Print_Summary(cout);
+    profiler.Print_Worker_Stats(cout);
+    cout << "Allocations: " << allocations / steps << " per step, " << allocated_bytes / steps
+         << " bytes per step" << endl;
+    cout << "Entities: units " << Count_Entities(world->ecs, Get_Unit_Entity_Type()) << ", towers "
+         << Count_Entities(world->ecs, Get_Tower_Entity_Type()) << ", projectiles "
+         << Count_Entities(world->ecs, Get_Projectile_Entity_Type()) << endl;
+    cout << "Money: team 0 " << player0->money << ", team 1 " << player1->money << endl;
+    // The world calls rpcs on the network and points to the players, so it goes first
+    world.reset();
+    for (Card_Player* player : players)
+        delete player;
+    application.Close_Network();
+    return 0;
+}
@@ -8,15 +8,16 @@ class Card_Player;
 struct Base_Component {
     static Component_Type component_type;
     Game_Scene* game_scene;
-    vector<Card_Player*> players;
+    Entity_List<Card_Player*, 4> players;
     Entity_ID other_base_id;
     int team;
-    std::vector<vector<Entity_ID>*> units_on_path;
+    // The units of this base on each of its paths
+    Entity_List<Entity_List<Entity_ID, 32>, 4> units_on_path;
     int base_income_speed;
     int time_until_income;
     int health;
     int max_health;
-    vector<Path*> paths;
+    Entity_List<Path*, 4> paths;
 };
 
 void Init_Base(Entity entity, Game_Scene* game_scene, vector<Card_Player*> players,
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <chrono>
+#include <optional>
 #include <raylib.h>
 
 #include "application.h"
+#include "networking/match_server.h"
 #include "scene.h"
 #include "ui/eui.h"
 
@@ -46,4 +48,6 @@ class Card_Game : public Application {
 
     Scene* scene;
     std::unordered_map<SCREEN, std::function<Scene*()>> scenes;
+    // Set to join this match on a dedicated server instead of a game hosted by a client
+    std::optional<Match_ID> server_match;
 };
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "dedicated_server.h"
+#include "game_world.h"
+#include "replay.h"
+
+/**
+ * A match of the game on the dedicated server.
+ * Takes the place of the Lobby_Scene of a hosting client: every client that joins gets a player,
+ * and once the match has players_per_match players the teams are picked and the game starts.
+ * The clients only receive the lobby rpcs, so they can't change the players or start the game.
+ * Clients that join after the start get a snapshot from the Game_World.
+ * If the match has a replay path, the match is recorded there from the start of the game.
+ */
+class Card_Match : public Match, Network_Events_Receiver {
+    Dedicated_Server& server;
+    const int players_per_match;
+    int connected_clients = 0;
+    Player_ID next_player_id = 0;
+    vector<Player*> players;
+    // Nothing is drawn, the textures only keep the pointers of the components the same
+    Texture2D unit_texture = {};
+    Texture2D tower_texture = {};
+    Texture2D card_texture = {};
+    // Null until the game started
+    std::unique_ptr<Game_World> world;
+    // Nothing is recorded if the path is empty
+    const string replay_path;
+    // Every how many steps the state hash is recorded, 0 records none
+    const int hash_interval;
+    Replay_Writer replay;
+
+    Rpc<int> set_player_count_rpc;
+    Rpc<Client_ID, Player_ID> add_player_rpc;
+    Rpc<Player_ID> add_ai_player_rpc;
+    Rpc<Player_ID> set_player_id_rpc;
+    Rpc<Client_ID> remove_player_rpc;
+    Rpc<Player_ID, int> set_player_team_rpc;
+    Rpc<long> start_game_rpc;
+
+    template <typename... Args>
+    void Call_On_Players(const Rpc<Args...>& rpc, std::type_identity_t<Args>... args) {
+        for (Player* player : players) {
+            if (!player->ai)
+                network->call_rpc_on_client(player->client_id, rpc, args...);
+        }
+    }
+
+    void Start_Game();
+
+  public:
+    Card_Match(Dedicated_Server& server, Match_ID match_id, shared_ptr<Network> network,
+               int players_per_match, string replay_path = "", int hash_interval = 0);
+    ~Card_Match() override;
+
+    void Update(chrono::milliseconds delta_time) override;
+    void Write_Stats(std::ostream& out) const override;
+
+    void On_Connected() override {}
+    void On_Disconnected() override {}
+    void On_Server_Start() override {}
+    void On_Server_Stop() override { finished = true; }
+    void On_Client_Connected(Client_ID client_id) override;
+    void On_Client_Disconnected(Client_ID client_id) override;
+};
@@ -20,6 +20,8 @@ class Card_Player : public Player {
     Card_Player(Player_ID player_id, int team)
         : Player(player_id), team(team), money(10), paths(vector<Path*>{}) {}
 
+    static Color Get_Team_Color(int team) { return team ? RED : BLUE; }
+
     Deck_Component* Get_Deck() const {
         auto deck = get<0>(ecs->entities_by_id[deck_id]);
         return get<1>(deck)->Get_Component<Deck_Component>(deck);
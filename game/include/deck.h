@@ -1,9 +1,6 @@
 #pragma once
 #include "ecs.h"
 
-#include <deque>
-#include <vector>
-
 class Game_Scene;
 class Deck_UI;
 class Card;
@@ -13,9 +10,9 @@ struct Deck_Component {
     static Component_Type component_type;
     Card_Player* player;
     Game_Scene* game_scene;
-    std::deque<Entity_ID> deck;
-    std::vector<Entity_ID> hand;
-    std::vector<Entity_ID> discard;
+    Entity_List<Entity_ID, 16> deck;
+    Entity_List<Entity_ID, 8> hand;
+    Entity_List<Entity_ID, 16> discard;
 };
 
 void Init_Deck(Entity entity, Card_Player* player, Game_Scene* game_scene);
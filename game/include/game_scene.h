@@ -3,6 +3,7 @@
 #include "card_game.h"
 #include "game_manager.h"
 #include "game_ui_manager.h"
+#include "game_world.h"
 #include "path.h"
 #include "scene.h"
 #include "ui/eui.h"
@@ -11,24 +12,28 @@ struct Card_Data;
 class Game_Scene : public Scene, Network_Events_Receiver {
   private:
     Card_Game& card_game;
-    std::unique_ptr<Game_Manager> game_manager;
+    std::unique_ptr<Game_World> world;
     std::unique_ptr<Game_UI_Manager> game_ui_manager;
     EUI_Text* money_text;
     int time_until_income;
     Texture2D unit_texture;
     Texture2D tower_texture;
     Texture2D card_texture;
-    vector<Card_Data*> card_datas;
 
-  public:
-    ECS* ecs;
-    vector<Path*> f_paths;
-    vector<Path*> r_paths;
+    // Client side, the snapshot is loaded at the next step boundary of the world
+    vector<char> received_snapshot;
+    long received_snapshot_step;
+    bool snapshot_received;
+
+    void On_ECS_Updated();
 
+  public:
     Game_Scene(Card_Game& card_game);
 
     ~Game_Scene() override;
     void Setup_Scene(vector<Player*> players, Player* local_player, long seed, int num_paths);
+    /* Pauses the match that was just set up until the snapshot from the server is loaded. */
+    void Wait_For_Snapshot();
 
     void Resize_UI(Vector2 screen_seize_change) override;
     void Update_UI(chrono::milliseconds) override;
@@ -42,11 +47,9 @@ class Game_Scene : public Scene, Network_Events_Receiver {
 
     void On_Server_Stop() override;
 
-    void On_Client_Connected(Client_ID) override {}
+    void On_Client_Connected(Client_ID client_id) override;
 
-    void On_Client_Disconnected(Client_ID) override {}
+    void On_Client_Disconnected(Client_ID client_id) override;
 
     vector<Path*> Get_Team_Paths(int team) const;
-
-    static Color Get_Team_Color(int team);
 };
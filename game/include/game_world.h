@@ -0,0 +1,92 @@
+#pragma once
+
+#include "card.h"
+#include "game_manager.h"
+#include "path.h"
+
+class Game_Scene;
+
+/**
+ * Holds the simulation side of a match: the ECS, the Game_Manager, the paths and the cards.
+ * The Game_Scene renders it, the dedicated server and the headless tools drive it directly, so
+ * they all build the same world from the same seed.
+ */
+class Game_World {
+  public:
+    Application& application;
+    Network& network;
+    // Can be null when the world is simulated without a scene
+    Game_Scene* game_scene;
+    std::unique_ptr<Game_Manager> game_manager;
+    ECS* ecs;
+    vector<Path*> f_paths;
+    vector<Path*> r_paths;
+    vector<Card_Data*> card_datas;
+    // The seed the world was set up with, players that join later set up their world from it
+    long seed;
+
+    Texture2D* unit_texture;
+    Texture2D* tower_texture;
+    Texture2D* card_texture;
+
+    Rpc<Player_ID, Entity_ID, float, float> play_card_rpc;
+    Rpc<Player_ID, Entity_ID> discard_rpc;
+    // Called between the ECS update and the Game_Manager update, when no entities are waiting to
+    // be created. Snapshots are saved and loaded here so that they line up with a step.
+    std::function<void()> on_ecs_updated;
+
+    Game_World(Application& application, Network& network, Game_Scene* game_scene,
+               Texture2D* unit_texture, Texture2D* tower_texture, Texture2D* card_texture);
+    ~Game_World();
+
+    /**
+     * Creates the Game_Manager, the ECS with its systems and entity types, the paths,
+     * the bases and a deck for every player on a team.
+     * worker_count is the number of ECS worker threads, unless the ECS runs on a worker pool.
+     */
+    void Setup_World(vector<Player*> players, Player* local_player, long seed, int num_paths,
+                     int worker_count = 30, ECS_Worker_Pool* worker_pool = nullptr);
+
+    void Update();
+
+    /**
+     * Registers the objects components point at and lets the Game_Manager save and load the ECS
+     * and the money of the players with its snapshot.
+     */
+    void Setup_Snapshots();
+    /* Hashes the snapshot of the match, machines that are in sync get the same hash. */
+    uint64_t Hash_State();
+
+    /* Writes the paths and the players, what a replay needs besides the seed to set up the world. */
+    vector<char> Save_Replay_Setup() const;
+    /**
+     * Creates the players of a setup written by Save_Replay_Setup.
+     * @return false if the setup is broken
+     */
+    static bool Load_Replay_Setup(const vector<char>& setup, vector<Player*>& players,
+                                  int& num_paths);
+
+    vector<Path*> Get_Team_Paths(int team) const;
+
+    /* Called on the server for a client that connected during the match. */
+    void On_Client_Connected(Client_ID client_id);
+    /* Called on the server, the match stops waiting for the client and its player can be taken. */
+    void On_Client_Disconnected(Client_ID client_id);
+
+  private:
+    // Server side of late joining, clients that connected during the match get a snapshot
+    vector<Client_ID> joining_clients;
+    // Players on a team whose client left, the next client to join takes over their slot
+    vector<Player*> disconnected_players;
+    unordered_map<Client_ID, Player_ID> spectators;
+    Player_ID next_spectator_id = 0;
+    // Set when the ECS already ran the current step, like in a snapshot that was just loaded
+    bool ecs_updated = false;
+    Rpc<Client_ID, Player_ID> add_player_rpc;
+    Rpc<Player_ID> add_ai_player_rpc;
+    Rpc<Player_ID, int> set_player_team_rpc;
+    Rpc<long, Player_ID> join_game_rpc;
+
+    /* Sends the players, the seed and a snapshot of the match to a client that joined late. */
+    void Join_Client(Client_ID client_id);
+};
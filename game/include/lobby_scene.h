@@ -7,6 +7,8 @@
 
 using namespace std;
 
+class Game_Scene;
+
 class Lobby_Scene : public Scene, Network_Events_Receiver {
   private:
     EUI_Text* status_text;
@@ -18,9 +20,17 @@ class Lobby_Scene : public Scene, Network_Events_Receiver {
     int player_id_count;
     vector<Player*> players;
     Player* local_player;
+    Rpc<int> set_player_count_rpc;
+    Rpc<Client_ID, Player_ID> add_player_rpc;
+    Rpc<Player_ID> add_ai_player_rpc;
+    Rpc<Player_ID> set_player_id_rpc;
+    Rpc<Client_ID> remove_player_rpc;
+    Rpc<Player_ID, int> set_player_team_rpc;
+    Rpc<long> start_game_rpc;
+    Rpc<long, Player_ID> join_game_rpc;
     void Server_Start_Game();
     void Server_Start_AI_Only();
-    void Start_Game(long seed);
+    Game_Scene* Start_Game(long seed);
 
   public:
     Lobby_Scene(Card_Game& card_game);
@@ -22,7 +22,11 @@ class Menu_Scene : public Scene {
         root->Add_Child(title);
 
         auto* join_button = new EUI_Button("Join Game", [&card_game] {
-            card_game.Connect_To_Server();
+            if (card_game.server_match.has_value())
+                card_game.Connect_To_Server(
+                    make_unique<Match_Join_Transport>(*card_game.server_match));
+            else
+                card_game.Connect_To_Server();
             card_game.set_ui_screen(LOBBY);
             card_game.Get_Network()->Start_Network();
         });
@@ -9,9 +9,10 @@ class Projectile_UI : public Object_UI {
 
     void Update_UI(EUI_Context* ctx) override {
         Entity entity = std::get<0>(ecs.entities_by_id[entity_id]);
-        auto* transform = std::get<1>(entity)->Get_Component<Transform_Component>(entity);
+        Transform_Component transform = game_ui_manager.Get_Render_Transform(
+            entity_id, *std::get<1>(entity)->Get_Component<Transform_Component>(entity));
         auto* ui = std::get<1>(entity)->Get_Component<UI_Component>(entity);
-        game_ui_manager.DrawImage(*ui->texture, transform->pos, transform->rot, ui->scale,
+        game_ui_manager.DrawImage(*ui->texture, transform.pos, transform.rot, ui->scale,
                                   ui->color);
     }
 };
\ No newline at end of file
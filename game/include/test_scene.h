@@ -389,11 +389,10 @@ class Test_Scene : public Scene {
         if (index >= 0 && index < 6) {
             root_elem = test_layouts[index];
 
-            // Update size and context root, then perform layout
+            // Update size and context root, the layout is done in the next frame
             if (root_elem) {
                 root_elem->size = {(float) game.screen_width, (float) game.screen_height};
                 game.eui_ctx->Set_Root(root_elem); // Tell context about the new root
-                game.eui_ctx->Perform_Layout();
             }
         }
     }
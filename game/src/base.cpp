@@ -19,21 +19,40 @@ void Init_Base(Entity entity, Game_Scene* game_scene, vector<Card_Player*> playe
     transform->pos = pos;
     transform->rot = 0;
     transform->scale = 1;
+    Side_Storage& storage = get<1>(entity)->ecs.side_storage;
     base->game_scene = game_scene;
-    base->players = std::move(players);
+    for (auto player : players)
+        base->players.Push_Back(storage, player);
     base->other_base_id = other_base_id;
     base->team = team;
-    base->paths = paths;
     base->base_income_speed = base_income_speed;
     base->max_health = max_health;
     base->health = max_health;
     base->time_until_income = 0;
-    base->units_on_path = vector<vector<Entity_ID>*>();
     for (auto path : paths) {
-        base->units_on_path.emplace_back(new vector<Entity_ID>());
+        base->paths.Push_Back(storage, path);
+        base->units_on_path.Push_Back(storage, {});
     }
 }
 
+static void Copy_Base_Component(ECS& ecs, void* component) {
+    auto* base = static_cast<Base_Component*>(component);
+    base->players.Copy_Storage(ecs.side_storage);
+    base->paths.Copy_Storage(ecs.side_storage);
+    base->units_on_path.Copy_Storage(ecs.side_storage);
+    for (auto& units : base->units_on_path)
+        units.Copy_Storage(ecs.side_storage);
+}
+
+static void Delete_Base_Component(ECS& ecs, void* component) {
+    auto* base = static_cast<Base_Component*>(component);
+    base->players.Release(ecs.side_storage);
+    base->paths.Release(ecs.side_storage);
+    for (auto& units : base->units_on_path)
+        units.Release(ecs.side_storage);
+    base->units_on_path.Release(ecs.side_storage);
+}
+
 void Base_Update(ECS* ecs, Entity entity) {
     auto base = get<1>(entity)->Get_Component<Base_Component>(entity);
     if (--base->time_until_income <= 0) {
@@ -104,8 +123,45 @@ void Try_Placing_Tower(ECS* ecs, int card_index, Entity card_entity, Card_Compon
 }
 
 Entity_Type* Get_Base_Entity_Type() {
-    return new Entity_Type(
+    static Entity_Type entity_type(
         vector{&Transform_Component::component_type, &Base_Component::component_type});
+    return &entity_type;
+}
+
+static void Save_Base_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    auto* base = static_cast<const Base_Component*>(component);
+    writer.Write_Pointer(base->game_scene);
+    writer.Write_Pointer_List(base->players);
+    writer.Write(base->other_base_id);
+    writer.Write(base->team);
+    Write_Varint(writer, base->units_on_path.size());
+    for (const auto& units : base->units_on_path)
+        writer.Write_List(units);
+    writer.Write(base->base_income_speed);
+    writer.Write(base->time_until_income);
+    writer.Write(base->health);
+    writer.Write(base->max_health);
+    writer.Write_Pointer_List(base->paths);
+}
+
+static void Load_Base_Component(ECS& ecs, void* component, Snapshot_Reader& reader) {
+    auto* base = static_cast<Base_Component*>(component);
+    base->game_scene = reader.Read_Pointer<Game_Scene>();
+    reader.Read_Pointer_List(base->players, ecs.side_storage);
+    base->other_base_id = reader.Read<Entity_ID>();
+    base->team = reader.Read<int>();
+    size_t path_count = reader.Read_Varint();
+    for (size_t i = 0; i < path_count && !reader.failed; i++) {
+        base->units_on_path.Push_Back(ecs.side_storage, {});
+        reader.Read_List(base->units_on_path[base->units_on_path.size() - 1], ecs.side_storage);
+    }
+    base->base_income_speed = reader.Read<int>();
+    base->time_until_income = reader.Read<int>();
+    base->health = reader.Read<int>();
+    base->max_health = reader.Read<int>();
+    reader.Read_Pointer_List(base->paths, ecs.side_storage);
 }
 
-Component_Type Base_Component::component_type = Component_Type{"Base", sizeof(Base_Component)};
+Component_Type Base_Component::component_type =
+    Component_Type{"Base", sizeof(Base_Component), Copy_Base_Component, Delete_Base_Component,
+                   Save_Base_Component, Load_Base_Component};
@@ -1,5 +1,7 @@
 #include "card.h"
+#ifndef EUCLID_HEADLESS
 #include "card_ui.h"
+#endif
 
 void Init_Card(Entity entity, Card_Data& card_data, Texture2D* texture, float scale, Color color) {
     auto* card_component = get<1>(entity)->Get_Component<Card_Component>(entity);
@@ -26,8 +28,25 @@ void Discard_Card(Card_Player* player, Entity entity) {
                       Entity_Array::Get_Entity_Data(entity).id);
 }
 
+#ifndef EUCLID_HEADLESS
 Object_UI* Create_Card_UI(Entity entity, Game_UI_Manager& game_ui_manager) {
     return new Card_UI(entity, game_ui_manager);
 }
+#endif
 
-Component_Type Card_Component::component_type = Component_Type{"Card", sizeof(Card_Component)};
+static void Save_Card_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    Card_Component card = *static_cast<const Card_Component*>(component);
+    writer.Write_Pointer(card.card_data);
+    card.card_data = nullptr;
+    writer.Write_Bytes(card);
+}
+
+static void Load_Card_Component(ECS&, void* component, Snapshot_Reader& reader) {
+    auto* card = static_cast<Card_Component*>(component);
+    auto* card_data = reader.Read_Pointer<Card_Data>();
+    reader.Read_Bytes_Into(*card);
+    card->card_data = card_data;
+}
+
+Component_Type Card_Component::component_type = Component_Type{
+    "Card", sizeof(Card_Component), nullptr, nullptr, Save_Card_Component, Load_Card_Component};
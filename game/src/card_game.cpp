@@ -17,9 +17,8 @@ void Card_Game::resize_update() {
     auto root = scene->Get_Root();
     if (root) {
         root->size = {static_cast<float>(screen_width), static_cast<float>(screen_height)};
+        root->Mark_Layout_Dirty();
     }
-
-    root->ctx->Perform_Layout();
 }
 
 void Card_Game::set_ui_screen(SCREEN new_screen) {
@@ -29,7 +28,6 @@ void Card_Game::set_ui_screen(SCREEN new_screen) {
     // will panic if eui_ctx is null, shouldn't ever happen so let it crash
     // TODO: this should probably be in the engine
     eui_ctx->Set_Root(scene->Get_Root());
-    eui_ctx->Perform_Layout();
 }
 
 void Card_Game::Start_Client() {
@@ -80,6 +78,8 @@ void Card_Game::Update_UI(chrono::milliseconds deltaTime) {
     eui_ctx->Begin_Frame();
     eui_ctx->Update_Input();
     eui_ctx->Handle_Input();
+    // Everything changed since the last frame, including a new scene, is laid out once here
+    eui_ctx->Perform_Layout();
     eui_ctx->End_Frame();
 
     if (WindowShouldClose()) {
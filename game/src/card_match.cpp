@@ -0,0 +1,122 @@
+#include "card_match.h"
+
+#include "card_player.h"
+
+// Has to be the same as the paths the clients set up in Lobby_Scene::Start_Game
+static constexpr int num_paths = 3;
+
+Card_Match::Card_Match(Dedicated_Server& server, Match_ID match_id, shared_ptr<Network> network,
+                       int players_per_match, string replay_path, int hash_interval)
+    : Match(match_id, std::move(network)), server(server), players_per_match(players_per_match),
+      replay_path(std::move(replay_path)), hash_interval(hash_interval), replay(*this->network) {
+    // Bound by the Lobby_Scene of the clients, the server only calls them
+    set_player_count_rpc = this->network->Get_Rpc<int>("setplayercount");
+    add_player_rpc = this->network->Get_Rpc<Client_ID, Player_ID>("addplayer");
+    add_ai_player_rpc = this->network->Get_Rpc<Player_ID>("addaiplayer");
+    set_player_id_rpc = this->network->Get_Rpc<Player_ID>("setplayerid");
+    remove_player_rpc = this->network->Get_Rpc<Client_ID>("removeplayer");
+    set_player_team_rpc = this->network->Get_Rpc<Player_ID, int>("setplayerteam");
+    start_game_rpc = this->network->Get_Rpc<long>("startgame");
+    this->network->connection_events->emplace(static_cast<Network_Events_Receiver*>(this));
+}
+
+Card_Match::~Card_Match() {
+    network->connection_events->erase(static_cast<Network_Events_Receiver*>(this));
+    if (world != nullptr && replay.Is_Open())
+        replay.Close(world->game_manager->Get_Current_Step());
+    world.reset();
+    for (Player* player : players)
+        delete player;
+}
+
+void Card_Match::Start_Game() {
+    int team = 0;
+    for (Player* player : players) {
+        static_cast<Card_Player*>(player)->team = team;
+        Call_On_Players(set_player_team_rpc, player->player_id, team);
+        team = (team + 1) % 2;
+    }
+    // If the teams are unbalanced add an AI
+    if (team == 1) {
+        Player_ID ai_id = next_player_id++;
+        Call_On_Players(add_ai_player_rpc, ai_id);
+        Call_On_Players(set_player_team_rpc, ai_id, team);
+        players.emplace_back(new Card_Player(ai_id, team));
+    }
+    long seed =
+        chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch())
+            .count();
+    Call_On_Players(start_game_rpc, seed);
+
+    cout << "Starting match " << match_id << " with " << connected_clients << " players" << endl;
+    world = make_unique<Game_World>(server, *network, nullptr, &unit_texture, &tower_texture,
+                                    &card_texture);
+    world->Setup_World(players, nullptr, seed, num_paths, 0, &server.Get_Worker_Pool());
+    if (replay_path.empty() || !replay.Open(replay_path, seed, world->Save_Replay_Setup()))
+        return;
+    cout << "Recording match " << match_id << " to " << replay_path << endl;
+    if (hash_interval > 0) {
+        world->on_ecs_updated = [this] {
+            long step = world->game_manager->Get_Current_Step();
+            if (step % hash_interval == 0)
+                replay.Write_Hash(step, world->Hash_State());
+        };
+    }
+}
+
+void Card_Match::Update(chrono::milliseconds) {
+    if (world != nullptr)
+        world->Update();
+}
+
+void Card_Match::Write_Stats(std::ostream& out) const {
+    out << "{\"players\":" << connected_clients << ",\"network\":";
+    network->Write_Stats(out);
+    out << ",\"lockstep\":";
+    if (world != nullptr)
+        world->game_manager->Write_Stats(out);
+    else
+        out << "null";
+    out << "}";
+}
+
+void Card_Match::On_Client_Connected(Client_ID client_id) {
+    connected_clients++;
+    if (world != nullptr) {
+        world->On_Client_Connected(client_id);
+        return;
+    }
+
+    Player_ID player_id = next_player_id++;
+    players.emplace_back(new Card_Player(client_id, player_id, 0));
+    Call_On_Players(set_player_count_rpc, static_cast<int>(players.size()));
+    Call_On_Players(add_player_rpc, client_id, player_id);
+    network->call_rpc_on_client(client_id, set_player_id_rpc, player_id);
+    for (Player* player : players) {
+        if (player->client_id != client_id)
+            network->call_rpc_on_client(client_id, add_player_rpc, player->client_id,
+                                        player->player_id);
+    }
+    if (static_cast<int>(players.size()) == players_per_match)
+        Start_Game();
+}
+
+void Card_Match::On_Client_Disconnected(Client_ID client_id) {
+    connected_clients--;
+    // Nobody is left to play the match
+    if (connected_clients == 0)
+        finished = true;
+    if (world != nullptr) {
+        world->On_Client_Disconnected(client_id);
+        return;
+    }
+
+    erase_if(players, [client_id](Player* player) {
+        if (player->client_id != client_id)
+            return false;
+        delete player;
+        return true;
+    });
+    Call_On_Players(set_player_count_rpc, static_cast<int>(players.size()));
+    Call_On_Players(remove_player_rpc, client_id);
+}
@@ -1,14 +1,14 @@
 #include "deck.h"
+#ifndef EUCLID_HEADLESS
 #include "deck_ui.h"
+#endif
 
 #include <algorithm>
 
 void Init_Deck(Entity entity, Card_Player* player, Game_Scene* game_scene) {
     auto deck = std::get<1>(entity)->Get_Component<Deck_Component>(entity);
+    // The card lists start empty because new components are zeroed
     deck->player = player;
-    deck->deck = std::deque<Entity_ID>();
-    deck->hand = std::vector<Entity_ID>();
-    deck->discard = std::vector<Entity_ID>();
     deck->game_scene = game_scene;
 }
 
@@ -20,17 +20,16 @@ void Draw_Card(Entity entity, int cards) {
         if (deck->deck.empty())
             break;
 
-        deck->hand.emplace_back(deck->deck.front());
-        deck->deck.pop_front();
+        deck->hand.Push_Back(get<1>(entity)->ecs.side_storage, deck->deck.Pop_Front());
     }
 }
 
 void Shuffle_Discard_Into_Deck(Entity entity) {
     auto deck = std::get<1>(entity)->Get_Component<Deck_Component>(entity);
     for (auto card : deck->discard) {
-        deck->deck.emplace_back(card);
+        deck->deck.Push_Back(get<1>(entity)->ecs.side_storage, card);
     }
-    deck->discard.clear();
+    deck->discard.Clear();
     Shuffle_Deck(entity);
 }
 
@@ -41,17 +40,54 @@ void Shuffle_Deck(Entity entity) {
 
 void Discard_Deck_Card(Entity entity, Entity_ID card) {
     auto deck = std::get<1>(entity)->Get_Component<Deck_Component>(entity);
-    deck->hand.erase(ranges::find(deck->hand, card));
-    deck->discard.emplace_back(card);
+    deck->hand.Remove(card);
+    deck->discard.Push_Back(get<1>(entity)->ecs.side_storage, card);
 }
 
+#ifndef EUCLID_HEADLESS
 Object_UI* Create_Deck_UI(Entity entity, Game_UI_Manager& game_ui_manager) {
     auto deck = std::get<1>(entity)->Get_Component<Deck_Component>(entity);
     return new Deck_UI(entity, game_ui_manager, deck->player);
 }
+#endif
 
 Entity_Type* Get_Deck_Entity_Type() {
-    return new Entity_Type(vector{&Deck_Component::component_type});
+    static Entity_Type entity_type(vector{&Deck_Component::component_type});
+    return &entity_type;
 }
 
-Component_Type Deck_Component::component_type = Component_Type{"Deck", sizeof(Deck_Component)};
+static void Copy_Deck_Component(ECS& ecs, void* component) {
+    auto* deck = static_cast<Deck_Component*>(component);
+    deck->deck.Copy_Storage(ecs.side_storage);
+    deck->hand.Copy_Storage(ecs.side_storage);
+    deck->discard.Copy_Storage(ecs.side_storage);
+}
+
+static void Delete_Deck_Component(ECS& ecs, void* component) {
+    auto* deck = static_cast<Deck_Component*>(component);
+    deck->deck.Release(ecs.side_storage);
+    deck->hand.Release(ecs.side_storage);
+    deck->discard.Release(ecs.side_storage);
+}
+
+static void Save_Deck_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    auto* deck = static_cast<const Deck_Component*>(component);
+    writer.Write_Pointer(deck->player);
+    writer.Write_Pointer(deck->game_scene);
+    writer.Write_List(deck->deck);
+    writer.Write_List(deck->hand);
+    writer.Write_List(deck->discard);
+}
+
+static void Load_Deck_Component(ECS& ecs, void* component, Snapshot_Reader& reader) {
+    auto* deck = static_cast<Deck_Component*>(component);
+    deck->player = reader.Read_Pointer<Card_Player>();
+    deck->game_scene = reader.Read_Pointer<Game_Scene>();
+    reader.Read_List(deck->deck, ecs.side_storage);
+    reader.Read_List(deck->hand, ecs.side_storage);
+    reader.Read_List(deck->discard, ecs.side_storage);
+}
+
+Component_Type Deck_Component::component_type =
+    Component_Type{"Deck", sizeof(Deck_Component), Copy_Deck_Component, Delete_Deck_Component,
+                   Save_Deck_Component, Load_Deck_Component};
@@ -1,20 +1,19 @@
 #include <raylib.h>
 #include <raymath.h>
 
-#include "base.h"
 #include "card.h"
 #include "card_player.h"
 #include "card_ui.h"
 #include "game_scene.h"
+#include "snapshot.h"
 
-#include "projectile.h"
 #include "tower.h"
 #include "tower_card.h"
-#include "unit.h"
 #include "unit_card.h"
 
 Game_Scene::Game_Scene(Card_Game& card_game)
-    : Scene(card_game), card_game(card_game), time_until_income(0) {
+    : Scene(card_game), card_game(card_game), time_until_income(0), received_snapshot_step(0),
+      snapshot_received(false) {
     EUI_Box* root = new EUI_Box();
     root_elem = root;
 
@@ -37,156 +36,65 @@ Game_Scene::Game_Scene(Card_Game& card_game)
 
     unit_texture = LoadTextureFromImage(LoadImage("resources/Arrow.png"));
     tower_texture = LoadTextureFromImage(LoadImage("resources/Tower.png"));
+    card_texture = LoadTextureFromImage(LoadImage("resources/Card.png"));
+    card_game.Get_Network()->connection_events->emplace(
+        static_cast<Network_Events_Receiver*>(this));
 }
 
 Game_Scene::~Game_Scene() {
-    if (card_game.Get_Network() != nullptr)
+    card_game.stats.Remove_Section("lockstep");
+    if (card_game.Get_Network() != nullptr) {
         card_game.Get_Network()->connection_events->erase(
             static_cast<Network_Events_Receiver*>(this));
+        card_game.Get_Network()->Set_Snapshot_Receiver(nullptr);
+    }
 }
 
 void Game_Scene::Setup_Scene(vector<Player*> players, Player* local_player, long seed,
                              int num_paths) {
-    ranges::sort(players, [](Player* a, Player* b) { return a->player_id <= b->player_id; });
-    game_manager = std::make_unique<Game_Manager>(card_game, *card_game.Get_Network(), players,
-                                                  local_player, seed);
-    ecs = new ECS(application, seed);
-    ecs->Register_System(new System(Get_Unit_Entity_Type(), Unit_Update), 1);
-    ecs->Register_System(new System(Get_Tower_Entity_Type(), Tower_Update), 1);
-    ecs->Register_System(new System(Get_Base_Entity_Type(), Base_Update), 0);
-    ecs->Register_System(new System(Get_Projectile_Entity_Type(), Projectile_Update), 0);
-
-    for (int p = 0; p < num_paths; p++) {
-        int pathx_offset = ((p + 1) / 2) * 220;
-        if (p % 2 == 1)
-            pathx_offset *= -1;
-        vector<Vector2> positions = vector<Vector2>();
-        static uniform_int_distribution<int> start_dist(-80, 80);
-        positions.emplace_back(start_dist(game_manager->random) + pathx_offset, 1000 - 80);
-        while (positions[positions.size() - 1].y > 80) {
-            Vector2 prev_pos = positions[positions.size() - 1];
-            prev_pos.x -= pathx_offset;
-            static uniform_int_distribution<int> move_dist(-40, 40);
-            int new_x = max(min((int) prev_pos.x + move_dist(game_manager->random), 100), 0);
-            static uniform_int_distribution<int> forward_dist(20, 40);
-            positions.emplace_back(new_x + pathx_offset,
-                                   prev_pos.y - forward_dist(game_manager->random));
-        }
-
-        auto f_path = new Path(p, positions);
-        vector<Vector2> reversed = vector<Vector2>(positions);
-        ranges::reverse(reversed);
-        auto r_path = new Path(p, reversed);
-        f_paths.emplace_back(f_path);
-        r_paths.emplace_back(r_path);
-    }
-
-    game_ui_manager = make_unique<Game_UI_Manager>(card_game, *ecs, *game_manager);
-    if (static_cast<Card_Player*>(game_manager->local_player)->team == 1) {
+    world = std::make_unique<Game_World>(card_game, *card_game.Get_Network(), this,
+                                         &unit_texture, &tower_texture, &card_texture);
+    world->Setup_World(std::move(players), local_player, seed, num_paths);
+    card_game.stats.Add_Section("lockstep",
+                                [this](ostream& out) { world->game_manager->Write_Stats(out); });
+
+    game_ui_manager = make_unique<Game_UI_Manager>(card_game, *world->ecs, *world->game_manager);
+    if (static_cast<Card_Player*>(world->game_manager->local_player)->team == 1) {
         game_ui_manager->camera.rotation = 180;
     }
-    card_game.Get_Network()->bind_rpc(
-        "playcard", [this](Player_ID player_id, Entity_ID entity_id, float x, float y) {
-            Card_Player* player = static_cast<Card_Player*>(game_manager->Get_Player(player_id));
-            // Check if the card is in the hand
-            if (ranges::find(player->Get_Deck()->hand, entity_id) == player->Get_Deck()->hand.end())
-                return RPC_Manager::INVALID;
-            Entity card = get<0>(ecs->entities_by_id[entity_id]);
-            auto* card_component = get<1>(card)->Get_Component<Card_Component>(card);
 
-            if (!card_component->card_data->can_play_card(player, card, Vector2(x, y)))
-                return RPC_Manager::INVALID;
-
-            card_component->card_data->play_card(player, card, Vector2(x, y));
-            return RPC_Manager::VALID_CALL_ON_CLIENTS;
-        });
-    card_game.Get_Network()->bind_rpc("discard", [this](Player_ID player_id, Entity_ID entity_id) {
-        Card_Player* player = static_cast<Card_Player*>(game_manager->Get_Player(player_id));
-        // Check if the card is in the hand
-        if (ranges::find(player->Get_Deck()->hand, entity_id) == player->Get_Deck()->hand.end())
-            return RPC_Manager::INVALID;
-
-        Discard_Card(player, get<0>(ecs->entities_by_id[entity_id]));
-        return RPC_Manager::VALID_CALL_ON_CLIENTS;
-    });
-
-    ecs->Create_Entity_Type(Get_Unit_Entity_Type()->components, "Unit", Create_Unit_UI, Setup_Unit,
-                            Delete_Unit);
-    ecs->Create_Entity_Type(Get_Tower_Entity_Type()->components, "Tower", Create_Tower_UI);
-    ecs->Create_Entity_Type(vector{&Deck_Component::component_type}, "Deck", Create_Deck_UI);
-    ecs->Create_Entity_Type(Get_Unit_Card_Entity_Type()->components, "UnitCard", Create_Card_UI);
-    ecs->Create_Entity_Type(Get_Tower_Card_Entity_Type()->components, "TowerCard", Create_Card_UI);
-    ecs->Create_Entity_Type(Get_Base_Entity_Type()->components, "Base", nullptr);
-    ecs->Create_Entity_Type(Get_Projectile_Entity_Type()->components, "Projectile",
-                            Create_Projectile_UI);
-
-    card_texture = LoadTextureFromImage(LoadImage("resources/Card.png"));
-    card_datas.emplace_back(new Card_Data{card_texture, "Send Units",
-                                          "Sends 7 units to the opponent.", 5, Can_Play_Card,
-                                          Play_Unit_Card, Discard_Card});
-    card_datas.emplace_back(new Card_Data{card_texture, "Send Units",
-                                          "Sends 11 units to the opponent.", 8, Can_Play_Card,
-                                          Play_Unit_Card, Discard_Card});
-    card_datas.emplace_back(new Card_Data{card_texture, "Send Units",
-                                          "Sends 18 units to the opponent.", 12, Can_Play_Card,
-                                          Play_Unit_Card, Discard_Card});
-    card_datas.emplace_back(new Card_Data{card_texture, "Tower",
-                                          "Places a tower that shoots opposing units.", 15,
-                                          Can_Play_Tower_Card, Play_Tower_Card, Discard_Card});
+    money_text->is_visible =
+        static_cast<Card_Player*>(world->game_manager->local_player)->team != -1;
+    money_text->Mark_Layout_Dirty();
 
-    vector<Entity_ID> starting_cards{};
-    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
-                                               card_datas[0], {7, 1.3f, 3, 2, &unit_texture},
-                                               &card_texture, 1, WHITE));
-    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
-                                               card_datas[0], {7, 1.3f, 3, 2, &unit_texture},
-                                               &card_texture, 1, WHITE));
-    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
-                                               card_datas[1], {11, 1, 8, 1, &unit_texture},
-                                               &card_texture, 1, WHITE));
-    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
-                                               card_datas[2], {18, .8f, 10, 1, &unit_texture},
-                                               &card_texture, 1, WHITE));
-    starting_cards.emplace_back(Init_Tower_Card(
-        ecs->Create_Entity(Get_Tower_Card_Entity_Type(), 0), card_datas[3],
-        {&tower_texture, 0, true, 30, 2, 120, 5, &unit_texture}, &card_texture, 1, WHITE));
-
-    Entity base0 = ecs->Create_Entity(Get_Base_Entity_Type(), -1);
-    auto team0_players = vector<Card_Player*>();
-    Entity base1 = ecs->Create_Entity(Get_Base_Entity_Type(), -1);
-    auto team1_players = vector<Card_Player*>();
+    world->on_ecs_updated = [this] { On_ECS_Updated(); };
+}
 
-    for (auto player : game_manager->players) {
-        auto* card_player = static_cast<Card_Player*>(player);
-        if (card_player->team == -1)
-            continue;
-        card_player->ecs = ecs;
-        card_player->base_id = Entity_Array::Get_Entity_ID(card_player->team == 0 ? base0 : base1);
-        card_player->team == 0 ? team0_players.emplace_back(card_player)
-                               : team1_players.emplace_back(card_player);
-        card_player->paths = Get_Team_Paths(card_player->team);
+void Game_Scene::Wait_For_Snapshot() {
+    world->game_manager->Wait_For_Snapshot();
+    card_game.Get_Network()->Set_Snapshot_Receiver(
+        [this](long step, const char* data, size_t size) {
+            received_snapshot.assign(data, data + size);
+            received_snapshot_step = step;
+            snapshot_received = true;
+        });
+}
 
-        auto deck = ecs->Create_Entity(Get_Deck_Entity_Type(), -1);
-        Init_Deck(deck, card_player, this);
-        card_player->deck_id = Entity_Array::Get_Entity_ID(deck);
-        for (auto& card : starting_cards) {
-            card_player->Get_Deck()->deck.emplace_back(
-                Entity_Array::Get_Entity_Data(ecs->Copy_Entity(card, -1)).id);
+void Game_Scene::On_ECS_Updated() {
+    if (snapshot_received) {
+        snapshot_received = false;
+        Snapshot_Reader reader(received_snapshot.data(), received_snapshot.size(),
+                               world->ecs->snapshot_pointers);
+        if (!world->game_manager->Load_Snapshot(reader)) {
+            cerr << "Failed to load the snapshot of step " << received_snapshot_step << "!"
+                 << endl;
+            card_game.Close_Network();
+            card_game.set_ui_screen(MENU);
+            return;
         }
-        Shuffle_Deck(deck);
-        Draw_Card(deck, 3);
+        received_snapshot.clear();
+        received_snapshot.shrink_to_fit();
     }
-    Init_Base(base0, this, team0_players, Entity_Array::Get_Entity_ID(base1), 0,
-              Get_Team_Paths(0)[0]->positions[0], Get_Team_Paths(0), 20, 100);
-    Init_Base(base1, this, team1_players, Entity_Array::Get_Entity_ID(base0), 1,
-              Get_Team_Paths(1)[0]->positions[0], Get_Team_Paths(1), 20, 100);
-
-    for (Entity_ID starting_card : starting_cards) {
-        ecs->Delete_Entity(starting_card);
-    }
-    starting_cards.clear();
-
-    money_text->is_visible = static_cast<Card_Player*>(game_manager->local_player)->team != -1;
 }
 
 void Game_Scene::Resize_UI(Vector2 screen_seize_change) {
@@ -202,10 +110,13 @@ void Game_Scene::Update_UI(chrono::milliseconds delta_time) {
         game_ui_manager->camera.offset.y += 10;
     if (IsKeyDown(KEY_S))
         game_ui_manager->camera.offset.y -= 10;
+    // Records the next 600 steps to open in chrome://tracing
+    if (IsKeyPressed(KEY_P) && !world->ecs->profiler.Is_Tracing())
+        world->ecs->profiler.Start_Trace(600, "ecs_trace.json");
 
     Path* selected_path = nullptr;
 
-    Card_Player* local_player = static_cast<Card_Player*>(game_manager->local_player);
+    Card_Player* local_player = static_cast<Card_Player*>(world->game_manager->local_player);
     auto mouse_pos = card_game.eui_ctx->input.mouse_position;
     auto world_mouse_pos = GetScreenToWorld2D(mouse_pos, game_ui_manager->camera);
     if (get<0>(local_player->active_card) != nullptr) {
@@ -229,7 +140,7 @@ void Game_Scene::Update_UI(chrono::milliseconds delta_time) {
                     Can_Play_Card(local_player, local_player->active_card,
                                   Vector2(world_mouse_pos.x, world_mouse_pos.y)))
                     this->card_game.Get_Network()->call_game_rpc(
-                        "playcard", local_player->player_id,
+                        world->play_card_rpc, local_player->player_id,
                         Entity_Array::Get_Entity_ID(local_player->active_card), world_mouse_pos.x,
                         world_mouse_pos.y);
                 local_player->active_card = tuple<unsigned char*, Entity_Array*>(nullptr, nullptr);
@@ -244,7 +155,7 @@ void Game_Scene::Update_UI(chrono::milliseconds delta_time) {
                 Can_Play_Card(local_player, local_player->active_card,
                               Vector2(world_mouse_pos.x, world_mouse_pos.y)))
                 this->card_game.Get_Network()->call_game_rpc(
-                    "playcard", local_player->player_id,
+                    world->play_card_rpc, local_player->player_id,
                     Entity_Array::Get_Entity_ID(local_player->active_card), world_mouse_pos.x,
                     world_mouse_pos.y);
             local_player->active_card = tuple<unsigned char*, Entity_Array*>(nullptr, nullptr);
@@ -270,7 +181,7 @@ void Game_Scene::Update_UI(chrono::milliseconds delta_time) {
             selected_path = path;
         }
     } else {
-        for (auto entity : ecs->Get_Entities_Of_Type(Get_Tower_Entity_Type())) {
+        for (auto entity : world->ecs->Get_Entities_Of_Type(Get_Tower_Entity_Type())) {
             auto* transform = get<1>(entity)->Get_Component<Transform_Component>(entity);
             if (Vector2Distance(transform->pos, world_mouse_pos) > 20)
                 continue;
@@ -285,7 +196,7 @@ void Game_Scene::Update_UI(chrono::milliseconds delta_time) {
 
     BeginMode2D(game_ui_manager->camera);
     // Visualize path
-    for (auto f_path : f_paths) {
+    for (auto f_path : world->f_paths) {
         Vector2 past_pos = Vector2One() * -1;
         if (selected_path == f_path) {
             for (const auto& pos : f_path->positions) {
@@ -308,13 +219,15 @@ void Game_Scene::Update_UI(chrono::milliseconds delta_time) {
     game_ui_manager->Update_UI(delta_time, card_game.eui_ctx);
 
     money_text->Set_Text("Money: " + to_string(local_player->money));
+    // Only lays out again if the money changed
+    card_game.eui_ctx->Perform_Layout();
 
     root_elem->Render();
 }
 
 void Game_Scene::Update(std::chrono::milliseconds) {
-    ecs->Update();
-    game_manager->Update();
+    world->Update();
+    game_ui_manager->Publish_Render_State();
 }
 
 void Game_Scene::On_Disconnected() {
@@ -322,15 +235,21 @@ void Game_Scene::On_Disconnected() {
     card_game.Close_Network();
 }
 
+void Game_Scene::On_Client_Connected(Client_ID client_id) {
+    if (world != nullptr)
+        world->On_Client_Connected(client_id);
+}
+
+void Game_Scene::On_Client_Disconnected(Client_ID client_id) {
+    if (world != nullptr)
+        world->On_Client_Disconnected(client_id);
+}
+
 void Game_Scene::On_Server_Stop() {
     card_game.set_ui_screen(MENU);
     card_game.Close_Network();
 }
 
 vector<Path*> Game_Scene::Get_Team_Paths(int team) const {
-    return team == 0 ? f_paths : r_paths;
-}
-
-Color Game_Scene::Get_Team_Color(int team) {
-    return team ? RED : BLUE;
+    return world->Get_Team_Paths(team);
 }
@@ -0,0 +1,363 @@
+#include "game_world.h"
+
+#include "base.h"
+#include "card_player.h"
+#include "deck.h"
+#include "snapshot.h"
+#include "projectile.h"
+#include "replay.h"
+#include "tower.h"
+#include "tower_card.h"
+#include "unit.h"
+#include "unit_card.h"
+
+#ifdef EUCLID_HEADLESS
+// Nothing is rendered on a headless server, so the entities don't get any UI objects
+#define UI_CREATOR(function) nullptr
+#else
+#define UI_CREATOR(function) function
+#endif
+
+Game_World::Game_World(Application& application, Network& network, Game_Scene* game_scene,
+                       Texture2D* unit_texture, Texture2D* tower_texture,
+                       Texture2D* card_texture)
+    : application(application), network(network), game_scene(game_scene), ecs(nullptr),
+      unit_texture(unit_texture), tower_texture(tower_texture), card_texture(card_texture) {
+}
+
+Game_World::~Game_World() {
+    // Also takes the ECS off its worker pool, the other matches of the server keep running
+    delete ecs;
+    for (Path* path : f_paths)
+        delete path;
+    for (Path* path : r_paths)
+        delete path;
+    for (Card_Data* card_data : card_datas)
+        delete card_data;
+}
+
+void Game_World::Setup_World(vector<Player*> players, Player* local_player, long seed,
+                             int num_paths, int worker_count, ECS_Worker_Pool* worker_pool) {
+    ranges::sort(players, [](Player* a, Player* b) { return a->player_id <= b->player_id; });
+    this->seed = seed;
+    game_manager = std::make_unique<Game_Manager>(application, network, players, local_player,
+                                                  seed);
+    ecs = worker_pool == nullptr ? new ECS(application, seed, worker_count)
+                                 : new ECS(application, seed, *worker_pool);
+    ecs->Register_System(new System(Get_Unit_Entity_Type(), Unit_Update, "Unit"), 1);
+    ecs->Register_System(new System(Get_Tower_Entity_Type(), Tower_Update, "Tower"), 1);
+    ecs->Register_System(new System(Get_Base_Entity_Type(), Base_Update, "Base"), 0);
+    ecs->Register_System(
+        new System(Get_Projectile_Entity_Type(), Projectile_Update, "Projectile"), 0);
+
+    for (int p = 0; p < num_paths; p++) {
+        int pathx_offset = ((p + 1) / 2) * 220;
+        if (p % 2 == 1)
+            pathx_offset *= -1;
+        vector<Vector2> positions = vector<Vector2>();
+        static uniform_int_distribution<int> start_dist(-80, 80);
+        positions.emplace_back(start_dist(game_manager->random) + pathx_offset, 1000 - 80);
+        while (positions[positions.size() - 1].y > 80) {
+            Vector2 prev_pos = positions[positions.size() - 1];
+            prev_pos.x -= pathx_offset;
+            static uniform_int_distribution<int> move_dist(-40, 40);
+            int new_x = max(min((int) prev_pos.x + move_dist(game_manager->random), 100), 0);
+            static uniform_int_distribution<int> forward_dist(20, 40);
+            positions.emplace_back(new_x + pathx_offset,
+                                   prev_pos.y - forward_dist(game_manager->random));
+        }
+
+        auto f_path = new Path(p, positions);
+        vector<Vector2> reversed = vector<Vector2>(positions);
+        ranges::reverse(reversed);
+        auto r_path = new Path(p, reversed);
+        f_paths.emplace_back(f_path);
+        r_paths.emplace_back(r_path);
+    }
+
+    play_card_rpc = network.bind_rpc(
+        "playcard", [this](Player_ID player_id, Entity_ID entity_id, float x, float y) {
+            Card_Player* player = static_cast<Card_Player*>(game_manager->Get_Player(player_id));
+            // Check if the card is in the hand
+            if (ranges::find(player->Get_Deck()->hand, entity_id) == player->Get_Deck()->hand.end())
+                return RPC_Manager::INVALID;
+            Entity card = get<0>(ecs->entities_by_id[entity_id]);
+            auto* card_component = get<1>(card)->Get_Component<Card_Component>(card);
+
+            if (!card_component->card_data->can_play_card(player, card, Vector2(x, y)))
+                return RPC_Manager::INVALID;
+
+            card_component->card_data->play_card(player, card, Vector2(x, y));
+            return RPC_Manager::VALID_CALL_ON_CLIENTS;
+        });
+    discard_rpc = network.bind_rpc("discard", [this](Player_ID player_id, Entity_ID entity_id) {
+        Card_Player* player = static_cast<Card_Player*>(game_manager->Get_Player(player_id));
+        // Check if the card is in the hand
+        if (ranges::find(player->Get_Deck()->hand, entity_id) == player->Get_Deck()->hand.end())
+            return RPC_Manager::INVALID;
+
+        Discard_Card(player, get<0>(ecs->entities_by_id[entity_id]));
+        return RPC_Manager::VALID_CALL_ON_CLIENTS;
+    });
+
+    ecs->Create_Entity_Type(Get_Unit_Entity_Type()->components, "Unit",
+                            UI_CREATOR(Create_Unit_UI), Setup_Unit, Delete_Unit);
+    ecs->Create_Entity_Type(Get_Tower_Entity_Type()->components, "Tower",
+                            UI_CREATOR(Create_Tower_UI));
+    ecs->Create_Entity_Type(vector{&Deck_Component::component_type}, "Deck",
+                            UI_CREATOR(Create_Deck_UI));
+    ecs->Create_Entity_Type(Get_Unit_Card_Entity_Type()->components, "UnitCard",
+                            UI_CREATOR(Create_Card_UI));
+    ecs->Create_Entity_Type(Get_Tower_Card_Entity_Type()->components, "TowerCard",
+                            UI_CREATOR(Create_Card_UI));
+    ecs->Create_Entity_Type(Get_Base_Entity_Type()->components, "Base", nullptr);
+    ecs->Create_Entity_Type(Get_Projectile_Entity_Type()->components, "Projectile",
+                            UI_CREATOR(Create_Projectile_UI));
+
+    card_datas.emplace_back(new Card_Data{*card_texture, "Send Units",
+                                          "Sends 7 units to the opponent.", 5, Can_Play_Card,
+                                          Play_Unit_Card, Discard_Card});
+    card_datas.emplace_back(new Card_Data{*card_texture, "Send Units",
+                                          "Sends 11 units to the opponent.", 8, Can_Play_Card,
+                                          Play_Unit_Card, Discard_Card});
+    card_datas.emplace_back(new Card_Data{*card_texture, "Send Units",
+                                          "Sends 18 units to the opponent.", 12, Can_Play_Card,
+                                          Play_Unit_Card, Discard_Card});
+    card_datas.emplace_back(new Card_Data{*card_texture, "Tower",
+                                          "Places a tower that shoots opposing units.", 15,
+                                          Can_Play_Tower_Card, Play_Tower_Card, Discard_Card});
+
+    vector<Entity_ID> starting_cards{};
+    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
+                                               card_datas[0], {7, 1.3f, 3, 2, unit_texture},
+                                               card_texture, 1, WHITE));
+    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
+                                               card_datas[0], {7, 1.3f, 3, 2, unit_texture},
+                                               card_texture, 1, WHITE));
+    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
+                                               card_datas[1], {11, 1, 8, 1, unit_texture},
+                                               card_texture, 1, WHITE));
+    starting_cards.emplace_back(Init_Unit_Card(ecs->Create_Entity(Get_Unit_Card_Entity_Type(), 0),
+                                               card_datas[2], {18, .8f, 10, 1, unit_texture},
+                                               card_texture, 1, WHITE));
+    starting_cards.emplace_back(Init_Tower_Card(
+        ecs->Create_Entity(Get_Tower_Card_Entity_Type(), 0), card_datas[3],
+        {tower_texture, 0, true, 30, 2, 120, 5, unit_texture}, card_texture, 1, WHITE));
+
+    Entity base0 = ecs->Create_Entity(Get_Base_Entity_Type(), -1);
+    auto team0_players = vector<Card_Player*>();
+    Entity base1 = ecs->Create_Entity(Get_Base_Entity_Type(), -1);
+    auto team1_players = vector<Card_Player*>();
+
+    for (auto player : game_manager->players) {
+        auto* card_player = static_cast<Card_Player*>(player);
+        if (card_player->team == -1) {
+            // Players without a team watch, they get the steps late so they never hold up the match
+            game_manager->Set_Spectator(player->player_id);
+            if (network.Is_Server() && !player->ai && player != local_player)
+                network.Set_Spectator(player->client_id);
+            continue;
+        }
+        card_player->ecs = ecs;
+        card_player->base_id = Entity_Array::Get_Entity_ID(card_player->team == 0 ? base0 : base1);
+        card_player->team == 0 ? team0_players.emplace_back(card_player)
+                               : team1_players.emplace_back(card_player);
+        card_player->paths = Get_Team_Paths(card_player->team);
+
+        auto deck = ecs->Create_Entity(Get_Deck_Entity_Type(), -1);
+        Init_Deck(deck, card_player, game_scene);
+        card_player->deck_id = Entity_Array::Get_Entity_ID(deck);
+        for (auto& card : starting_cards) {
+            card_player->Get_Deck()->deck.Push_Back(
+                ecs->side_storage, Entity_Array::Get_Entity_Data(ecs->Copy_Entity(card, -1)).id);
+        }
+        Shuffle_Deck(deck);
+        Draw_Card(deck, 3);
+    }
+    Init_Base(base0, game_scene, team0_players, Entity_Array::Get_Entity_ID(base1), 0,
+              Get_Team_Paths(0)[0]->positions[0], Get_Team_Paths(0), 20, 100);
+    Init_Base(base1, game_scene, team1_players, Entity_Array::Get_Entity_ID(base0), 1,
+              Get_Team_Paths(1)[0]->positions[0], Get_Team_Paths(1), 20, 100);
+
+    for (Entity_ID starting_card : starting_cards) {
+        ecs->Delete_Entity(starting_card);
+    }
+    starting_cards.clear();
+    Setup_Snapshots();
+
+    if (network.Is_Server()) {
+        // The lobby bound these, they are only needed to tell joining clients about the players
+        add_player_rpc = network.Get_Rpc<Client_ID, Player_ID>("addplayer");
+        add_ai_player_rpc = network.Get_Rpc<Player_ID>("addaiplayer");
+        set_player_team_rpc = network.Get_Rpc<Player_ID, int>("setplayerteam");
+        join_game_rpc = network.Get_Rpc<long, Player_ID>("joingame");
+        for (Player* player : game_manager->players)
+            next_spectator_id = max(next_spectator_id, player->player_id + 1);
+    }
+}
+
+void Game_World::Setup_Snapshots() {
+    // Registered in the same order on every machine, see Snapshot_Pointers
+    Snapshot_Pointers& pointers = ecs->snapshot_pointers;
+    pointers.Register(unit_texture);
+    pointers.Register(tower_texture);
+    pointers.Register(card_texture);
+    // A headless world has no scene, its slot is still taken so that the indices match the clients
+    pointers.Register(game_scene != nullptr ? static_cast<void*>(game_scene) : this);
+    for (Path* path : f_paths)
+        pointers.Register(path);
+    for (Path* path : r_paths)
+        pointers.Register(path);
+    for (Card_Data* card_data : card_datas)
+        pointers.Register(card_data);
+    // Spectators can join later, so only the players on a team are part of the snapshot
+    for (Player* player : game_manager->players) {
+        if (static_cast<Card_Player*>(player)->team != -1)
+            pointers.Register(player);
+    }
+
+    game_manager->on_save_snapshot = [this](Snapshot_Writer& writer) {
+        ecs->Save_Snapshot(writer);
+        for (Player* player : game_manager->players) {
+            auto* card_player = static_cast<Card_Player*>(player);
+            if (card_player->team != -1)
+                writer.Write(card_player->money);
+        }
+    };
+    game_manager->on_load_snapshot = [this](Snapshot_Reader& reader) {
+        if (!ecs->Load_Snapshot(reader))
+            return false;
+        for (Player* player : game_manager->players) {
+            auto* card_player = static_cast<Card_Player*>(player);
+            if (card_player->team != -1)
+                card_player->money = reader.Read<int>();
+        }
+        return !reader.failed;
+    };
+}
+
+uint64_t Game_World::Hash_State() {
+    Snapshot_Writer writer(ecs->snapshot_pointers);
+    game_manager->Save_Snapshot(writer);
+    return ::Hash_State(writer.data.data(), writer.data.size());
+}
+
+vector<char> Game_World::Save_Replay_Setup() const {
+    Snapshot_Writer writer(ecs->snapshot_pointers);
+    writer.Write(static_cast<int>(f_paths.size()));
+    writer.Write(game_manager->players.size());
+    for (Player* player : game_manager->players) {
+        writer.Write(player->player_id);
+        writer.Write(player->client_id);
+        writer.Write(static_cast<Card_Player*>(player)->team);
+        writer.Write(player->ai ? 1 : 0);
+    }
+    return writer.data;
+}
+
+bool Game_World::Load_Replay_Setup(const vector<char>& setup, vector<Player*>& players,
+                                   int& num_paths) {
+    Rpc_Reader reader(setup.data(), setup.size());
+    num_paths = Rpc_Codec<int>::Read(reader);
+    size_t count = Rpc_Codec<size_t>::Read(reader);
+    for (size_t i = 0; i < count && !reader.failed; i++) {
+        auto player_id = Rpc_Codec<Player_ID>::Read(reader);
+        auto client_id = Rpc_Codec<Client_ID>::Read(reader);
+        int team = Rpc_Codec<int>::Read(reader);
+        if (Rpc_Codec<int>::Read(reader) != 0)
+            players.emplace_back(new Card_Player(player_id, team));
+        else
+            players.emplace_back(new Card_Player(client_id, player_id, team));
+    }
+    return !reader.failed && reader.Done();
+}
+
+void Game_World::Update() {
+    if (game_manager->Is_Waiting_For_Snapshot() && on_ecs_updated != nullptr) {
+        // A client that joined late loads its snapshot here. The snapshot was saved after the ECS
+        // update of its step, so the ECS doesn't run that step again.
+        on_ecs_updated();
+        ecs_updated = !game_manager->Is_Waiting_For_Snapshot();
+    }
+    // The ECS only runs for the steps the Game_Manager simulates, so that every machine and every
+    // replay of the match runs it the same number of times. A client that fell behind the server
+    // simulates several steps in one frame to catch up.
+    int steps = game_manager->Get_Steps_To_Simulate();
+    if (steps == 0) {
+        // Still counts the stall and repeats the step report of a waiting client
+        game_manager->Update();
+        return;
+    }
+    for (int i = 0; i < steps; i++) {
+        if (!ecs_updated) {
+            ecs->Update();
+            if (on_ecs_updated != nullptr)
+                on_ecs_updated();
+        }
+        ecs_updated = false;
+        for (Client_ID client_id : joining_clients)
+            Join_Client(client_id);
+        joining_clients.clear();
+        game_manager->Update();
+    }
+}
+
+vector<Path*> Game_World::Get_Team_Paths(int team) const {
+    return team == 0 ? f_paths : r_paths;
+}
+
+void Game_World::On_Client_Connected(Client_ID client_id) {
+    joining_clients.emplace_back(client_id);
+}
+
+void Game_World::On_Client_Disconnected(Client_ID client_id) {
+    erase(joining_clients, client_id);
+    // The match doesn't wait for the steps of a client that left
+    if (auto spectator = spectators.find(client_id); spectator != spectators.end()) {
+        game_manager->Remove_Player_Steps(spectator->second);
+        spectators.erase(spectator);
+        return;
+    }
+    for (Player* player : game_manager->players) {
+        if (player->ai || player == game_manager->local_player || player->client_id != client_id)
+            continue;
+        game_manager->Remove_Player_Steps(player->player_id);
+        // A spectator has no slot to take over
+        if (static_cast<Card_Player*>(player)->team != -1)
+            disconnected_players.emplace_back(player);
+    }
+}
+
+void Game_World::Join_Client(Client_ID client_id) {
+    Player_ID player_id;
+    if (!disconnected_players.empty()) {
+        Player* player = disconnected_players.front();
+        disconnected_players.erase(disconnected_players.begin());
+        player->client_id = client_id;
+        player_id = player->player_id;
+    } else {
+        player_id = next_spectator_id++;
+        spectators.emplace(client_id, player_id);
+    }
+
+    for (Player* player : game_manager->players) {
+        if (player->ai)
+            network.call_rpc_on_client(client_id, add_ai_player_rpc, player->player_id);
+        else
+            network.call_rpc_on_client(client_id, add_player_rpc, player->client_id,
+                                       player->player_id);
+        network.call_rpc_on_client(client_id, set_player_team_rpc, player->player_id,
+                                   static_cast<Card_Player*>(player)->team);
+    }
+    if (spectators.contains(client_id)) {
+        game_manager->Set_Spectator(player_id);
+        network.Set_Spectator(client_id);
+        network.call_rpc_on_client(client_id, add_player_rpc, client_id, player_id);
+        network.call_rpc_on_client(client_id, set_player_team_rpc, player_id, -1);
+    }
+    network.call_rpc_on_client(client_id, join_game_rpc, seed, player_id);
+
+    Snapshot_Writer writer(ecs->snapshot_pointers);
+    game_manager->Save_Snapshot(writer);
+    network.Send_Snapshot(client_id, game_manager->Get_Current_Step(), std::move(writer.data));
+}
@@ -32,49 +32,71 @@ Lobby_Scene::Lobby_Scene(Card_Game& card_game)
     });
     leave_button->padding = {10, 20, 10, 20};
     root->Add_Child(leave_button);
-    card_game.Get_Network()->bind_rpc("setplayercount", [this](int new_player_count) {
-        player_count = new_player_count;
-        status_text->Set_Text("Players: " + to_string(player_count));
-        return RPC_Manager::Rpc_Validator_Result::VALID_CALL_ON_CLIENTS;
-    });
-    card_game.Get_Network()->bind_rpc(
+    set_player_count_rpc =
+        card_game.Get_Network()->bind_rpc("setplayercount", [this](int new_player_count) {
+            player_count = new_player_count;
+            status_text->Set_Text("Players: " + to_string(player_count));
+            return RPC_Manager::Rpc_Validator_Result::VALID_CALL_ON_CLIENTS;
+        });
+    add_player_rpc = card_game.Get_Network()->bind_rpc(
         "addplayer", [this](Client_ID client_id, Player_ID player_id) {
             players.emplace_back(new Card_Player(client_id, player_id, 0));
             return RPC_Manager::Rpc_Validator_Result::VALID_CALL_ON_CLIENTS;
         });
-    card_game.Get_Network()->bind_rpc("addaiplayer", [this](Player_ID player_id) {
-        players.emplace_back(new Card_Player(player_id, 0));
-        return RPC_Manager::Rpc_Validator_Result::VALID_CALL_ON_CLIENTS;
-    });
-    card_game.Get_Network()->bind_rpc("setplayerid", [this](Player_ID player_id) {
-        for (auto& player : players) {
-            if (player->player_id != player_id)
-                continue;
-            player->local_player = true;
-            local_player = player;
-        }
-        return RPC_Manager::Rpc_Validator_Result::VALID;
-    });
-    card_game.Get_Network()->bind_rpc("removeplayer", [this](Client_ID client_id) {
-        if (!any_of(players.begin(), players.end(),
-                    [client_id](Player* player) { return player->client_id == client_id; }))
-            return RPC_Manager::INVALID;
-        erase_if(players, [client_id](Player* p) { return p->client_id == client_id; });
-        return RPC_Manager::Rpc_Validator_Result::VALID_CALL_ON_CLIENTS;
-    });
-    card_game.Get_Network()->bind_rpc("setplayerteam", [this](Player_ID player_id, int team) {
-        static_cast<Card_Player*>(*std::ranges::find_if(players, [player_id](Player* player) {
-            return player->player_id == player_id;
-        }))->team = team;
-        return RPC_Manager::VALID_CALL_ON_CLIENTS;
-    });
-    card_game.Get_Network()->bind_rpc("startgame", [this, &card_game](long seed) {
-        if (card_game.Get_Network()->Get_Network_State() != Network::Server_Running &&
-            card_game.Get_Network()->Get_Network_State() != Network::Client_Connected)
-            return RPC_Manager::Rpc_Validator_Result::INVALID;
-        Start_Game(seed);
-        return RPC_Manager::VALID_CALL_ON_CLIENTS;
-    });
+    add_ai_player_rpc =
+        card_game.Get_Network()->bind_rpc("addaiplayer", [this](Player_ID player_id) {
+            players.emplace_back(new Card_Player(player_id, 0));
+            return RPC_Manager::Rpc_Validator_Result::VALID_CALL_ON_CLIENTS;
+        });
+    set_player_id_rpc =
+        card_game.Get_Network()->bind_rpc("setplayerid", [this](Player_ID player_id) {
+            for (auto& player : players) {
+                if (player->player_id != player_id)
+                    continue;
+                player->local_player = true;
+                local_player = player;
+            }
+            return RPC_Manager::Rpc_Validator_Result::VALID;
+        });
+    remove_player_rpc =
+        card_game.Get_Network()->bind_rpc("removeplayer", [this](Client_ID client_id) {
+            if (!any_of(players.begin(), players.end(),
+                        [client_id](Player* player) { return player->client_id == client_id; }))
+                return RPC_Manager::INVALID;
+            erase_if(players, [client_id](Player* p) { return p->client_id == client_id; });
+            return RPC_Manager::Rpc_Validator_Result::VALID_CALL_ON_CLIENTS;
+        });
+    set_player_team_rpc = card_game.Get_Network()->bind_rpc(
+        "setplayerteam", [this](Player_ID player_id, int team) {
+            static_cast<Card_Player*>(*std::ranges::find_if(players, [player_id](Player* player) {
+                return player->player_id == player_id;
+            }))->team = team;
+            return RPC_Manager::VALID_CALL_ON_CLIENTS;
+        });
+    start_game_rpc =
+        card_game.Get_Network()->bind_rpc("startgame", [this, &card_game](long seed) {
+            if (card_game.Get_Network()->Get_Network_State() != Network::Server_Running &&
+                card_game.Get_Network()->Get_Network_State() != Network::Client_Connected)
+                return RPC_Manager::Rpc_Validator_Result::INVALID;
+            Start_Game(seed);
+            return RPC_Manager::VALID_CALL_ON_CLIENTS;
+        });
+    // Sent by the server to a client that connected after the game started, the snapshot of the
+    // match follows
+    join_game_rpc = card_game.Get_Network()->bind_rpc(
+        "joingame", [this, &card_game](long seed, Player_ID player_id) {
+            if (card_game.Get_Network()->Get_Network_State() != Network::Client_Connected)
+                return RPC_Manager::Rpc_Validator_Result::INVALID;
+            for (auto& player : players) {
+                if (player->player_id != player_id)
+                    continue;
+                player->local_player = true;
+                local_player = player;
+            }
+            Game_Scene* game_scene = Start_Game(seed);
+            game_scene->Wait_For_Snapshot();
+            return RPC_Manager::Rpc_Validator_Result::VALID;
+        });
     card_game.Get_Network()->connection_events->emplace(
         static_cast<Network_Events_Receiver*>(this));
     players = vector<Player*>();
@@ -89,41 +111,42 @@ Lobby_Scene::~Lobby_Scene() {
 void Lobby_Scene::Server_Start_Game() {
     int team = 0;
     for (auto* player : players) {
-        card_game.Get_Network()->call_rpc(true, "setplayerteam", player->player_id, team);
+        card_game.Get_Network()->call_rpc(set_player_team_rpc, player->player_id, team);
         team = (team + 1) % 2;
     }
     // If the teams are unbalanced add an AI
     if (team == 1) {
         Player_ID ai_id = player_id_count++;
-        card_game.Get_Network()->call_rpc(true, "addaiplayer", ai_id);
-        card_game.Get_Network()->call_rpc(true, "setplayerteam", ai_id, team);
+        card_game.Get_Network()->call_rpc(add_ai_player_rpc, ai_id);
+        card_game.Get_Network()->call_rpc(set_player_team_rpc, ai_id, team);
     }
     card_game.Get_Network()->call_rpc(
-        true, "startgame",
+        start_game_rpc,
         chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch())
             .count());
 }
 
 void Lobby_Scene::Server_Start_AI_Only() {
     for (auto* player : players) {
-        card_game.Get_Network()->call_rpc(true, "setplayerteam", player->player_id, -1);
+        card_game.Get_Network()->call_rpc(set_player_team_rpc, player->player_id, -1);
     }
     Player_ID ai_id = player_id_count++;
-    card_game.Get_Network()->call_rpc(true, "addaiplayer", ai_id);
-    card_game.Get_Network()->call_rpc(true, "setplayerteam", ai_id, 0);
+    card_game.Get_Network()->call_rpc(add_ai_player_rpc, ai_id);
+    card_game.Get_Network()->call_rpc(set_player_team_rpc, ai_id, 0);
     ai_id = player_id_count++;
-    card_game.Get_Network()->call_rpc(true, "addaiplayer", ai_id);
-    card_game.Get_Network()->call_rpc(true, "setplayerteam", ai_id, 1);
+    card_game.Get_Network()->call_rpc(add_ai_player_rpc, ai_id);
+    card_game.Get_Network()->call_rpc(set_player_team_rpc, ai_id, 1);
 
-    card_game.Get_Network()->call_rpc(true, "startgame", 10L);
+    card_game.Get_Network()->call_rpc(start_game_rpc, 10L);
     // chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch())
     // .count());
 }
 
-void Lobby_Scene::Start_Game(long seed) {
+Game_Scene* Lobby_Scene::Start_Game(long seed) {
     card_game.set_ui_screen(GAME);
     Game_Scene* game_scene = static_cast<Game_Scene*>(card_game.scene);
     game_scene->Setup_Scene(players, local_player, seed, 3);
+    return game_scene;
 }
 
 void Lobby_Scene::Update_UI(std::chrono::milliseconds) {
@@ -144,8 +167,8 @@ void Lobby_Scene::On_Disconnected() {
 
 void Lobby_Scene::On_Server_Start() {
     player_count = 1;
-    card_game.Get_Network()->call_rpc(true, "setplayercount", player_count);
-    card_game.Get_Network()->call_rpc(true, "addplayer", 0, player_id_count++);
+    card_game.Get_Network()->call_rpc(set_player_count_rpc, player_count);
+    card_game.Get_Network()->call_rpc(add_player_rpc, 0, player_id_count++);
     local_player = players[0];
 }
 
@@ -156,19 +179,19 @@ void Lobby_Scene::On_Server_Stop() {
 void Lobby_Scene::On_Client_Connected(Client_ID client_id) {
     player_count++;
     Player_ID new_player_id = player_id_count++;
-    card_game.Get_Network()->call_rpc(true, "setplayercount", player_count);
-    card_game.Get_Network()->call_rpc(true, "addplayer", client_id, new_player_id);
-    card_game.Get_Network()->call_rpc_on_client(client_id, true, "setplayerid", new_player_id);
+    card_game.Get_Network()->call_rpc(set_player_count_rpc, player_count);
+    card_game.Get_Network()->call_rpc(add_player_rpc, client_id, new_player_id);
+    card_game.Get_Network()->call_rpc_on_client(client_id, set_player_id_rpc, new_player_id);
     for (const auto& player : players) {
         if (player->client_id == client_id)
             continue;
-        card_game.Get_Network()->call_rpc_on_client(client_id, true, "addplayer", player->client_id,
-                                                    player->player_id);
+        card_game.Get_Network()->call_rpc_on_client(client_id, add_player_rpc,
+                                                    player->client_id, player->player_id);
     }
 }
 
 void Lobby_Scene::On_Client_Disconnected(Client_ID client_id) {
     player_count--;
-    card_game.Get_Network()->call_rpc(true, "setplayercount", player_count);
-    card_game.Get_Network()->call_rpc(true, "removeplayer", client_id);
+    card_game.Get_Network()->call_rpc(set_player_count_rpc, player_count);
+    card_game.Get_Network()->call_rpc(remove_player_rpc, client_id);
 }
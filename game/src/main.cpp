@@ -1,17 +1,38 @@
+#include <cstdlib>
+#include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
 
 #include "application.h"
 #include "application_factory.h"
 #include "card_game.h"
 
 class CardGameFactory : public ApplicationFactory {
+    std::optional<Match_ID> server_match;
+
   public:
+    explicit CardGameFactory(std::optional<Match_ID> server_match) : server_match(server_match) {}
+
     std::unique_ptr<Application> Create_Application(bool client) override {
-        return std::make_unique<Card_Game>(client);
+        auto card_game = std::make_unique<Card_Game>(client);
+        card_game->server_match = server_match;
+        return card_game;
     }
 };
 
-int main() {
-    auto factory = make_unique<CardGameFactory>();
+/* Usage: game [--match ID], joins the match on a dedicated server instead of a hosted game. */
+int main(int argc, char** argv) {
+    std::optional<Match_ID> server_match;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--match" && i + 1 < argc) {
+            server_match = static_cast<Match_ID>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::cerr << "Usage: game [--match ID]" << std::endl;
+            return 1;
+        }
+    }
+    auto factory = make_unique<CardGameFactory>(server_match);
     Create_Application(std::move(factory), true);
 }
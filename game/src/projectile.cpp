@@ -1,6 +1,8 @@
 #include "projectile.h"
 
+#ifndef EUCLID_HEADLESS
 #include "projectile_ui.h"
+#endif
 #include "unit.h"
 
 #include <raymath.h>
@@ -63,14 +65,17 @@ void Projectile_Update(ECS* ecs, Entity entity) {
 }
 
 Entity_Type* Get_Projectile_Entity_Type() {
-    return new Entity_Type(vector{&UI_Component::component_type,
-                                  &Transform_Component::component_type,
-                                  &Projectile_Component::component_type});
+    static Entity_Type entity_type(vector{&UI_Component::component_type,
+                                          &Transform_Component::component_type,
+                                          &Projectile_Component::component_type});
+    return &entity_type;
 }
 
+#ifndef EUCLID_HEADLESS
 Object_UI* Create_Projectile_UI(Entity entity, Game_UI_Manager& game_ui_manager) {
     return new Projectile_UI(entity, game_ui_manager);
 }
+#endif
 
 Component_Type Projectile_Component::component_type =
     Component_Type{"Projectile", sizeof(Projectile_Component)};
@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "card_match.h"
+#include "dedicated_server.h"
+
+/**
+ * The dedicated server of the game, hosts the matches headless in one process.
+ * Built against euclid_headless, so it doesn't need a display or any GL libraries.
+ * A match is created once a client asks to join it and starts once --players clients joined.
+ * With --record every match is recorded to DIRECTORY/match_ID.replay, with the state hash every
+ * --hash-interval steps, and can be played back with replay_player.
+ *
+ * Usage: game_server [--players N] [--workers N] [--stats FILE] [--stats-interval MS]
+ *                    [--record DIRECTORY] [--hash-interval N]
+ */
+
+struct Server_Config {
+    int players = 2;
+    int workers = 4;
+    // Where the stats are reported, "-" reports to stdout and nothing is reported if empty
+    string stats_path;
+    int stats_interval = 1000;
+    // Where the replays are written, nothing is recorded if empty
+    string record_directory;
+    int hash_interval = 10;
+};
+
+static bool Parse_Args(int argc, char** argv, Server_Config& config) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        if (arg == "--stats") {
+            config.stats_path = argv[++i];
+            continue;
+        }
+        if (arg == "--record") {
+            config.record_directory = argv[++i];
+            continue;
+        }
+        long value = strtol(argv[++i], nullptr, 10);
+        if (arg == "--players")
+            config.players = static_cast<int>(value);
+        else if (arg == "--workers")
+            config.workers = static_cast<int>(value);
+        else if (arg == "--stats-interval")
+            config.stats_interval = static_cast<int>(value);
+        else if (arg == "--hash-interval")
+            config.hash_interval = static_cast<int>(value);
+        else {
+            cerr << "Unknown argument " << arg << endl;
+            return false;
+        }
+    }
+    return config.players > 0 && config.workers >= 0 && config.stats_interval > 0 &&
+           config.hash_interval >= 0;
+}
+
+int main(int argc, char** argv) {
+    Server_Config config;
+    if (!Parse_Args(argc, argv, config)) {
+        cerr << "Usage: game_server [--players N] [--workers N] [--stats FILE] "
+                "[--stats-interval MS] [--record DIRECTORY] [--hash-interval N]"
+             << endl;
+        return 1;
+    }
+
+    unique_ptr<Dedicated_Server> server;
+    server = make_unique<Dedicated_Server>(
+        "CARD GAME SERVER",
+        [&server, &config](Match_ID match_id, shared_ptr<Network> network) {
+            string replay_path;
+            if (!config.record_directory.empty())
+                replay_path = config.record_directory + "/match_" + to_string(match_id) + ".replay";
+            return make_unique<Card_Match>(*server, match_id, std::move(network), config.players,
+                                           replay_path, config.hash_interval);
+        },
+        config.workers);
+    if (!config.stats_path.empty() &&
+        !server->stats.Start(config.stats_path, chrono::milliseconds(config.stats_interval)))
+        return 1;
+    server->Start_Application();
+    return 0;
+}
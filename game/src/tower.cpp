@@ -3,7 +3,9 @@
 #include "game_manager.h"
 #include "projectile.h"
 #include "tower_card.h"
+#ifndef EUCLID_HEADLESS
 #include "tower_ui.h"
+#endif
 #include "unit.h"
 
 #include <climits>
@@ -73,14 +75,33 @@ void Tower_Update(ECS* ecs, Entity entity) {
     tower->reload_time = tower->reload_speed;
 }
 
+#ifndef EUCLID_HEADLESS
 Object_UI* Create_Tower_UI(Entity entity, Game_UI_Manager& game_ui_manager) {
     return new Tower_UI(entity, game_ui_manager);
 }
+#endif
 
 Entity_Type* Get_Tower_Entity_Type() {
-    return new Entity_Type(vector{&UI_Component::component_type,
-                                  &Transform_Component::component_type,
-                                  &Tower_Component::component_type});
+    static Entity_Type entity_type(vector{&UI_Component::component_type,
+                                          &Transform_Component::component_type,
+                                          &Tower_Component::component_type});
+    return &entity_type;
 }
 
-Component_Type Tower_Component::component_type = Component_Type{"Tower", sizeof(Tower_Component)};
+static void Save_Tower_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    Tower_Component tower = *static_cast<const Tower_Component*>(component);
+    writer.Write_Pointer(tower.projectile_texture);
+    tower.projectile_texture = nullptr;
+    writer.Write_Bytes(tower);
+}
+
+static void Load_Tower_Component(ECS&, void* component, Snapshot_Reader& reader) {
+    auto* tower = static_cast<Tower_Component*>(component);
+    auto* projectile_texture = reader.Read_Pointer<Texture2D>();
+    reader.Read_Bytes_Into(*tower);
+    tower->projectile_texture = projectile_texture;
+}
+
+Component_Type Tower_Component::component_type =
+    Component_Type{"Tower", sizeof(Tower_Component), nullptr, nullptr, Save_Tower_Component,
+                   Load_Tower_Component};
@@ -1,6 +1,6 @@
 #include "tower_card.h"
 
-#include "game_scene.h"
+#include "card_player.h"
 #include "tower.h"
 
 #include <raymath.h>
@@ -49,13 +49,34 @@ void Play_Tower_Card(Card_Player* player, Entity entity, Vector2 pos) {
     auto tower = get<1>(entity)->ecs.Create_Entity(Get_Tower_Entity_Type(),
                                                    Entity_Array::Get_Entity_ID(entity));
     Init_Tower(tower, Vector2(pos.x, pos.y), player->team, *tower_card, tower_card->tower_texture,
-               .4f, Game_Scene::Get_Team_Color(player->team));
+               .4f, Card_Player::Get_Team_Color(player->team));
 }
 
 Entity_Type* Get_Tower_Card_Entity_Type() {
-    return new Entity_Type(vector{&UI_Component::component_type, &Card_Component::component_type,
-                                  &Tower_Card_Component::component_type});
+    static Entity_Type entity_type(vector{&UI_Component::component_type,
+                                          &Card_Component::component_type,
+                                          &Tower_Card_Component::component_type});
+    return &entity_type;
+}
+
+static void Save_Tower_Card_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    Tower_Card_Component tower_card = *static_cast<const Tower_Card_Component*>(component);
+    writer.Write_Pointer(tower_card.tower_texture);
+    writer.Write_Pointer(tower_card.projectile_texture);
+    tower_card.tower_texture = nullptr;
+    tower_card.projectile_texture = nullptr;
+    writer.Write_Bytes(tower_card);
+}
+
+static void Load_Tower_Card_Component(ECS&, void* component, Snapshot_Reader& reader) {
+    auto* tower_card = static_cast<Tower_Card_Component*>(component);
+    auto* tower_texture = reader.Read_Pointer<Texture2D>();
+    auto* projectile_texture = reader.Read_Pointer<Texture2D>();
+    reader.Read_Bytes_Into(*tower_card);
+    tower_card->tower_texture = tower_texture;
+    tower_card->projectile_texture = projectile_texture;
 }
 
 Component_Type Tower_Card_Component::component_type =
-    Component_Type{"TowerCard", sizeof(Tower_Card_Component)};
+    Component_Type{"TowerCard", sizeof(Tower_Card_Component), nullptr, nullptr,
+                   Save_Tower_Card_Component, Load_Tower_Card_Component};
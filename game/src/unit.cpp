@@ -3,7 +3,9 @@
 
 #include "base.h"
 #include "game_manager.h"
+#ifndef EUCLID_HEADLESS
 #include "unit_ui.h"
+#endif
 
 #include <raymath.h>
 
@@ -84,7 +86,7 @@ void Move_Unit(ECS* ecs, Unit_Component* unit, Transform_Component* transform, E
     auto* base = get<1>(base_entity)->Get_Component<Base_Component>(base_entity);
     auto other_base_entity = get<0>(ecs->entities_by_id[base->other_base_id]);
     auto* other_base = get<1>(other_base_entity)->Get_Component<Base_Component>(other_base_entity);
-    for (auto other_id : *other_base->units_on_path[unit->path->index]) {
+    for (auto other_id : other_base->units_on_path[unit->path->index]) {
         auto other_entity = get<0>(ecs->entities_by_id[other_id]);
         if (other_id == entity_id)
             continue;
@@ -121,7 +123,8 @@ void Setup_Unit(Entity entity) {
     auto* unit = get<1>(entity)->Get_Component<Unit_Component>(entity);
     auto base_entity = get<0>(get<1>(entity)->ecs.entities_by_id[unit->base_id]);
     auto* base = get<1>(base_entity)->Get_Component<Base_Component>(base_entity);
-    base->units_on_path[unit->path->index]->emplace_back(Entity_Array::Get_Entity_ID(entity));
+    base->units_on_path[unit->path->index].Push_Back(get<1>(entity)->ecs.side_storage,
+                                                     Entity_Array::Get_Entity_ID(entity));
 }
 
 void Delete_Unit(Entity entity) {
@@ -129,11 +132,8 @@ void Delete_Unit(Entity entity) {
     auto base_entity = get<0>(get<1>(entity)->ecs.entities_by_id[unit->base_id]);
     auto* base = get<1>(base_entity)->Get_Component<Base_Component>(base_entity);
 
-    auto& units_on_path = *base->units_on_path[unit->path->index];
-    auto found_entity = ranges::find(units_on_path, Entity_Array::Get_Entity_ID(entity));
-    if (found_entity != units_on_path.end())
-        units_on_path.erase(found_entity);
-    else
+    auto& units_on_path = base->units_on_path[unit->path->index];
+    if (!units_on_path.Remove(Entity_Array::Get_Entity_ID(entity)))
         throw runtime_error(
             "Could not find the unit on the path to delete! Was it already deleted?");
 }
@@ -150,14 +150,32 @@ void Unit_Update(ECS* ecs, Entity entity) {
     }
 }
 
+#ifndef EUCLID_HEADLESS
 Object_UI* Create_Unit_UI(Entity entity, Game_UI_Manager& game_ui_manager) {
     return new Unit_UI(entity, game_ui_manager);
 }
+#endif
 
 Entity_Type* Get_Unit_Entity_Type() {
-    return new Entity_Type(vector{&UI_Component::component_type,
-                                  &Transform_Component::component_type,
-                                  &Unit_Component::component_type});
+    static Entity_Type entity_type(vector{&UI_Component::component_type,
+                                          &Transform_Component::component_type,
+                                          &Unit_Component::component_type});
+    return &entity_type;
 }
 
-Component_Type Unit_Component::component_type = Component_Type{"Unit", sizeof(Unit_Component)};
+static void Save_Unit_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    Unit_Component unit = *static_cast<const Unit_Component*>(component);
+    writer.Write_Pointer(unit.path);
+    unit.path = nullptr;
+    writer.Write_Bytes(unit);
+}
+
+static void Load_Unit_Component(ECS&, void* component, Snapshot_Reader& reader) {
+    auto* unit = static_cast<Unit_Component*>(component);
+    auto* path = reader.Read_Pointer<Path>();
+    reader.Read_Bytes_Into(*unit);
+    unit->path = path;
+}
+
+Component_Type Unit_Component::component_type = Component_Type{
+    "Unit", sizeof(Unit_Component), nullptr, nullptr, Save_Unit_Component, Load_Unit_Component};
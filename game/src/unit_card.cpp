@@ -1,6 +1,6 @@
 #include "unit_card.h"
 
-#include "game_scene.h"
+#include "card_player.h"
 #include "unit.h"
 
 #include <raymath.h>
@@ -39,14 +39,31 @@ void Play_Unit_Card(Card_Player* card_player, Entity entity, Vector2 pos) {
                                                       Entity_Array::Get_Entity_ID(entity));
         Init_Unit(&get<1>(entity)->ecs, unit, card_player->base_id, path, unit_card->unit_speed,
                   unit_card->unit_health, unit_card->unit_damage, i * 10, card_player->team,
-                  unit_card->unit_texture, .4f, Game_Scene::Get_Team_Color(card_player->team));
+                  unit_card->unit_texture, .4f, Card_Player::Get_Team_Color(card_player->team));
     }
 }
 
 Entity_Type* Get_Unit_Card_Entity_Type() {
-    return new Entity_Type(vector{&UI_Component::component_type, &Card_Component::component_type,
-                                  &Unit_Card_Component::component_type});
+    static Entity_Type entity_type(vector{&UI_Component::component_type,
+                                          &Card_Component::component_type,
+                                          &Unit_Card_Component::component_type});
+    return &entity_type;
+}
+
+static void Save_Unit_Card_Component(ECS&, const void* component, Snapshot_Writer& writer) {
+    Unit_Card_Component unit_card = *static_cast<const Unit_Card_Component*>(component);
+    writer.Write_Pointer(unit_card.unit_texture);
+    unit_card.unit_texture = nullptr;
+    writer.Write_Bytes(unit_card);
+}
+
+static void Load_Unit_Card_Component(ECS&, void* component, Snapshot_Reader& reader) {
+    auto* unit_card = static_cast<Unit_Card_Component*>(component);
+    auto* unit_texture = reader.Read_Pointer<Texture2D>();
+    reader.Read_Bytes_Into(*unit_card);
+    unit_card->unit_texture = unit_texture;
 }
 
 Component_Type Unit_Card_Component::component_type =
-    Component_Type{"UnitCard", sizeof(Unit_Card_Component)};
+    Component_Type{"UnitCard", sizeof(Unit_Card_Component), nullptr, nullptr,
+                   Save_Unit_Card_Component, Load_Unit_Card_Component};